@@ -0,0 +1,328 @@
+#include "benchmark.hpp"
+
+#include <assets/cooked_model.hpp>
+#include <assets/gltf_loader.hpp>
+#include <foundation/file.hpp>
+#include <foundation/tracking_allocator.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+
+namespace fizzbench {
+
+using namespace fizzengine;
+
+static void print_usage() {
+    printf("Usage: FizzBench [options]\n"
+           "  --warmup <frames>        Frames run before measuring (default 100)\n"
+           "  --frames <frames>        Measured frames (default 1000)\n"
+           "  --width <pixels>         Render resolution (default 1280x720)\n"
+           "  --height <pixels>\n"
+           "  --pacing <mode>          vsync, mailbox, immediate or low-latency\n"
+           "                           (default immediate)\n"
+           "  --frames-in-flight <n>   1 to 3 (default 3)\n"
+           "  --headless               No window, render offscreen\n"
+           "  --validation             Enable the Vulkan validation layers\n"
+           "  --output <path>          Results file (default bench_results.json)\n"
+           "  --model <path>           glTF, GLB or cooked .fzm file to load after init\n");
+}
+
+static bool parse_u32(cstring text, u32 min_value, u32& out_value) {
+    char*               end   = nullptr;
+    const unsigned long value = strtoul(text, &end, 10);
+    if (end == text || *end != '\0' || value < min_value || value > 0xffffffffu) {
+        return false;
+    }
+    out_value = (u32)value;
+    return true;
+}
+
+bool parse_options(int argc, char* argv[], BenchmarkOptions& out_options) {
+    for (int i = 1; i < argc; ++i) {
+        cstring arg   = argv[i];
+        cstring value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool    valid = true;
+
+        if (strcmp(arg, "--headless") == 0) {
+            out_options.headless = true;
+            continue;
+        }
+        if (strcmp(arg, "--validation") == 0) {
+            out_options.validation = true;
+            continue;
+        }
+        if (strcmp(arg, "--help") == 0) {
+            print_usage();
+            return false;
+        }
+
+        // Everything else takes a value
+        if (!value) {
+            valid = false;
+        } else if (strcmp(arg, "--warmup") == 0) {
+            valid = parse_u32(value, 0, out_options.warmup_frames);
+        } else if (strcmp(arg, "--frames") == 0) {
+            valid = parse_u32(value, 1, out_options.measured_frames);
+        } else if (strcmp(arg, "--width") == 0) {
+            valid = parse_u32(value, 1, out_options.width);
+        } else if (strcmp(arg, "--height") == 0) {
+            valid = parse_u32(value, 1, out_options.height);
+        } else if (strcmp(arg, "--output") == 0) {
+            out_options.output = value;
+        } else if (strcmp(arg, "--model") == 0) {
+            out_options.model = value;
+        } else if (strcmp(arg, "--frames-in-flight") == 0) {
+            valid = parse_u32(value, 1, out_options.frames_in_flight) &&
+                    out_options.frames_in_flight <= k_max_frames_in_flight;
+        } else if (strcmp(arg, "--pacing") == 0) {
+            valid = false;
+            for (u32 pacing = 0; pacing < k_pacing_count; ++pacing) {
+                if (strcmp(value, get_frame_pacing_name((FramePacing)pacing)) == 0) {
+                    out_options.pacing = (FramePacing)pacing;
+                    valid              = true;
+                }
+            }
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument %s%s%s\n", arg, value ? " " : "", value ? value : "");
+            print_usage();
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+SampleSummary summarize(std::vector<f64>& samples) {
+    SampleSummary summary;
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&](f64 p) {
+        // Smallest sample with at least p percent of the samples at or below it
+        sizet rank = (sizet)std::ceil(p / 100.0 * samples.size());
+        return samples[std::clamp<sizet>(rank, 1, samples.size()) - 1];
+    };
+
+    f64 total = 0.0;
+    for (f64 sample : samples) {
+        total += sample;
+    }
+    summary.count = (u32)samples.size();
+    summary.mean  = total / samples.size();
+    summary.min   = samples.front();
+    summary.p50   = percentile(50.0);
+    summary.p95   = percentile(95.0);
+    summary.p99   = percentile(99.0);
+    summary.max   = samples.back();
+    return summary;
+}
+
+int Benchmark::run(const BenchmarkOptions& options) {
+    EngineCreation creation;
+    creation.headless         = options.headless;
+    creation.width            = options.width;
+    creation.height           = options.height;
+    creation.pacing           = options.pacing;
+    creation.frames_in_flight = options.frames_in_flight;
+
+    // Nothing that changes between runs on its own: no file watching, no validation overhead
+    m_engine.m_gpu.m_use_shader_hot_reload = false;
+    m_engine.m_gpu.m_use_validation_layers = options.validation;
+
+    const auto init_start = std::chrono::steady_clock::now();
+    m_engine.init(creation);
+    m_init_ms =
+        std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - init_start)
+            .count();
+
+    if (!options.model.empty() && !load_model(options)) {
+        m_engine.shutdown();
+        return 1;
+    }
+
+    const GPUProfiler& profiler       = m_engine.m_gpu.m_gpu_profiler;
+    const u32          measured_begin = options.warmup_frames;
+    const u32          measured_end   = options.warmup_frames + options.measured_frames;
+    // Timings of the last measured frames resolve this many frames later
+    const u32          frame_count    = measured_end + m_engine.m_gpu.m_frames_in_flight;
+    u64                last_resolved  = profiler.get_resolved_frame();
+
+    m_cpu_ms.reserve(options.measured_frames);
+    m_gpu_ms.reserve(options.measured_frames);
+
+    bool quit = false;
+    for (u32 frame = 0; frame < frame_count && !quit; ++frame) {
+        const auto frame_start = std::chrono::steady_clock::now();
+        m_engine.run_frame(quit);
+        const f64 frame_ms = std::chrono::duration<f64, std::milli>(
+                                 std::chrono::steady_clock::now() - frame_start)
+                                 .count();
+        if (frame >= measured_begin && frame < measured_end) {
+            m_cpu_ms.push_back(frame_ms);
+            sample_memory();
+        }
+
+        // Profiler frames count from 1, the one resolved belongs to engine frame resolved - 1
+        const u64 resolved = profiler.get_resolved_frame();
+        if (resolved != last_resolved) {
+            last_resolved = resolved;
+            if (resolved > measured_begin && resolved <= measured_end) {
+                for (const GPUScopeTiming& timing : profiler.get_timings()) {
+                    if (timing.depth == 0 && strcmp(timing.name, "Frame") == 0) {
+                        m_gpu_ms.push_back(timing.elapsed_ms);
+                    }
+                }
+            }
+        }
+    }
+
+    int exit_code = 0;
+    if (quit) {
+        spdlog::error("Window closed after {} of {} measured frames", m_cpu_ms.size(),
+                      options.measured_frames);
+        exit_code = 1;
+    } else if (!write_results(options)) {
+        spdlog::error("Failed to write benchmark results to {}", options.output);
+        exit_code = 1;
+    } else {
+        spdlog::info("Benchmark results written to {}", options.output);
+    }
+
+    destroy_model(m_engine.m_gpu, m_model);
+    m_engine.shutdown();
+    return exit_code;
+}
+
+bool Benchmark::load_model(const BenchmarkOptions& options) {
+    // The upload copies the data, so the arena is dropped right after it
+    Arena arena;
+    if (!arena.init(giga(4))) {
+        spdlog::error("Failed to reserve memory for {}", options.model);
+        return false;
+    }
+
+    // Cooked models are used in place, the mapping only has to outlive the upload's copy too
+    const bool cooked =
+        std::filesystem::path(options.model).extension() == k_cooked_model_extension;
+    MappedFile cooked_file;
+    ModelData  model;
+    const auto load_start = std::chrono::steady_clock::now();
+    const bool loaded =
+        (cooked ? load_cooked_model(options.model.c_str(), cooked_file, arena, model)
+                : load_gltf(options.model.c_str(), &m_engine.m_job_system, arena, model)) &&
+        upload_model(m_engine.m_gpu, model, m_model);
+    m_model_load_ms =
+        std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - load_start)
+            .count();
+    m_model_vertices   = model.vertex_count;
+    m_model_indices    = model.index_count;
+    m_model_primitives = model.primitive_count;
+    arena.shutdown();
+
+    if (!loaded) {
+        spdlog::error("Failed to load {}", options.model);
+    }
+    return loaded;
+}
+
+void Benchmark::sample_memory() {
+    m_heap_peak_bytes =
+        std::max(m_heap_peak_bytes, m_engine.m_heap_allocator.get_statistics().used_bytes);
+
+    VmaAllocator                            vma_allocator = m_engine.m_gpu.m_vma_allocator;
+    const VkPhysicalDeviceMemoryProperties* memory_properties;
+    vmaGetMemoryProperties(vma_allocator, &memory_properties);
+
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(vma_allocator, budgets);
+    VkDeviceSize usage = 0;
+    for (u32 i = 0; i < memory_properties->memoryHeapCount; ++i) {
+        usage += budgets[i].usage;
+    }
+    m_gpu_peak_bytes = std::max(m_gpu_peak_bytes, usage);
+}
+
+static void format_summary(std::string& text, cstring name, std::vector<f64> samples) {
+    if (samples.empty()) {
+        fmt::format_to(std::back_inserter(text), "  \"{}\": null,\n", name);
+        return;
+    }
+    SampleSummary s = summarize(samples);
+    fmt::format_to(std::back_inserter(text),
+                   "  \"{}\": {{\"count\": {}, \"mean\": {:.4f}, \"min\": {:.4f}, \"p50\": {:.4f}, "
+                   "\"p95\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f}}},\n",
+                   name, s.count, s.mean, s.min, s.p50, s.p95, s.p99, s.max);
+}
+
+bool Benchmark::write_results(const BenchmarkOptions& options) const {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_engine.m_gpu.m_chosen_GPU, &properties);
+
+    // Device names come from the driver, keep them printable and unquoted
+    std::string device_name;
+    for (const char* c = properties.deviceName; *c; ++c) {
+        device_name += (*c == '"' || *c == '\\' || *c < ' ') ? '_' : *c;
+    }
+
+    // What the driver granted, unsupported modes fall back to FIFO
+    cstring present_mode =
+        options.headless ? "none" : string_VkPresentModeKHR(m_engine.m_gpu.m_vulkan_present_mode);
+
+    std::string text = "{\n";
+    fmt::format_to(std::back_inserter(text),
+                   "  \"config\": {{\"warmup_frames\": {}, \"measured_frames\": {}, \"width\": {}, "
+                   "\"height\": {}, \"pacing\": \"{}\", \"present_mode\": \"{}\", "
+                   "\"headless\": {}, \"validation\": {}, \"frames_in_flight\": {}}},\n",
+                   options.warmup_frames, options.measured_frames, options.width, options.height,
+                   get_frame_pacing_name(options.pacing), present_mode, options.headless,
+                   options.validation, m_engine.m_gpu.m_frames_in_flight);
+    fmt::format_to(std::back_inserter(text),
+                   "  \"device\": {{\"name\": \"{}\", \"vendor_id\": {}, \"device_id\": {}, "
+                   "\"driver_version\": {}, \"api_version\": {}}},\n",
+                   device_name, properties.vendorID, properties.deviceID,
+                   properties.driverVersion, properties.apiVersion);
+    const std::string model_ms =
+        options.model.empty() ? "null" : fmt::format("{:.3f}", m_model_load_ms);
+    fmt::format_to(std::back_inserter(text),
+                   "  \"startup_ms\": {{\"init\": {:.3f}, \"pipelines\": {:.3f}, "
+                   "\"model\": {}}},\n",
+                   m_init_ms, m_engine.m_gpu.m_pipeline_startup_ms, model_ms);
+    if (!options.model.empty()) {
+        fmt::format_to(std::back_inserter(text),
+                       "  \"model\": {{\"vertices\": {}, \"indices\": {}, "
+                       "\"primitives\": {}}},\n",
+                       m_model_vertices, m_model_indices, m_model_primitives);
+    }
+
+    format_summary(text, "cpu_frame_ms", m_cpu_ms);
+    format_summary(text, "gpu_frame_ms", m_gpu_ms);
+
+    fmt::format_to(std::back_inserter(text),
+                   "  \"memory\": {{\"heap_peak_bytes\": {}, \"gpu_peak_bytes\": {}, "
+                   "\"allocators\": [",
+                   m_heap_peak_bytes, m_gpu_peak_bytes);
+    TrackingAllocator* trackers[32];
+    const u32          tracker_count = TrackingAllocator::get_registered(trackers);
+    for (u32 i = 0; i < tracker_count; ++i) {
+        AllocationStats stats = trackers[i]->get_stats();
+        fmt::format_to(std::back_inserter(text), "{}{{\"tag\": \"{}\", \"peak_bytes\": {}}}",
+                       i == 0 ? "" : ", ", stats.tag, stats.peak_bytes);
+    }
+    text += "]}\n}\n";
+
+    return write_file_atomic(options.output.c_str(), text.data(), text.size());
+}
+
+} // namespace fizzbench
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <engine.hpp>
+#include <renderer/gpu_model.hpp>
+#include <foundation/platform.hpp>
+
+namespace fizzbench {
+
+struct BenchmarkOptions {
+    u32                     warmup_frames    = 100;
+    u32                     measured_frames  = 1000;
+    u32                     width            = 1280;
+    u32                     height           = 720;
+    bool                    headless         = false;
+    // Immediate so results measure the engine rather than the display's refresh rate
+    fizzengine::FramePacing pacing           = fizzengine::k_pacing_immediate;
+    u32                     frames_in_flight = k_max_frames_in_flight;
+    bool                    validation       = false;
+    std::string             output           = "bench_results.json";
+    // glTF or cooked model loaded and uploaded after init, its load time is reported with the
+    // startup times
+    std::string             model;
+};
+
+// Returns false on malformed arguments or --help, after printing the usage
+bool parse_options(int argc, char* argv[], BenchmarkOptions& out_options);
+
+struct SampleSummary {
+    u32 count = 0;
+    f64 mean  = 0.0;
+    f64 min   = 0.0;
+    f64 p50   = 0.0;
+    f64 p95   = 0.0;
+    f64 p99   = 0.0;
+    f64 max   = 0.0;
+};
+
+// Nearest rank percentiles, sorts samples in place
+SampleSummary summarize(std::vector<f64>& samples);
+
+// Runs the engine's frame for a fixed number of warm-up frames, which are discarded, then for the
+// measured frames, and writes the results as JSON. Every run of the same options renders the same
+// frames, so results of two commits can be compared directly.
+// CPU time is the wall time of one engine frame, fence waits included. GPU time is the Frame
+// scope of the GPU profiler, it resolves frames in flight later, so a few extra frames are run
+// at the end to read back the last measured ones.
+class Benchmark {
+  public:
+    // Returns the process exit code
+    int run(const BenchmarkOptions& options);
+
+  private:
+    bool load_model(const BenchmarkOptions& options);
+    void sample_memory();
+    bool write_results(const BenchmarkOptions& options) const;
+
+    fizzengine::FizzEngine m_engine;
+
+    f64                    m_init_ms          = 0.0;
+    f64                    m_model_load_ms    = 0.0;
+    fizzengine::GPUModel   m_model;
+    u32                    m_model_vertices   = 0;
+    u32                    m_model_indices    = 0;
+    u32                    m_model_primitives = 0;
+    std::vector<f64>       m_cpu_ms;
+    std::vector<f64>       m_gpu_ms;
+    sizet                  m_heap_peak_bytes = 0;
+    VkDeviceSize           m_gpu_peak_bytes  = 0;
+};
+
+} // namespace fizzbench
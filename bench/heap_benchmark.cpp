@@ -0,0 +1,204 @@
+#include <foundation/allocators.hpp>
+#include <foundation/platform.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(FIZZ_PLATFORM_WINDOWS)
+#include <malloc.h>
+#endif
+
+// Churn benchmark of the TLSF HeapAllocator against the system allocator. Both replay the same
+// seeded trace of allocations and frees: mostly small blocks with some up to 64KB, alignments up
+// to 128 and a bounded number of live blocks. Every block is filled on allocation and checked on
+// free, so overlapping or misaligned blocks fail the run.
+
+namespace fizzbench {
+
+using namespace fizzengine;
+
+struct HeapBenchmarkOptions {
+    // Steps of the trace, each allocates or frees one block
+    u32 operations  = 400000;
+    u32 live_blocks = 2000;
+    // Best of this many runs is reported
+    u32 repeats     = 3;
+    // Size of the heap's first pool, it grows as the trace needs
+    u32 pool_kb     = 4096;
+};
+
+struct LiveBlock {
+    u8*   pointer;
+    sizet size;
+    u8    value;
+};
+
+// What malloc based HeapAllocator did before TLSF, with the alignment it ignored honoured
+static void* system_allocate(sizet size, sizet alignment) {
+    alignment = alignment < sizeof(void*) ? sizeof(void*) : alignment;
+#if defined(FIZZ_PLATFORM_WINDOWS)
+    return _aligned_malloc(size, alignment);
+#else
+    // aligned_alloc wants the size to be a multiple of the alignment
+    return aligned_alloc(alignment, memory_align(size, alignment));
+#endif
+}
+
+static void system_deallocate(void* pointer) {
+#if defined(FIZZ_PLATFORM_WINDOWS)
+    _aligned_free(pointer);
+#else
+    free(pointer);
+#endif
+}
+
+// Milliseconds to replay the trace, negative when a block was missing, misaligned or overwritten
+template <typename Allocate, typename Deallocate>
+static f64 run_trace(const HeapBenchmarkOptions& options, Allocate&& allocate,
+                     Deallocate&& deallocate) {
+    std::mt19937           random(42);
+    std::vector<LiveBlock> live;
+    live.reserve(options.live_blocks);
+    u32 errors = 0;
+
+    auto free_block = [&](sizet index) {
+        const LiveBlock block = live[index];
+        for (sizet i = 0; i < block.size; i += 97) {
+            errors += block.pointer[i] != block.value;
+        }
+        errors += block.pointer[block.size - 1] != block.value;
+        deallocate(block.pointer);
+        live[index] = live.back();
+        live.pop_back();
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    for (u32 i = 0; i < options.operations; ++i) {
+        if (live.size() < options.live_blocks && random() % 3 != 0) {
+            const sizet size      = random() % 4 == 0 ? random() % 65536 + 1 : random() % 256 + 1;
+            const sizet alignment = sizet(1) << (random() % 8);
+            u8*         pointer   = (u8*)allocate(size, alignment);
+            if (!pointer || (sizet)pointer % alignment != 0) {
+                ++errors;
+                continue;
+            }
+            const u8 value = (u8)random();
+            memset(pointer, value, size);
+            live.push_back({pointer, size, value});
+        } else if (!live.empty()) {
+            free_block(random() % live.size());
+        }
+    }
+    while (!live.empty()) {
+        free_block(live.size() - 1);
+    }
+    const f64 elapsed_ms =
+        std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (errors != 0) {
+        fprintf(stderr, "%u errors in the trace\n", errors);
+        return -1.0;
+    }
+    return elapsed_ms;
+}
+
+static void print_usage() {
+    printf("Usage: FizzHeapBench [options]\n"
+           "  --operations <n>         Allocations and frees in the trace (default 400000)\n"
+           "  --live <n>               Most blocks alive at once (default 2000)\n"
+           "  --repeats <n>            Runs per allocator, the best is kept (default 3)\n"
+           "  --pool-kb <n>            First pool of the heap in KB (default 4096)\n");
+}
+
+static bool parse_u32(cstring text, u32 min_value, u32& out_value) {
+    char*               end   = nullptr;
+    const unsigned long value = strtoul(text, &end, 10);
+    if (end == text || *end != '\0' || value < min_value || value > 0xffffffffu) {
+        return false;
+    }
+    out_value = (u32)value;
+    return true;
+}
+
+static bool parse_options(int argc, char* argv[], HeapBenchmarkOptions& out_options) {
+    for (int i = 1; i < argc; ++i) {
+        cstring arg   = argv[i];
+        cstring value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool    valid = true;
+
+        if (strcmp(arg, "--help") == 0) {
+            print_usage();
+            return false;
+        }
+
+        if (!value) {
+            valid = false;
+        } else if (strcmp(arg, "--operations") == 0) {
+            valid = parse_u32(value, 1, out_options.operations);
+        } else if (strcmp(arg, "--live") == 0) {
+            valid = parse_u32(value, 1, out_options.live_blocks);
+        } else if (strcmp(arg, "--repeats") == 0) {
+            valid = parse_u32(value, 1, out_options.repeats);
+        } else if (strcmp(arg, "--pool-kb") == 0) {
+            valid = parse_u32(value, 1, out_options.pool_kb);
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument %s\n", arg);
+            print_usage();
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+static int run(const HeapBenchmarkOptions& options) {
+    f64            heap_ms   = 0.0;
+    f64            system_ms = 0.0;
+    HeapStatistics statistics;
+    for (u32 r = 0; r < options.repeats; ++r) {
+        // A fresh heap every run, so each one starts from the same single pool
+        HeapAllocator heap;
+        if (!heap.init(kilo(options.pool_kb))) {
+            fprintf(stderr, "Failed to create the heap\n");
+            return 1;
+        }
+        const f64 heap_run = run_trace(
+            options, [&](sizet size, sizet alignment) { return heap.allocate(size, alignment); },
+            [&](void* pointer) { heap.deallocate(pointer); });
+        statistics = heap.get_statistics();
+        heap.shutdown();
+
+        const f64 system_run = run_trace(options, system_allocate, system_deallocate);
+        if (heap_run < 0.0 || system_run < 0.0) {
+            return 1;
+        }
+        heap_ms   = r == 0 || heap_run < heap_ms ? heap_run : heap_ms;
+        system_ms = r == 0 || system_run < system_ms ? system_run : system_ms;
+    }
+
+    printf("%u operations, at most %u live blocks, best of %u\n", options.operations,
+           options.live_blocks, options.repeats);
+    printf("%-10s %10.1f ms\n", "tlsf", heap_ms);
+    printf("%-10s %10.1f ms\n", "system", system_ms);
+    printf("Heap after the trace: %u pools, %zu bytes, largest free block %zu bytes\n",
+           statistics.pool_count, statistics.total_bytes, statistics.largest_free_block);
+    return 0;
+}
+
+} // namespace fizzbench
+
+int main(int argc, char* argv[]) {
+    fizzbench::HeapBenchmarkOptions options;
+    if (!fizzbench::parse_options(argc, argv, options)) {
+        return 2;
+    }
+    return fizzbench::run(options);
+}
@@ -0,0 +1,13 @@
+#define SDL_MAIN_HANDLED
+
+#include "benchmark.hpp"
+
+int main(int argc, char* argv[]) {
+    fizzbench::BenchmarkOptions options;
+    if (!fizzbench::parse_options(argc, argv, options)) {
+        return 2;
+    }
+
+    fizzbench::Benchmark benchmark;
+    return benchmark.run(options);
+}
@@ -0,0 +1,358 @@
+#include <foundation/allocators.hpp>
+#include <foundation/concurrent_pool.hpp>
+#include <foundation/platform.hpp>
+#include <foundation/resource_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <latch>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Stress test and microbenchmark of ConcurrentPool against Pool<T> behind a mutex. Every thread
+// keeps a window of live handles and releases its oldest one for each new obtain, the way jobs
+// create and retire short lived resources. The objects are tagged by their owner and checked on
+// release, so a slot handed out twice or a corrupted free list fails the run.
+
+namespace fizzbench {
+
+using namespace fizzengine;
+
+// Live handles per thread
+static const u32 k_window = 16;
+
+struct PoolBenchmarkOptions {
+    u32 max_threads = 32;
+    // Obtain and release pairs per thread
+    u32 operations  = 1000000;
+    // Best of this many runs is reported, it is the one least disturbed by the rest of the system
+    u32 repeats     = 3;
+};
+
+// One cache line, like the render resources the pools hold
+struct PoolObject {
+    u32 owner;
+    u32 sequence;
+    u8  payload[56];
+};
+
+struct MutexPool {
+    struct ThreadState {};
+
+    void init(Allocator* allocator, u32 pool_size) {
+        pool.init(allocator, pool_size);
+    }
+    void shutdown() {
+        pool.shutdown();
+    }
+    u32 get_used() const {
+        return pool.used_resources;
+    }
+
+    ResourceHandle obtain(ThreadState&) {
+        std::lock_guard lock(mutex);
+        return pool.obtain();
+    }
+    void release(ThreadState&, ResourceHandle handle) {
+        std::lock_guard lock(mutex);
+        pool.release(handle);
+    }
+    // The handle check reads the shared live set, so lookups take the lock as well
+    PoolObject* get(ResourceHandle handle) {
+        std::lock_guard lock(mutex);
+        return pool.get(handle);
+    }
+    void finish(ThreadState&) {
+    }
+
+    Pool<PoolObject> pool;
+    std::mutex       mutex;
+};
+
+struct LockFreePool {
+    struct ThreadState {};
+
+    void init(Allocator* allocator, u32 pool_size) {
+        pool.init(allocator, pool_size);
+    }
+    void shutdown() {
+        pool.shutdown();
+    }
+    u32 get_used() const {
+        return pool.get_used_resources();
+    }
+
+    ResourceHandle obtain(ThreadState&) {
+        return pool.obtain();
+    }
+    void release(ThreadState&, ResourceHandle handle) {
+        pool.release(handle);
+    }
+    PoolObject* get(ResourceHandle handle) {
+        return pool.get(handle);
+    }
+    void finish(ThreadState&) {
+    }
+
+    ConcurrentPool<PoolObject> pool;
+};
+
+// Same pool, obtains and releases go through a per thread cache
+struct CachedPool {
+    using ThreadState = ConcurrentPoolCache;
+
+    void init(Allocator* allocator, u32 pool_size) {
+        pool.init(allocator, pool_size);
+    }
+    void shutdown() {
+        pool.shutdown();
+    }
+    u32 get_used() const {
+        return pool.get_used_resources();
+    }
+
+    ResourceHandle obtain(ThreadState& cache) {
+        return pool.obtain(cache);
+    }
+    void release(ThreadState& cache, ResourceHandle handle) {
+        pool.release(cache, handle);
+    }
+    PoolObject* get(ResourceHandle handle) {
+        return pool.get(handle);
+    }
+    void finish(ThreadState& cache) {
+        pool.flush_cache(cache);
+    }
+
+    ConcurrentPool<PoolObject> pool;
+};
+
+// Each thread holds its window plus what a cache keeps, spilling it is left to the pool
+static u32 get_pool_size(u32 thread_count) {
+    return thread_count * (k_window + 2 * ConcurrentPoolCache::k_capacity);
+}
+
+template <typename Variant>
+static u32 run_worker(Variant& variant, u32 owner, u32 operations, bool stress) {
+    typename Variant::ThreadState state{};
+    ResourceHandle                window[k_window];
+    u32                           sequences[k_window];
+    u32                           first  = 0;
+    u32                           count  = 0;
+    u32                           errors = 0;
+
+    auto release_oldest = [&]() {
+        const ResourceHandle handle = window[first];
+        const PoolObject*    object = variant.get(handle);
+        if (!object || object->owner != owner || object->sequence != sequences[first]) {
+            ++errors;
+        }
+        variant.release(state, handle);
+        // Stale handles must stop resolving, whoever got the slot in the meantime
+        if (stress && variant.get(handle)) {
+            ++errors;
+        }
+        first = (first + 1) % k_window;
+        --count;
+    };
+
+    for (u32 i = 0; i < operations; ++i) {
+        if (count == k_window) {
+            release_oldest();
+        }
+        const ResourceHandle handle = variant.obtain(state);
+        PoolObject*          object = variant.get(handle);
+        if (!object) {
+            ++errors;
+            continue;
+        }
+        object->owner                         = owner;
+        object->sequence                      = i;
+        window[(first + count) % k_window]    = handle;
+        sequences[(first + count) % k_window] = i;
+        ++count;
+    }
+    while (count != 0) {
+        release_oldest();
+    }
+    variant.finish(state);
+    return errors;
+}
+
+// Millions of obtain and release pairs per second, 0 when the pool misbehaved
+template <typename Variant>
+static f64 run_variant(Allocator* allocator, u32 thread_count, u32 operations, bool stress) {
+    Variant variant;
+    variant.init(allocator, get_pool_size(thread_count));
+
+    std::vector<std::thread> threads;
+    std::vector<u32>         errors(thread_count, 0);
+    std::latch               start(thread_count + 1);
+    for (u32 t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            start.arrive_and_wait();
+            errors[t] = run_worker(variant, t, operations, stress);
+        });
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    start.arrive_and_wait();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const f64 seconds =
+        std::chrono::duration<f64>(std::chrono::steady_clock::now() - begin).count();
+
+    u32 total_errors = 0;
+    for (u32 e : errors) {
+        total_errors += e;
+    }
+    if (variant.get_used() != 0) {
+        ++total_errors;
+    }
+
+    // Every slot has to come back exactly once: a lost or duplicated free list entry shows up as
+    // a short pool or as an index handed out twice
+    if (stress) {
+        typename Variant::ThreadState state{};
+        const u32                     pool_size = get_pool_size(thread_count);
+        std::vector<ResourceHandle>   handles;
+        std::vector<bool>             seen(pool_size, false);
+        for (u32 i = 0; i < pool_size; ++i) {
+            const ResourceHandle handle = variant.obtain(state);
+            if (!handle.is_valid() || seen[handle.index]) {
+                ++total_errors;
+                break;
+            }
+            seen[handle.index] = true;
+            handles.push_back(handle);
+        }
+        if (variant.obtain(state).is_valid()) {
+            ++total_errors;
+        }
+        for (ResourceHandle handle : handles) {
+            variant.release(state, handle);
+        }
+        variant.finish(state);
+    }
+    variant.shutdown();
+
+    if (total_errors != 0) {
+        fprintf(stderr, "%u errors with %u threads\n", total_errors, thread_count);
+        return 0.0;
+    }
+    return (f64)thread_count * operations / seconds / 1e6;
+}
+
+template <typename Variant>
+static f64 best_of(Allocator* allocator, u32 thread_count, const PoolBenchmarkOptions& options) {
+    f64 best = 0.0;
+    for (u32 r = 0; r < options.repeats; ++r) {
+        const f64 result = run_variant<Variant>(allocator, thread_count, options.operations, false);
+        if (result == 0.0) {
+            return 0.0;
+        }
+        best = std::max(best, result);
+    }
+    return best;
+}
+
+static void print_usage() {
+    printf("Usage: FizzPoolBench [options]\n"
+           "  --threads <n>            Highest thread count, doubled from 1 (default 32)\n"
+           "  --operations <n>         Obtain and release pairs per thread (default 1000000)\n"
+           "  --repeats <n>            Runs per measurement, the best is kept (default 3)\n");
+}
+
+static bool parse_u32(cstring text, u32 min_value, u32& out_value) {
+    char*               end   = nullptr;
+    const unsigned long value = strtoul(text, &end, 10);
+    if (end == text || *end != '\0' || value < min_value || value > 0xffffffffu) {
+        return false;
+    }
+    out_value = (u32)value;
+    return true;
+}
+
+static bool parse_options(int argc, char* argv[], PoolBenchmarkOptions& out_options) {
+    for (int i = 1; i < argc; ++i) {
+        cstring arg   = argv[i];
+        cstring value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool    valid = true;
+
+        if (strcmp(arg, "--help") == 0) {
+            print_usage();
+            return false;
+        }
+
+        if (!value) {
+            valid = false;
+        } else if (strcmp(arg, "--threads") == 0) {
+            valid = parse_u32(value, 1, out_options.max_threads);
+        } else if (strcmp(arg, "--operations") == 0) {
+            valid = parse_u32(value, 1, out_options.operations);
+        } else if (strcmp(arg, "--repeats") == 0) {
+            valid = parse_u32(value, 1, out_options.repeats);
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument %s\n", arg);
+            print_usage();
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+static int run(const PoolBenchmarkOptions& options) {
+    HeapAllocator heap;
+    if (!heap.init()) {
+        fprintf(stderr, "Failed to create the heap\n");
+        return 1;
+    }
+
+    // The stress pass runs the most threads with the extra checks, before anything is timed
+    const u32 stress_operations = std::max(options.operations / 10, 1u);
+    if (run_variant<LockFreePool>(&heap, options.max_threads, stress_operations, true) == 0.0 ||
+        run_variant<CachedPool>(&heap, options.max_threads, stress_operations, true) == 0.0) {
+        fprintf(stderr, "Stress test failed\n");
+        heap.shutdown();
+        return 1;
+    }
+    printf("Stress test passed with %u threads, %u operations each\n\n", options.max_threads,
+           stress_operations);
+
+    printf("Millions of obtain and release pairs per second, best of %u\n", options.repeats);
+    printf("%8s %12s %12s %12s\n", "threads", "mutex", "lock-free", "cached");
+    int result = 0;
+    for (u32 threads = 1; threads <= options.max_threads; threads *= 2) {
+        const f64 mutex     = best_of<MutexPool>(&heap, threads, options);
+        const f64 lock_free = best_of<LockFreePool>(&heap, threads, options);
+        const f64 cached    = best_of<CachedPool>(&heap, threads, options);
+        printf("%8u %12.2f %12.2f %12.2f\n", threads, mutex, lock_free, cached);
+        if (mutex == 0.0 || lock_free == 0.0 || cached == 0.0) {
+            result = 1;
+        }
+    }
+    printf("Hardware threads: %u\n", std::thread::hardware_concurrency());
+
+    heap.shutdown();
+    return result;
+}
+
+} // namespace fizzbench
+
+int main(int argc, char* argv[]) {
+    fizzbench::PoolBenchmarkOptions options;
+    if (!fizzbench::parse_options(argc, argv, options)) {
+        return 2;
+    }
+    return fizzbench::run(options);
+}
@@ -0,0 +1,63 @@
+# Offline shader build. Every shaders/<name>.<stage>.slang is compiled to SPIR-V with slangc at
+# build time, then the blobs are written into a generated source file that is linked into the
+# target. Files without a stage in their name are modules that only get imported.
+
+find_program(SLANGC_EXECUTABLE slangc HINTS "$ENV{VULKAN_SDK}/Bin" "$ENV{VULKAN_SDK}/bin" REQUIRED)
+
+set(FIZZ_EMBED_SPIRV_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/embed_spirv.cmake")
+
+function(fizz_embed_shaders target shader_dir)
+    file(GLOB shader_sources CONFIGURE_DEPENDS "${shader_dir}/*.slang")
+    set(spirv_dir "${CMAKE_CURRENT_BINARY_DIR}/shaders")
+    file(MAKE_DIRECTORY ${spirv_dir})
+
+    set(spirv_files)
+    set(shader_names)
+    foreach(source ${shader_sources})
+        get_filename_component(name ${source} NAME)
+        if (NOT name MATCHES "^[^.]+\\.([^.]+)\\.slang$")
+            continue()
+        endif()
+
+        if (CMAKE_MATCH_1 STREQUAL "comp")
+            set(stage compute)
+        elseif (CMAKE_MATCH_1 STREQUAL "vert")
+            set(stage vertex)
+        elseif (CMAKE_MATCH_1 STREQUAL "frag")
+            set(stage fragment)
+        else()
+            message(WARNING "Unknown shader stage '${CMAKE_MATCH_1}' in ${name}, skipped")
+            continue()
+        endif()
+
+        # Same target profile as the runtime compiler in vk_utils.cpp. The depfile lists every
+        # include and imported module, so editing one of them rebuilds this shader.
+        set(spirv "${spirv_dir}/${name}.spv")
+        add_custom_command(
+            OUTPUT ${spirv}
+            COMMAND ${SLANGC_EXECUTABLE} ${source} -entry main -stage ${stage} -target spirv
+                    -profile spirv_1_5 -o ${spirv} -depfile ${spirv}.d
+            MAIN_DEPENDENCY ${source}
+            DEPFILE ${spirv}.d
+            COMMENT "Compiling shader ${name}"
+            VERBATIM
+        )
+        list(APPEND spirv_files ${spirv})
+        list(APPEND shader_names ${name})
+    endforeach()
+
+    # Lists cannot be passed through -D as is, the script splits them again
+    string(REPLACE ";" "|" spirv_argument "${spirv_files}")
+    string(REPLACE ";" "|" names_argument "${shader_names}")
+
+    set(generated "${CMAKE_CURRENT_BINARY_DIR}/embedded_shaders_data.cpp")
+    add_custom_command(
+        OUTPUT ${generated}
+        COMMAND ${CMAKE_COMMAND} -DSPIRV_FILES=${spirv_argument} -DSHADER_NAMES=${names_argument}
+                -DOUTPUT=${generated} -P ${FIZZ_EMBED_SPIRV_SCRIPT}
+        DEPENDS ${spirv_files} ${FIZZ_EMBED_SPIRV_SCRIPT}
+        COMMENT "Embedding SPIR-V"
+        VERBATIM
+    )
+    target_sources(${target} PRIVATE ${generated})
+endfunction()
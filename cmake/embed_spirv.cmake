@@ -0,0 +1,45 @@
+# Script mode, run by fizz_embed_shaders. Writes the SPIR-V blobs as constexpr word arrays plus
+# the table get_embedded_shaders() returns.
+#   SPIRV_FILES  | separated .spv paths
+#   SHADER_NAMES | separated source file names, same order
+#   OUTPUT       generated .cpp
+
+string(REPLACE "|" ";" spirv_files "${SPIRV_FILES}")
+string(REPLACE "|" ";" shader_names "${SHADER_NAMES}")
+
+set(arrays "")
+set(entries "")
+set(index 0)
+foreach(spirv ${spirv_files})
+    list(GET shader_names ${index} name)
+
+    file(READ ${spirv} hex HEX)
+    string(LENGTH "${hex}" hex_length)
+    math(EXPR word_count "${hex_length} / 8")
+
+    # SPIR-V is a stream of little endian words, eight per line
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " words "${hex}")
+    set(word "0x[0-9a-f]+, ")
+    string(REGEX REPLACE "(${word}${word}${word}${word}${word}${word}${word}${word})" "\\1\n    "
+           words "${words}")
+
+    string(APPEND arrays "static constexpr u32 k_shader_${index}[] = {\n    ${words}\n};\n\n")
+    string(APPEND entries "    {\"${name}\", \"main\", k_shader_${index}, ${word_count}},\n")
+    math(EXPR index "${index} + 1")
+endforeach()
+
+if (index EQUAL 0)
+    set(table "std::span<const EmbeddedShader> get_embedded_shaders() {\n    return {};\n}\n")
+else()
+    set(table "static constexpr EmbeddedShader k_embedded_shaders[] = {\n${entries}};\n\n")
+    string(APPEND table "std::span<const EmbeddedShader> get_embedded_shaders() {\n")
+    string(APPEND table "    return k_embedded_shaders;\n}\n")
+endif()
+
+file(WRITE ${OUTPUT}
+    "// Generated by cmake/embed_spirv.cmake, do not edit\n"
+    "#include <renderer/embedded_shaders.hpp>\n\n"
+    "namespace fizzengine {\n\n"
+    "${arrays}${table}\n"
+    "} // namespace fizzengine\n"
+)
@@ -0,0 +1,215 @@
+#include "cooker.hpp"
+
+#include <assets/cooked_model.hpp>
+#include <assets/gltf_loader.hpp>
+#include <foundation/file.hpp>
+#include <foundation/hash.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <set>
+
+namespace fizzcooker {
+
+using namespace fizzengine;
+
+// Bump when the loaders or the cooker change what a source cooks to, so every model is cooked
+// again even though its sources did not change. Format changes are caught by the file version.
+static const u32 k_cooker_version = 1;
+
+static void print_usage() {
+    printf("Usage: FizzCooker [options] <input>...\n"
+           "  <input>                  glTF or GLB file, or a directory searched recursively\n"
+           "  --output <directory>     Where cooked files are written (default cooked)\n"
+           "  --force                  Cook every input, even when it is up to date\n");
+}
+
+bool parse_options(int argc, char* argv[], CookerOptions& out_options) {
+    for (int i = 1; i < argc; ++i) {
+        cstring arg = argv[i];
+
+        if (strcmp(arg, "--help") == 0) {
+            print_usage();
+            return false;
+        } else if (strcmp(arg, "--force") == 0) {
+            out_options.force = true;
+        } else if (strcmp(arg, "--output") == 0 && i + 1 < argc) {
+            out_options.output = argv[++i];
+        } else if (strncmp(arg, "--", 2) == 0) {
+            fprintf(stderr, "Invalid argument %s\n", arg);
+            print_usage();
+            return false;
+        } else {
+            out_options.inputs.push_back(arg);
+        }
+    }
+
+    if (out_options.inputs.empty()) {
+        fprintf(stderr, "No inputs\n");
+        print_usage();
+        return false;
+    }
+    return true;
+}
+
+static bool is_source_model(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](char c) { return (char)tolower((unsigned char)c); });
+    return extension == ".gltf" || extension == ".glb";
+}
+
+static bool hash_file(const std::filesystem::path& path, u64& hash) {
+    MappedFile file;
+    if (!file.open(path.string().c_str())) {
+        return false;
+    }
+    hash = hash_bytes(file.get_data(), file.get_size(), hash);
+    return true;
+}
+
+// Everything a cooked model is built from: the cooker, the source and every file it references.
+// Fails when any of them is missing, which has the model cooked again and the error reported.
+static bool hash_source(const std::filesystem::path&    source,
+                        const std::vector<std::string>& dependencies, u64& out_hash) {
+    u64 hash = hash_bytes(&k_cooker_version, sizeof(k_cooker_version));
+    if (!hash_file(source, hash)) {
+        return false;
+    }
+    for (const std::string& dependency : dependencies) {
+        hash = hash_string(dependency.c_str(), hash);
+        if (!hash_file(source.parent_path() / dependency, hash)) {
+            return false;
+        }
+    }
+    out_hash = hash;
+    return true;
+}
+
+int Cooker::run(const CookerOptions& options) {
+    const auto start = std::chrono::steady_clock::now();
+
+    // Pairs of source and output, in a stable order so logs of two runs compare line by line
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> models;
+    const std::filesystem::path output_directory(options.output);
+    for (const std::string& input : options.inputs) {
+        std::error_code             error;
+        const std::filesystem::path input_path(input);
+        if (std::filesystem::is_directory(input_path, error)) {
+            std::vector<std::filesystem::path> sources;
+            for (const auto& entry :
+                 std::filesystem::recursive_directory_iterator(input_path, error)) {
+                if (entry.is_regular_file() && is_source_model(entry.path())) {
+                    sources.push_back(entry.path());
+                }
+            }
+            std::sort(sources.begin(), sources.end());
+            for (const std::filesystem::path& source : sources) {
+                models.emplace_back(source,
+                                    output_directory / source.lexically_relative(input_path));
+            }
+        } else if (std::filesystem::is_regular_file(input_path, error)) {
+            models.emplace_back(input_path, output_directory / input_path.filename());
+        } else {
+            spdlog::error("Input {} does not exist", input);
+            return 1;
+        }
+    }
+
+    std::set<std::filesystem::path> outputs;
+    for (auto& [source, output] : models) {
+        output.replace_extension(k_cooked_model_extension);
+        if (!outputs.insert(output).second) {
+            spdlog::error("{} and another source both cook to {}", source.string(),
+                          output.string());
+            return 1;
+        }
+    }
+
+    if (!m_arena.init(giga(4))) {
+        spdlog::error("Failed to reserve memory for cooking");
+        return 1;
+    }
+    m_job_system.init();
+
+    u32 counts[k_cook_failed + 1] = {};
+    for (const auto& [source, output] : models) {
+        ++counts[cook_model(source, output, options.force)];
+    }
+
+    m_job_system.shutdown();
+    m_arena.shutdown();
+
+    const f64 elapsed_ms =
+        std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("{} cooked, {} up to date, {} failed in {:.1f} ms", counts[k_cook_done],
+                 counts[k_cook_up_to_date], counts[k_cook_failed], elapsed_ms);
+    return counts[k_cook_failed] == 0 ? 0 : 1;
+}
+
+Cooker::CookResult Cooker::cook_model(const std::filesystem::path& source,
+                                      const std::filesystem::path& output, bool force) {
+    const std::string source_name = source.string();
+    const std::string output_name = output.string();
+
+    // The dependencies of the last cook tell what to hash without parsing the source
+    u64                      cooked_hash = 0;
+    u64                      source_hash = 0;
+    std::vector<std::string> dependencies;
+    if (!force && read_cooked_model_source(output_name.c_str(), cooked_hash, dependencies) &&
+        hash_source(source, dependencies, source_hash) && source_hash == cooked_hash) {
+        spdlog::info("{} is up to date", output_name);
+        return k_cook_up_to_date;
+    }
+
+    m_arena.reset();
+    m_image_files.clear();
+    dependencies.clear();
+
+    ModelData model;
+    if (!load_gltf(source_name.c_str(), &m_job_system, m_arena, model, &dependencies) ||
+        !embed_images(source.parent_path(), model)) {
+        spdlog::error("Failed to cook {}", source_name);
+        return k_cook_failed;
+    }
+    // The dependencies are only known once the source is parsed
+    if (!hash_source(source, dependencies, source_hash)) {
+        spdlog::error("Failed to hash {} and the files it references", source_name);
+        return k_cook_failed;
+    }
+
+    std::error_code error;
+    if (output.has_parent_path()) {
+        std::filesystem::create_directories(output.parent_path(), error);
+    }
+    if (error || !write_cooked_model(output_name.c_str(), model, source_hash, dependencies)) {
+        spdlog::error("Failed to write {}", output_name);
+        return k_cook_failed;
+    }
+    spdlog::info("Cooked {} to {}", source_name, output_name);
+    return k_cook_done;
+}
+
+// Cooked models reference no other files, images the source only refers to are read in
+bool Cooker::embed_images(const std::filesystem::path& directory, ModelData& model) {
+    for (u32 i = 0; i < model.image_count; ++i) {
+        ImageSource& image = model.images[i];
+        if (image.data || !image.uri) {
+            continue;
+        }
+        const std::filesystem::path path = directory / image.uri;
+        std::vector<u8>&            data = m_image_files.emplace_back();
+        if (!read_file(path.string().c_str(), data)) {
+            spdlog::error("Failed to read image {}", path.string());
+            return false;
+        }
+        image.data = data.data();
+        image.size = data.size();
+    }
+    return true;
+}
+
+} // namespace fizzcooker
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <assets/model.hpp>
+#include <foundation/allocators.hpp>
+#include <foundation/job_system.hpp>
+#include <foundation/platform.hpp>
+
+namespace fizzcooker {
+
+struct CookerOptions {
+    // Source files, or directories that are searched recursively for .gltf and .glb files
+    std::vector<std::string> inputs;
+    std::string              output = "cooked";
+    // Cook everything, even sources whose hash matches their cooked file
+    bool                     force  = false;
+};
+
+// Returns false on malformed arguments or --help, after printing the usage
+bool parse_options(int argc, char* argv[], CookerOptions& out_options);
+
+// Converts source models into cooked .fzm files under the output directory, mirroring the layout
+// of each input directory. Every cooked file records a hash of its source and of every file the
+// source references, a source whose hash still matches is skipped. Hashes cover content rather
+// than timestamps, so a fresh checkout or a copied tree does not cook everything again.
+class Cooker {
+  public:
+    // Returns the process exit code
+    int run(const CookerOptions& options);
+
+  private:
+    enum CookResult : u32 {
+        k_cook_done = 0,
+        k_cook_up_to_date,
+        k_cook_failed
+    };
+
+    CookResult cook_model(const std::filesystem::path& source, const std::filesystem::path& output,
+                          bool force);
+    bool       embed_images(const std::filesystem::path& directory,
+                            fizzengine::ModelData&       model);
+
+    fizzengine::JobSystem          m_job_system;
+    fizzengine::Arena              m_arena;
+    // Backing storage of images read from files, the model references them until it is written
+    std::vector<std::vector<u8>>   m_image_files;
+};
+
+} // namespace fizzcooker
@@ -0,0 +1,11 @@
+#include "cooker.hpp"
+
+int main(int argc, char* argv[]) {
+    fizzcooker::CookerOptions options;
+    if (!fizzcooker::parse_options(argc, argv, options)) {
+        return 2;
+    }
+
+    fizzcooker::Cooker cooker;
+    return cooker.run(options);
+}
@@ -5,6 +5,7 @@
 #include <foundation/platform.hpp>
 
 struct SDL_Window;
+union SDL_Event;
 namespace fizzengine {
 
 struct WindowDims {
@@ -25,12 +26,23 @@ class Window {
     WindowDims get_dimensions() const {
         return WindowDims{m_width, m_height};
     }
+    // Blocks while the window is minimized, there is nothing to render into until it's restored
     void handle_events(bool& quit);
+    // True once after the window changed size, the dimensions are already updated
+    bool consume_resize() {
+        const bool resized = m_resized;
+        m_resized          = false;
+        return resized;
+    }
 
   private:
+    void        process_event(const SDL_Event& event, bool& quit);
+
     std::string m_title;
     u32         m_width{0};
     u32         m_height{0};
+    bool        m_minimized{false};
+    bool        m_resized{false};
     SDL_Window* p_window_handle = nullptr;
 };
 
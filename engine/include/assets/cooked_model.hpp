@@ -0,0 +1,37 @@
+#pragma once
+
+#include <assets/model.hpp>
+#include <foundation/allocators.hpp>
+#include <foundation/file.hpp>
+
+#include <string>
+#include <vector>
+
+namespace fizzengine {
+
+static const cstring k_cooked_model_extension = ".fzm";
+
+// Cooked models are ModelData written as is: a header followed by one 16 byte aligned section per
+// array, referenced by file offset instead of pointer. Loading maps the file and points the model
+// at the sections, so vertices and indices go from the page cache straight into the GPU upload.
+// The layout is the in memory one of a little endian 64 bit build, any change to the structs in
+// model.hpp has to bump the version in cooked_model.cpp.
+//
+// Images keep their encoded bytes, external images are embedded by the cooker so a cooked model
+// does not reference any other file. dependencies and source_hash are only read by the cooker, to
+// tell whether the source changed since it was cooked.
+bool write_cooked_model(cstring path, const ModelData& model, u64 source_hash,
+                        const std::vector<std::string>& dependencies);
+
+// Maps path into file and points out_model at it. Only the image table needs its pointers fixed
+// up and is allocated from arena, everything else stays in the read only mapping: out_model is
+// valid while file stays open and must not be written to. The header and every section are
+// bounds checked, index values are trusted to be as valid as they were when cooking.
+bool load_cooked_model(cstring path, MappedFile& file, Arena& arena, ModelData& out_model);
+
+// Reads the source hash and dependencies recorded by write_cooked_model. Returns false when the
+// file is missing, corrupt or of another version, which all mean it has to be cooked again.
+bool read_cooked_model_source(cstring path, u64& out_source_hash,
+                              std::vector<std::string>& out_dependencies);
+
+} // namespace fizzengine
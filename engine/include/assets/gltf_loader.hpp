@@ -0,0 +1,24 @@
+#pragma once
+
+#include <assets/model.hpp>
+#include <foundation/allocators.hpp>
+#include <foundation/job_system.hpp>
+
+#include <string>
+#include <vector>
+
+namespace fizzengine {
+
+// Loads a glTF 2.0 model, .gltf with external or base64 buffers, or .glb. Files are memory
+// mapped, the JSON is parsed into a scratch arena and the accessors of every triangle primitive
+// are decoded in batches across the job system, straight into the model's vertex and index
+// arrays. Sparse accessors, morph targets and skins are not supported. Images are only
+// referenced, not decoded, and missing normals or UVs are left zero. job_system may be nullptr
+// to decode on the calling thread.
+// Everything in out_model is allocated from arena. Returns false after logging the reason.
+// out_dependencies, when set, receives the external buffer and image files the model references,
+// relative to its directory, for tools that need to know when a model changed.
+bool load_gltf(cstring path, JobSystem* job_system, Arena& arena, ModelData& out_model,
+               std::vector<std::string>* out_dependencies = nullptr);
+
+} // namespace fizzengine
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <foundation/platform.hpp>
+
+namespace fizzengine {
+
+static const u32 k_invalid_image = 0xffffffff;
+
+// Shaders pull vertices through the buffer's device address, the layout matches theirs
+struct Vertex {
+    f32 position[3];
+    f32 normal[3];
+    f32 uv[2];
+};
+
+// Range of a model's shared vertex and index arrays. Indices are relative to vertex_offset, as
+// vkCmdDrawIndexed expects them.
+struct Primitive {
+    u32 first_index;
+    u32 index_count;
+    u32 vertex_offset;
+    u32 vertex_count;
+    u32 material;
+    f32 bounds_min[3];
+    f32 bounds_max[3];
+};
+
+struct Mesh {
+    u32 first_primitive;
+    u32 primitive_count;
+};
+
+enum AlphaMode : u8 {
+    k_alpha_opaque = 0,
+    k_alpha_mask,
+    k_alpha_blend
+};
+
+// Metallic roughness material. Textures are indices into ModelData::images, k_invalid_image when
+// the material does not use one.
+struct Material {
+    f32 base_color_factor[4]     = {1.0f, 1.0f, 1.0f, 1.0f};
+    f32 emissive_factor[3]       = {0.0f, 0.0f, 0.0f};
+    f32 metallic_factor          = 1.0f;
+    f32 roughness_factor         = 1.0f;
+    f32 alpha_cutoff             = 0.5f;
+    u32 base_color_image         = k_invalid_image;
+    u32 metallic_roughness_image = k_invalid_image;
+    u32 normal_image             = k_invalid_image;
+    u32 occlusion_image          = k_invalid_image;
+    u32 emissive_image           = k_invalid_image;
+    u8  alpha_mode               = k_alpha_opaque;
+    u8  double_sided             = 0;
+};
+
+// Column major transforms. parent is u32_max for roots, mesh for nodes that only group others.
+struct Node {
+    f32 local[16];
+    f32 world[16];
+    u32 parent;
+    u32 mesh;
+};
+
+// Encoded image file, PNG or JPEG. Either a path relative to the model or the file's bytes when
+// it was embedded.
+struct ImageSource {
+    cstring   uri;
+    cstring   mime_type;
+    const u8* data;
+    u64       size;
+};
+
+// Everything a model needs on the CPU, in flat arrays allocated from the Arena it was loaded with.
+// Dropping the arena frees the whole model.
+struct ModelData {
+    Vertex*      vertices        = nullptr;
+    u32*         indices         = nullptr;
+    Primitive*   primitives      = nullptr;
+    Mesh*        meshes          = nullptr;
+    Material*    materials       = nullptr;
+    Node*        nodes           = nullptr;
+    ImageSource* images          = nullptr;
+
+    u32          vertex_count    = 0;
+    u32          index_count     = 0;
+    u32          primitive_count = 0;
+    u32          mesh_count      = 0;
+    u32          material_count  = 0;
+    u32          node_count      = 0;
+    u32          image_count     = 0;
+};
+
+} // namespace fizzengine
@@ -1,21 +1,45 @@
 #pragma once
 
+#include <foundation/allocators.hpp>
+#include <foundation/job_system.hpp>
 #include <foundation/platform.hpp>
+#include <foundation/tracking_allocator.hpp>
 
 #include <application/window.hpp>
 #include <renderer/renderer.hpp>
 
 namespace fizzengine {
 
+struct EngineCreation {
+    // No window, ImGui or presentation. Frames render offscreen, e.g. on a software rasterizer
+    // on machines without a GPU or display.
+    bool        headless         = false;
+    u32         width            = 1280;
+    u32         height           = 720;
+    // run returns after this many frames, 0 runs until the window closes
+    u32         max_frames       = 0;
+    FramePacing pacing           = k_pacing_vsync;
+    // 1 to k_max_frames_in_flight, fewer trade CPU and GPU overlap for latency
+    u32         frames_in_flight = k_max_frames_in_flight;
+};
+
 class FizzEngine {
   public:
-    void            init();
+    void            init(const EngineCreation& creation = {});
     void            shutdown();
     void            update();
     void            render();
     void            run();
+    // One iteration of run: events, UI and a rendered frame. quit is set when the window closes.
+    void            run_frame(bool& quit);
 
     bool            is_initialized{false};
+    bool            m_headless{false};
+    u32             m_max_frames{0};
+
+    HeapAllocator     m_heap_allocator;
+    TrackingAllocator m_gpu_allocator;
+    JobSystem         m_job_system;
 
     Window          m_window{"Fizz Engine", 1280, 720};
     GPUDevice       m_gpu;
@@ -25,6 +49,8 @@ class FizzEngine {
   private:
     void init_imgui();
     void draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView);
+    void draw_memory_panel();
+    void draw_profiler_panel();
 };
 
 } // namespace fizzengine
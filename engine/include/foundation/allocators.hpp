@@ -2,6 +2,8 @@
 
 #include <foundation/platform.hpp>
 
+#include <mutex>
+
 namespace fizzengine {
 
 struct Allocator {
@@ -11,6 +13,10 @@ struct Allocator {
     virtual void  deallocate(void* pointer)             = 0;
 };
 
+static const sizet k_default_alignment = 16;
+
+sizet              memory_align(sizet size, sizet alignment);
+
 constexpr sizet giga(sizet gigs) {
     return gigs * 1024 * 1024 * 1024; // NOLINT
 }
@@ -28,29 +34,142 @@ class Arena : public Allocator {
     Arena()  = default; // Default constructor, no initialization
     ~Arena() = default; // Default destructor, no cleanup
 
-    // Initialize the allocator with a given size (default 1GB)
-    bool  init(size_t size = mega(64)); // NOLINT
+    // Initialize the allocator with a given size (default 64MB). Huge pages back the arena with
+    // 2MB transparent huge pages where the platform supports it, use them for big scratch arenas
+    bool  init(size_t size = mega(64), bool use_huge_pages = false); // NOLINT
     // Shutdown and release all resources
     void  shutdown();
 
     void* allocate(size_t size, size_t alignment) override;
     void  deallocate(void* pointer) override;
 
+    // Rewind the arena, committed pages are kept around for the next round of allocations
+    void  reset();
+    sizet get_marker() const {
+        return allocated_size;
+    }
+    void  reset_to(sizet marker);
+    // Give committed pages past the current allocation back to the OS
+    void  decommit_unused();
+
+    sizet get_allocated_size() const {
+        return allocated_size;
+    }
+    sizet get_committed_size() const {
+        return committed_size;
+    }
+
   private:
     static const size_t PAGE_SIZE      = mega(1); // Size of dynamicaly allocated pages
+    static const size_t HUGE_PAGE_SIZE = mega(2); // Size of a transparent huge page
     u8*                 base           = nullptr;
     sizet               allocated_size = 0;
     size_t              committed_size = 0;
     size_t              total_size     = 0;
+    size_t              commit_size    = PAGE_SIZE;
+};
+
+// Linear allocator over a fixed block of memory. Allocations are a pointer bump and are freed in
+// stack order by rewinding to a marker taken earlier.
+class ArenaFixed : public Allocator {
+  public:
+    // Use caller owned memory
+    void  init(void* memory, sizet size);
+    // Allocate the block from a backing allocator, released again on shutdown
+    bool  init(Allocator* backing, sizet size);
+    void  shutdown();
+
+    void* allocate(sizet size, sizet alignment) override;
+    void  deallocate(void* pointer) override;
+
+    sizet get_marker() const {
+        return allocated_size;
+    }
+    void  free_to_marker(sizet marker);
+    void  clear();
+
+    sizet get_allocated_size() const {
+        return allocated_size;
+    }
+    sizet get_total_size() const {
+        return total_size;
+    }
+
+  private:
+    u8*        memory         = nullptr;
+    Allocator* backing        = nullptr;
+    sizet      allocated_size = 0;
+    sizet      total_size     = 0;
+};
+
+// One ArenaFixed region per frame in flight. A region is only rewound in begin_frame, which the
+// device calls once the fence of that frame signaled, so anything allocated while recording a
+// frame stays valid until the GPU is done with it.
+class FrameAllocator : public Allocator {
+  public:
+    static constexpr u32 k_max_frames = 4;
+
+    bool        init(Allocator* backing, sizet frame_size, u32 frame_count);
+    void        shutdown();
+
+    void        begin_frame(u32 frame_index);
+
+    void*       allocate(sizet size, sizet alignment) override;
+    void        deallocate(void* pointer) override;
+
+    ArenaFixed& get_current_region() {
+        return regions[current_frame];
+    }
+
+  private:
+    ArenaFixed regions[k_max_frames];
+    u8*        memory        = nullptr;
+    Allocator* backing       = nullptr;
+    u32        frame_count   = 0;
+    u32        current_frame = 0;
 };
 
-struct ArenaFixed : public Allocator {};
+struct HeapStatistics {
+    sizet total_bytes        = 0; // Bytes managed by the heap, pool overhead excluded
+    sizet used_bytes         = 0;
+    sizet free_bytes         = 0;
+    sizet largest_free_block = 0;
+    u32   allocation_count   = 0;
+    u32   pool_count         = 0;
+    f32   fragmentation      = 0.0f; // 1 - largest_free_block / free_bytes
+};
+
+struct HeapControl;
 
+// Two level segregated fit heap: free blocks are binned by power of two (first level) and a
+// linear split of that range (second level), and two bitmaps find a fitting bin, so both
+// allocate and deallocate are O(1). Memory comes in pools, taken from an Arena when one is given
+// and from malloc otherwise, and a new pool is added when the existing ones are exhausted. Each
+// new pool is twice the size of the previous one.
 struct HeapAllocator : public Allocator {
 
-    void* allocate(sizet size, sizet alignment) override;
+    bool           init(sizet pool_size = mega(32), Arena* backing_arena = nullptr); // NOLINT
+    void           shutdown();
 
-    void  deallocate(void* pointer) override;
+    void*          allocate(sizet size, sizet alignment) override;
+
+    void           deallocate(void* pointer) override;
+
+    HeapStatistics get_statistics() const;
+
+  private:
+    static constexpr u32 k_max_pools = 32;
+
+    bool               add_pool(sizet size);
+
+    HeapControl*       control          = nullptr;
+    Arena*             arena            = nullptr;
+    void*              pools[k_max_pools];
+    u32                pool_count       = 0;
+    sizet              pool_size        = 0; // Size of the next pool, doubles as the heap grows
+    sizet              used_bytes       = 0;
+    u32                allocation_count = 0;
+    mutable std::mutex mutex;
 };
 
 } // namespace fizzengine
\ No newline at end of file
@@ -0,0 +1,134 @@
+#pragma once
+#include <foundation/resource_pool.hpp>
+
+#include <atomic>
+
+namespace fizzengine {
+
+// Small stash of free slots owned by a single thread. Obtains and releases hit the stash first and
+// only go to the shared free list in batches, one CAS per batch.
+struct ConcurrentPoolCache {
+    static constexpr u32 k_capacity = 32;
+
+    u32              indices[k_capacity];
+    u32              count = 0;
+};
+
+// Thread safe counterpart of ResourcePool with the same slot layout. Free slots form an intrusive
+// lock-free list whose head is tagged with a counter in the upper 32 bits, so a head that was
+// popped and pushed back between a load and a CAS (ABA) fails the CAS instead of corrupting the
+// list. Generations are odd while a slot is live, which also makes double releases harmless.
+// There is no dense live set here, live iteration needs the single threaded Pool<T>.
+struct ConcurrentResourcePool {
+    void                   init(const ResourcePoolCreation& creation);
+    void                   shutdown();
+
+    ResourceHandle         obtain_resource();
+    ResourceHandle         obtain_resource(ConcurrentPoolCache& cache);
+    void                   release_resource(ResourceHandle handle);
+    void                   release_resource(ConcurrentPoolCache& cache, ResourceHandle handle);
+    // Returns every cached slot to the shared list, call before a worker thread exits
+    void                   flush_cache(ConcurrentPoolCache& cache);
+
+    bool                   is_valid(ResourceHandle handle) const;
+
+    void*                  access_resource(ResourceHandle handle);
+    const void*            access_resource(ResourceHandle handle) const;
+
+    u32                    get_used_resources() const {
+        return used_resources.load(std::memory_order_relaxed);
+    }
+
+    u8*                    pool_memory    = nullptr;
+    std::atomic<u32>*      generations    = nullptr;
+    std::atomic<u32>*      next_free      = nullptr;
+    Allocator*             allocator      = nullptr;
+
+    alignas(k_cache_line_size) std::atomic<u64> free_head{0};
+    alignas(k_cache_line_size) std::atomic<u32> used_resources{0};
+
+    u32                    pool_size      = 0;
+    u32                    resource_size  = 0;
+
+  protected:
+    // Generation CAS that claims a live slot for release, exactly one caller wins it. Stale and
+    // repeated releases lose and are logged.
+    bool                   mark_released(ResourceHandle handle);
+    // Hands a claimed slot back for reuse
+    void                   free_slot(u32 index);
+    void                   free_slot(ConcurrentPoolCache& cache, u32 index);
+
+  private:
+    u32                    pop_free(u32* indices, u32 max_count);
+    void                   push_free(const u32* indices, u32 count);
+};
+
+template <typename T>
+struct ConcurrentPool : public ConcurrentResourcePool {
+
+    void           init(Allocator* allocator, u32 pool_size);
+
+    ResourceHandle obtain();
+    ResourceHandle obtain(ConcurrentPoolCache& cache);
+    void           release(ResourceHandle handle);
+    void           release(ConcurrentPoolCache& cache, ResourceHandle handle);
+
+    T*             get(ResourceHandle handle);
+    const T*       get(ResourceHandle handle) const;
+};
+
+template <typename T>
+inline void ConcurrentPool<T>::init(Allocator* allocator, u32 pool_size_) {
+    ConcurrentResourcePool::init({.allocator          = allocator,
+                                  .pool_size          = pool_size_,
+                                  .resource_size      = sizeof(T),
+                                  .resource_alignment = alignof(T)});
+}
+
+template <typename T>
+inline ResourceHandle ConcurrentPool<T>::obtain() {
+    ResourceHandle handle = ConcurrentResourcePool::obtain_resource();
+    if (handle.is_valid()) {
+        new (&pool_memory[handle.index * resource_size]) T();
+    }
+    return handle;
+}
+
+template <typename T>
+inline ResourceHandle ConcurrentPool<T>::obtain(ConcurrentPoolCache& cache) {
+    ResourceHandle handle = ConcurrentResourcePool::obtain_resource(cache);
+    if (handle.is_valid()) {
+        new (&pool_memory[handle.index * resource_size]) T();
+    }
+    return handle;
+}
+
+// The slot is claimed before the object is destroyed, so of two threads releasing the same handle
+// only one destroys it, and get() stops returning it before it is torn down
+template <typename T>
+inline void ConcurrentPool<T>::release(ResourceHandle handle) {
+    if (ConcurrentResourcePool::mark_released(handle)) {
+        ((T*)&pool_memory[handle.index * resource_size])->~T();
+        ConcurrentResourcePool::free_slot(handle.index);
+    }
+}
+
+template <typename T>
+inline void ConcurrentPool<T>::release(ConcurrentPoolCache& cache, ResourceHandle handle) {
+    if (ConcurrentResourcePool::mark_released(handle)) {
+        ((T*)&pool_memory[handle.index * resource_size])->~T();
+        ConcurrentResourcePool::free_slot(cache, handle.index);
+    }
+}
+
+template <typename T>
+inline T* ConcurrentPool<T>::get(ResourceHandle handle) {
+    return (T*)ConcurrentResourcePool::access_resource(handle);
+}
+
+template <typename T>
+inline const T* ConcurrentPool<T>::get(ResourceHandle handle) const {
+    return (const T*)ConcurrentResourcePool::access_resource(handle);
+}
+
+} // namespace fizzengine
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <foundation/platform.hpp>
+
+#include <vector>
+
+namespace fizzengine {
+
+bool read_file(cstring path, std::vector<u8>& out_data);
+
+// Writes to a temporary next to path and renames it over path, so readers never see a partially
+// written file even if the process dies halfway through
+bool write_file_atomic(cstring path, const void* data, sizet size);
+
+// Read only view of a whole file through the page cache. Pages are read in on first touch, and
+// the kernel is asked to start reading the whole file right away, so nothing is copied into
+// process memory and parsing can start before the read finished.
+class MappedFile {
+  public:
+    MappedFile() = default;
+    ~MappedFile() {
+        close();
+    }
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool        open(cstring path);
+    void        close();
+
+    // nullptr for empty files
+    const u8*   get_data() const {
+        return data;
+    }
+    sizet       get_size() const {
+        return size;
+    }
+
+  private:
+    const u8* data = nullptr;
+    sizet     size = 0;
+#if defined(FIZZ_PLATFORM_WINDOWS)
+    void*     mapping = nullptr;
+#endif
+};
+
+} // namespace fizzengine
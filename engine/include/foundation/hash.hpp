@@ -0,0 +1,14 @@
+#pragma once
+
+#include <foundation/platform.hpp>
+
+namespace fizzengine {
+
+static const u64 k_hash_seed = 0xcbf29ce484222325ull;
+
+// 64 bit FNV-1a. Not cryptographic, used for cache keys and content hashes. Chain calls by
+// passing the previous result as the seed.
+u64              hash_bytes(const void* data, sizet size, u64 seed = k_hash_seed);
+u64              hash_string(cstring string, u64 seed = k_hash_seed);
+
+} // namespace fizzengine
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <foundation/platform.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace fizzengine {
+
+typedef void (*JobFunction)(void* data);
+
+// Wait group, incremented for every job submitted with it and decremented as they finish
+struct JobCounter {
+    std::atomic<i32> value{0};
+
+    bool             is_done() const {
+        return value.load(std::memory_order_acquire) == 0;
+    }
+};
+
+struct Job {
+    JobFunction function = nullptr;
+    void*       data     = nullptr;
+    JobCounter* counter  = nullptr;
+};
+
+// Chase-Lev deque. Only the owning worker pushes and pops at the bottom, everyone else steals
+// from the top. Slots are atomics so a thief reading a slot the owner is reusing is a benign
+// stale read rather than a data race, its CAS on top fails in that case.
+class WorkStealingQueue {
+  public:
+    static constexpr i64 k_capacity = 4096;
+
+    bool                 push(const Job& job);
+    bool                 pop(Job& job);
+    bool                 steal(Job& job);
+
+  private:
+    struct Slot {
+        std::atomic<JobFunction> function{nullptr};
+        std::atomic<void*>       data{nullptr};
+        std::atomic<JobCounter*> counter{nullptr};
+    };
+
+    void             store(i64 index, const Job& job);
+    Job              load(i64 index) const;
+
+    alignas(64) std::atomic<i64> top{0};
+    alignas(64) std::atomic<i64> bottom{0};
+    Slot             slots[k_capacity];
+};
+
+// One worker per core, the thread calling init becomes worker 0 and helps out whenever it waits
+// on a counter. Jobs submitted from a worker go to its own deque, idle workers steal from the
+// others. Threads that are not workers (loaders, watchers) submit through a locked queue.
+class JobSystem {
+  public:
+    // worker_count includes the calling thread, 0 picks one per hardware thread
+    void       init(u32 worker_count = 0);
+    void       shutdown();
+
+    void       run(const Job& job);
+    void       run(const Job* jobs, u32 count);
+    // Executes other jobs until the counter reaches zero
+    void       wait(JobCounter& counter);
+
+    // Splits [0, count) into batches and calls function(begin, end) for each across the workers,
+    // returns once every batch is done
+    template <typename Function>
+    void       parallel_for(u32 count, u32 batch_size, Function&& function);
+
+    u32        get_worker_count() const {
+        return worker_count;
+    }
+    // Index of the calling worker, k_invalid_worker for threads the system does not own
+    static u32 get_current_worker_index();
+
+    static constexpr u32 k_invalid_worker = 0xffffffff;
+
+  private:
+    void                                 worker_loop(u32 worker_index);
+    bool                                 try_execute(u32 worker_index);
+    bool                                 find_job(u32 worker_index, Job& job);
+    void                                 execute(const Job& job);
+    void                                 wake_workers(u32 count);
+
+    std::unique_ptr<WorkStealingQueue[]> queues;
+    std::vector<std::thread>             threads;
+    u32                                  worker_count = 0;
+
+    std::mutex                           external_mutex;
+    std::deque<Job>                      external_jobs;
+
+    std::atomic<bool>                    running{false};
+    // Queued jobs no worker has picked up yet, idle workers sleep while there are none
+    std::atomic<i32>                     pending_jobs{0};
+    std::atomic<i32>                     sleeping_workers{0};
+    std::mutex                           sleep_mutex;
+    std::condition_variable              sleep_condition;
+};
+
+template <typename Function>
+inline void JobSystem::parallel_for(u32 count, u32 batch_size, Function&& function) {
+    struct Batch {
+        std::remove_reference_t<Function>* function;
+        u32                                begin;
+        u32                                end;
+    };
+
+    if (count == 0) {
+        return;
+    }
+    batch_size            = batch_size ? batch_size : 1;
+    const u32 batch_count = (count + batch_size - 1) / batch_size;
+
+    std::vector<Batch> batches(batch_count);
+    std::vector<Job>   jobs(batch_count);
+    JobCounter         counter;
+
+    for (u32 i = 0; i < batch_count; ++i) {
+        batches[i].function = &function;
+        batches[i].begin    = i * batch_size;
+        batches[i].end      = (i + 1) * batch_size < count ? (i + 1) * batch_size : count;
+
+        jobs[i].function    = [](void* data) {
+            Batch* batch = static_cast<Batch*>(data);
+            (*batch->function)(batch->begin, batch->end);
+        };
+        jobs[i].data        = &batches[i];
+        jobs[i].counter     = &counter;
+    }
+
+    run(jobs.data(), batch_count);
+    wait(counter);
+}
+
+} // namespace fizzengine
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <foundation/allocators.hpp>
+#include <foundation/platform.hpp>
+
+#include <string_view>
+
+namespace fizzengine {
+
+enum JsonType : u8 {
+    k_json_null = 0,
+    k_json_bool,
+    k_json_number,
+    k_json_string,
+    k_json_array,
+    k_json_object
+};
+
+// Node of a parsed document. Arrays and objects store their children contiguously, objects keep
+// the keys in a parallel array in document order.
+struct JsonValue {
+    JsonType          type    = k_json_null;
+    bool              boolean = false;
+    u32               count   = 0; // Children of arrays and objects
+    f64               number  = 0.0;
+    std::string_view  string;
+    JsonValue*        children = nullptr;
+    std::string_view* keys     = nullptr;
+
+    bool              is_object() const {
+        return type == k_json_object;
+    }
+    bool              is_array() const {
+        return type == k_json_array;
+    }
+
+    // Linear search, objects in practice hold a handful of keys. nullptr when missing or when
+    // this is not an object.
+    const JsonValue* find(std::string_view key) const;
+    const JsonValue& operator[](u32 index) const {
+        return children[index];
+    }
+
+    // Whole number in [0, max_value]. Negative and fractional numbers and NaN fail, so a value
+    // that passes can be cast to an integer type holding max_value.
+    bool             is_integer(f64 max_value) const;
+
+    // Member lookups that fall back to default_value when the key is missing or of another type.
+    // get_u32 also falls back when the number does not pass is_integer(u32_max).
+    f64              get_number(std::string_view key, f64 default_value) const;
+    u32              get_u32(std::string_view key, u32 default_value) const;
+    bool             get_bool(std::string_view key, bool default_value) const;
+    std::string_view get_string(std::string_view key, std::string_view default_value = {}) const;
+};
+
+// Parses a whole document into a tree allocated from allocator, which is meant to be an Arena
+// that is dropped as a whole. Strings without escapes point into text, text has to outlive the
+// tree. Errors are logged with their offset.
+bool json_parse(const char* text, sizet length, Allocator* allocator, JsonValue& out_root);
+
+} // namespace fizzengine
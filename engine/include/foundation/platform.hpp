@@ -2,6 +2,13 @@
 
 #include <stdint.h>
 
+#if defined(_WIN32)
+#define FIZZ_PLATFORM_WINDOWS 1
+#elif defined(__linux__)
+#define FIZZ_PLATFORM_LINUX 1
+#endif
+
+#if defined(FIZZ_PLATFORM_WINDOWS)
 #ifdef FIZZENGINE_EXPORTS
 // When building the engine, export symbols
 #define FIZZENGINE_API __declspec(dllexport)
@@ -9,6 +16,9 @@
 // When using the engine in another project, import symbols
 #define FIZZENGINE_API __declspec(dllimport)
 #endif
+#else
+#define FIZZENGINE_API
+#endif
 
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_OFF
 #include <spdlog/spdlog.h>
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <foundation/platform.hpp>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace fizzengine {
+
+// Instrumentation profiler. Zones are written by the thread that ran them into its own ring
+// buffer, no locks and no shared cache lines, and only while a capture is running. A capture
+// spans a number of frames counted by profiler_frame_mark and is written out as a Chrome trace,
+// which chrome://tracing and ui.perfetto.dev both open.
+
+struct ProfileEvent {
+    cstring name;
+    u64     begin;
+    u64     end;
+};
+
+// Raw timestamps, the TSC on x86 (invariant on anything we run on) and the steady clock elsewhere.
+// Converted to microseconds against the steady clock on export.
+inline u64 profiler_timestamp() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+void profiler_init();
+void profiler_shutdown();
+
+// Name shown for the calling thread in the trace
+void profiler_set_thread_name(cstring name);
+
+// Starts capturing on the next frame mark, records frame_count frames and writes them to path
+void profiler_begin_capture(u32 frame_count, cstring path = "cpu_trace.json");
+bool profiler_is_capturing();
+// Call once per frame on the main thread, frames show up as zones named Frame
+void profiler_frame_mark();
+
+void profiler_record(cstring name, u64 begin, u64 end);
+
+struct ProfileZone {
+    explicit ProfileZone(cstring name) : name(name), begin(profiler_timestamp()) {
+    }
+    ~ProfileZone() {
+        profiler_record(name, begin, profiler_timestamp());
+    }
+
+    cstring name;
+    u64     begin;
+};
+
+} // namespace fizzengine
+
+#define FIZZ_CONCAT_IMPL(a, b) a##b
+#define FIZZ_CONCAT(a, b)      FIZZ_CONCAT_IMPL(a, b)
+
+#if defined(FIZZ_ENABLE_PROFILER)
+#define FIZZ_PROFILE_SCOPE(name)  ::fizzengine::ProfileZone FIZZ_CONCAT(fizz_zone_, __LINE__)(name)
+#define FIZZ_PROFILE_FUNCTION()   FIZZ_PROFILE_SCOPE(__func__)
+#define FIZZ_PROFILE_THREAD(name) ::fizzengine::profiler_set_thread_name(name)
+#define FIZZ_PROFILE_FRAME()      ::fizzengine::profiler_frame_mark()
+#else
+#define FIZZ_PROFILE_SCOPE(name)
+#define FIZZ_PROFILE_FUNCTION()
+#define FIZZ_PROFILE_THREAD(name)
+#define FIZZ_PROFILE_FRAME()
+#endif
@@ -2,79 +2,152 @@
 #include <foundation/allocators.hpp>
 #include <foundation/platform.hpp>
 
+#include <new>
+#include <span>
+#include <utility>
+
 namespace fizzengine {
 
-static const u32 k_invalid_index = 0xffffffff;
+static const u32   k_invalid_index   = 0xffffffff;
+static const sizet k_cache_line_size = 64;
+
+// Index into a pool plus the generation of the slot when it was handed out. Releasing a slot bumps
+// its generation, so handles kept around after a release are detected instead of aliasing the new
+// resource living in the same slot.
+struct ResourceHandle {
+    u32  index      = k_invalid_index;
+    u32  generation = 0;
+
+    bool is_valid() const {
+        return index != k_invalid_index;
+    }
+    bool operator==(const ResourceHandle& other) const = default;
+};
+
+static const ResourceHandle k_invalid_handle = {};
 
 struct ResourcePoolCreation {
     Allocator* allocator;
     u32        pool_size;
     u32        resource_size;
+    u32        resource_alignment = 1;
 };
 
+// Slots live in a single cache line aligned block. Alongside them a sparse set keeps the live
+// slots packed at the front of dense_indices (the tail is the free list), so live resources can
+// be walked without touching free slots.
 struct ResourcePool {
-    void        init(const ResourcePoolCreation& creation);
-    void        shutdown();
+    void                 init(const ResourcePoolCreation& creation);
+    void                 shutdown();
 
-    u32         obtain_resource();
-    void        release_resource(u32 handle);
-    void        free_all_resources();
+    ResourceHandle       obtain_resource();
+    void                 release_resource(ResourceHandle handle);
+    void                 free_all_resources();
 
-    void*       access_resource(u32 handle);
-    const void* access_resource(u32 handle) const;
+    bool                 is_valid(ResourceHandle handle) const;
+    ResourceHandle       get_handle(u32 index) const;
 
-    u8*         pool_memory    = nullptr;
-    u32*        free_indices   = nullptr;
-    Allocator*  allocator      = nullptr;
+    void*                access_resource(ResourceHandle handle);
+    const void*          access_resource(ResourceHandle handle) const;
 
-    u32         used_resources = 0;
-    u32         pool_size      = 0;
-    u32         resource_size  = 0;
+    // Slot access without the generation check, for indices coming from live_indices()
+    void*                access_slot(u32 index);
+    const void*          access_slot(u32 index) const;
+
+    std::span<const u32> live_indices() const {
+        return {dense_indices, used_resources};
+    }
+
+    u8*        pool_memory      = nullptr;
+    u32*       generations      = nullptr;
+    u32*       dense_indices    = nullptr;
+    u32*       sparse_positions = nullptr;
+    Allocator* allocator        = nullptr;
+
+    u32        used_resources   = 0;
+    u32        pool_size        = 0;
+    u32        resource_size    = 0; // Slot stride, object size rounded up to its alignment
 };
 
 template <typename T>
 struct Pool : public ResourcePool {
 
-    void     init(Allocator* allocator, u32 pool_size);
+    void           init(Allocator* allocator, u32 pool_size);
+    void           shutdown();
+
+    ResourceHandle obtain();
+    void           release(ResourceHandle handle);
+    void           free_all();
 
-    T*       obtain();
-    void     release(T* resource);
+    T*             get(ResourceHandle handle);
+    const T*       get(ResourceHandle handle) const;
 
-    T*       get(u32 index);
-    const T* get(u32 index) const;
+    // Calls function(handle, resource) for every live resource, in dense order
+    template <typename Function>
+    void for_each(Function&& function);
 };
 
 template <typename T>
 inline void Pool<T>::init(Allocator* allocator, u32 pool_size_) {
-    ResourcePool::init(
-        {.allocator = allocator, .pool_size = pool_size, .resource_size = sizeof(T)});
+    ResourcePool::init({.allocator          = allocator,
+                        .pool_size          = pool_size_,
+                        .resource_size      = sizeof(T),
+                        .resource_alignment = alignof(T)});
 }
 
 template <typename T>
-inline T* Pool<T>::obtain() {
-    u32 resource_index = ResourcePool::obtain_resource();
-    if (resource_index != k_invalid_index) {
-        T* resource          = get(resource_index);
-        resource->pool_index = resource_index;
-        return resource;
+inline void Pool<T>::shutdown() {
+    // Leaked objects are still destroyed, but the live count is left for ResourcePool::shutdown
+    // to report them
+    for (u32 index : live_indices()) {
+        static_cast<T*>(ResourcePool::access_slot(index))->~T();
     }
+    ResourcePool::shutdown();
+}
 
-    return nullptr;
+template <typename T>
+inline ResourceHandle Pool<T>::obtain() {
+    ResourceHandle handle = ResourcePool::obtain_resource();
+    if (handle.is_valid()) {
+        new (ResourcePool::access_slot(handle.index)) T();
+    }
+    return handle;
 }
 
 template <typename T>
-inline void Pool<T>::release(T* resource) {
-    ResourcePool::release_resource(resource->pool_index);
+inline void Pool<T>::release(ResourceHandle handle) {
+    T* resource = get(handle);
+    if (resource) {
+        resource->~T();
+        ResourcePool::release_resource(handle);
+    }
 }
 
 template <typename T>
-inline T* Pool<T>::get(u32 index) {
-    return (T*)ResourcePool::access_resource(index);
+inline void Pool<T>::free_all() {
+    for (u32 index : live_indices()) {
+        static_cast<T*>(ResourcePool::access_slot(index))->~T();
+    }
+    ResourcePool::free_all_resources();
 }
 
 template <typename T>
-inline const T* Pool<T>::get(u32 index) const {
-    return (const T*)ResourcePool::access_resource(index);
+inline T* Pool<T>::get(ResourceHandle handle) {
+    return (T*)ResourcePool::access_resource(handle);
+}
+
+template <typename T>
+inline const T* Pool<T>::get(ResourceHandle handle) const {
+    return (const T*)ResourcePool::access_resource(handle);
+}
+
+template <typename T>
+template <typename Function>
+inline void Pool<T>::for_each(Function&& function) {
+    for (u32 i = 0; i < used_resources; ++i) {
+        const u32 index = dense_indices[i];
+        function(get_handle(index), *static_cast<T*>(ResourcePool::access_slot(index)));
+    }
 }
 
-} // namespace fizzengine
\ No newline at end of file
+} // namespace fizzengine
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <foundation/allocators.hpp>
+#include <foundation/platform.hpp>
+
+#include <mutex>
+#include <span>
+#include <unordered_map>
+
+namespace fizzengine {
+
+struct AllocationStats {
+    static constexpr u32 k_histogram_buckets = 16; // 16B, 32B, ... up to 256KB and larger
+
+    cstring              tag               = "";
+    sizet                live_bytes        = 0;
+    sizet                peak_bytes        = 0;
+    sizet                total_bytes       = 0;
+    u32                  live_allocations  = 0;
+    u32                  total_allocations = 0;
+    u32                  size_histogram[k_histogram_buckets] = {};
+};
+
+// Decorator around another allocator that accounts every allocation under its tag. Give each
+// subsystem its own instance over the shared heap to get a per subsystem breakdown. Instances
+// register themselves so debug UI can list them, and report whatever is still live on shutdown.
+class TrackingAllocator : public Allocator {
+  public:
+    static constexpr u32 k_max_callstack_depth = 8;
+
+    void            init(cstring tag, Allocator* backing, bool capture_callstacks = false);
+    void            shutdown();
+
+    void*           allocate(sizet size, sizet alignment) override;
+    void            deallocate(void* pointer) override;
+
+    AllocationStats get_stats() const;
+
+    static u32      get_registered(std::span<TrackingAllocator*> out);
+
+  private:
+    struct AllocationRecord {
+        sizet size        = 0;
+        u32   frame_count = 0;
+        void* frames[k_max_callstack_depth];
+    };
+
+    void                                        report_leaks();
+
+    Allocator*                                  backing            = nullptr;
+    bool                                        capture_callstacks = false;
+    AllocationStats                             stats;
+    std::unordered_map<void*, AllocationRecord> allocations;
+    mutable std::mutex                          mutex;
+};
+
+} // namespace fizzengine
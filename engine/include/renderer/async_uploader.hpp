@@ -0,0 +1,95 @@
+#pragma once
+
+#include <renderer/barrier_builder.hpp>
+#include <renderer/vk_types.hpp>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fizzengine {
+
+// Streams data to the GPU on the transfer queue from a thread of its own. Every upload gets a
+// ticket, the value a timeline semaphore reaches once its copy finished. Batches are released from
+// the transfer queue family and acquire records the matching acquire barriers on a graphics command
+// buffer, so a frame only waits on the semaphore for the uploads it actually picks up.
+// Without a dedicated transfer family the same code runs on the graphics queue and the ownership
+// transfers collapse to plain barriers.
+class AsyncUploader {
+  public:
+    static constexpr u32 k_max_batches_in_flight = 4;
+
+    // queue_mutex guards vkQueueSubmit on the transfer queue against other users of the queue and
+    // device wide waits, nullptr when nothing else touches the queues
+    void init(VkDevice device, VmaAllocator vma_allocator, VkQueue transfer_queue,
+              u32 transfer_family, u32 graphics_family, std::mutex* queue_mutex);
+    void shutdown();
+
+    // data is copied before returning. Safe to call from any thread.
+    u64  upload_buffer(VkBuffer destination, VkDeviceSize destination_offset, const void* data,
+                       VkDeviceSize size);
+    // Replaces mip 0 of a color image, which ends up in final_layout once acquired
+    u64  upload_image(VkImage destination, VkExtent3D extent, const void* data, VkDeviceSize size,
+                      VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    bool is_complete(u64 ticket) const;
+
+    // Records acquire barriers on the graphics command buffer for every upload that has finished,
+    // plus every upload up to required_ticket whether finished or not. Returns the value the
+    // submission of cmd must wait for on get_semaphore(), 0 when there is nothing to wait on.
+    u64  acquire(VkCommandBuffer cmd, u64 required_ticket = 0);
+
+    VkSemaphore get_semaphore() const {
+        return timeline;
+    }
+
+  private:
+    struct Request {
+        u64           ticket;
+        VkBuffer      staging;
+        VmaAllocation staging_allocation;
+        // Either a buffer or an image destination
+        VkBuffer      buffer;
+        VkDeviceSize  buffer_offset;
+        VkDeviceSize  size;
+        VkImage       image;
+        VkExtent3D    extent;
+        VkImageLayout final_layout;
+    };
+
+    struct Batch {
+        VkCommandPool        command_pool;
+        VkCommandBuffer      command_buffer;
+        u64                  ticket = 0; // Signaled once the batch retired
+        std::vector<Request> requests;
+    };
+
+    u64  enqueue(Request& request, const void* data);
+    void worker_loop();
+    void submit(Batch& batch);
+    void release_staging(Batch& batch);
+
+    void ownership_barriers(const Request& request, bool acquire, BarrierBuilder& barriers) const;
+
+    VkDevice                device          = VK_NULL_HANDLE;
+    VmaAllocator            vma_allocator   = VK_NULL_HANDLE;
+    VkQueue                 queue           = VK_NULL_HANDLE;
+    u32                     transfer_family = 0;
+    u32                     graphics_family = 0;
+    std::mutex*             queue_mutex     = nullptr;
+    VkSemaphore             timeline        = VK_NULL_HANDLE;
+
+    Batch                   batches[k_max_batches_in_flight];
+    u32                     next_batch = 0;
+
+    std::thread             worker;
+    std::mutex              mutex;
+    std::condition_variable wake;
+    bool                    running     = false;
+    u64                     next_ticket = 1;
+    std::vector<Request>    pending;    // Waiting for the worker
+    std::vector<Request>    to_acquire; // Submitted or waiting, not acquired yet, ticket order
+};
+
+} // namespace fizzengine
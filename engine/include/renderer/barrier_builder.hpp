@@ -0,0 +1,62 @@
+#pragma once
+
+#include <renderer/vk_types.hpp>
+
+namespace fizzengine {
+
+// Subresources of an image, the whole image by default
+VkImageSubresourceRange subresource_range(VkImageAspectFlags aspect, u32 base_mip = 0,
+                                          u32 mip_count = VK_REMAINING_MIP_LEVELS,
+                                          u32 base_layer  = 0,
+                                          u32 layer_count = VK_REMAINING_ARRAY_LAYERS);
+
+// Collects image, buffer and global memory barriers with explicit stages and accesses and records
+// all of them with a single vkCmdPipelineBarrier2. Builders are cheap, keep one around and reuse it
+// so the barrier arrays keep their capacity.
+// With FIZZ_VALIDATE_BARRIERS every image barrier is checked against the layouts recorded so far
+// for images registered with track_image_layout, in recording order.
+class BarrierBuilder {
+  public:
+    BarrierBuilder& image(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout,
+                          VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access,
+                          VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access,
+                          const VkImageSubresourceRange& range =
+                              subresource_range(VK_IMAGE_ASPECT_COLOR_BIT));
+    BarrierBuilder& buffer(VkBuffer buffer, VkPipelineStageFlags2 src_stage,
+                           VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage,
+                           VkAccessFlags2 dst_access, VkDeviceSize offset = 0,
+                           VkDeviceSize size = VK_WHOLE_SIZE);
+    BarrierBuilder& memory(VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access,
+                           VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access);
+
+    // Turns the last image or buffer barrier into a queue family ownership transfer
+    BarrierBuilder& queue_transfer(u32 src_family, u32 dst_family);
+
+    bool            empty() const {
+        return image_barriers.empty() && buffer_barriers.empty() && memory_barriers.empty();
+    }
+    u32             count() const {
+        return (u32)(image_barriers.size() + buffer_barriers.size() + memory_barriers.size());
+    }
+
+    // Records everything added since the last flush, nothing when empty
+    void            flush(VkCommandBuffer cmd);
+    // Records the barriers and keeps them, for barriers compiled once and replayed
+    void            record(VkCommandBuffer cmd) const;
+    void            clear();
+
+  private:
+    enum LastBarrier : u8 { k_last_none, k_last_image, k_last_buffer };
+
+    std::vector<VkImageMemoryBarrier2>  image_barriers;
+    std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+    std::vector<VkMemoryBarrier2>       memory_barriers;
+    LastBarrier                         last = k_last_none;
+};
+
+// Layout tracking for FIZZ_VALIDATE_BARRIERS, no-ops otherwise. Untracked images are not checked.
+void track_image_layout(VkImage image, u32 mip_count, u32 layer_count,
+                        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+void untrack_image_layout(VkImage image);
+
+} // namespace fizzengine
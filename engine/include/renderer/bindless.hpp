@@ -0,0 +1,85 @@
+#pragma once
+
+#include <renderer/vk_types.hpp>
+
+#include <mutex>
+#include <vector>
+
+namespace fizzengine {
+
+enum BindlessType : u32 {
+    k_bindless_sampled_image = 0,
+    k_bindless_storage_image,
+    k_bindless_sampler,
+    k_bindless_buffer,
+    k_bindless_type_count
+};
+
+static constexpr u32 k_invalid_bindless_index = 0xffffffff;
+
+// One descriptor set for everything a shader can reach. Each binding is a large partially bound
+// array, resources get a stable index when they are added and shaders pick them by index from
+// push constants. Buffers are not descriptors at all, their device addresses live in a table
+// bound at k_bindless_buffer. The set is bound once per command buffer and never reallocated.
+class BindlessHeap {
+  public:
+    static constexpr u32 k_push_constant_size = 128;
+
+    void                  init(VkDevice device, VkPhysicalDevice physical_device,
+                               VmaAllocator vma_allocator, u32 frame_count);
+    void                  shutdown();
+
+    u32 add_sampled_image(VkImageView   view,
+                          VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    u32                   add_storage_image(VkImageView view);
+    u32                   add_sampler(VkSampler sampler);
+    u32                   add_buffer(VkDeviceAddress address);
+
+    // Frames still in flight may index the slot, it is reused once frame_index comes around
+    // again, see begin_frame
+    void                  release(BindlessType type, u32 index, u32 frame_index);
+    // Call after the fence of frame_index signaled
+    void                  begin_frame(u32 frame_index);
+
+    void                  bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point) const;
+
+    VkDescriptorSetLayout get_layout() const {
+        return layout;
+    }
+    // Global set plus k_push_constant_size bytes of push constants for every stage
+    VkPipelineLayout      get_pipeline_layout() const {
+        return pipeline_layout;
+    }
+
+  private:
+    static constexpr u32 k_max_frames = 4;
+
+    u32                  allocate_index(BindlessType type);
+    void                 write_image(BindlessType type, u32 index, VkImageView view,
+                                     VkImageLayout layout);
+
+    struct Slots {
+        u32              capacity   = 0;
+        u32              next_index = 0;
+        std::vector<u32> free_indices;
+        std::vector<u32> retired[k_max_frames];
+    };
+
+    VkDevice              device          = VK_NULL_HANDLE;
+    VmaAllocator          vma_allocator   = VK_NULL_HANDLE;
+    VkDescriptorPool      pool            = VK_NULL_HANDLE;
+    VkDescriptorSetLayout layout          = VK_NULL_HANDLE;
+    VkPipelineLayout      pipeline_layout = VK_NULL_HANDLE;
+    VkDescriptorSet       set             = VK_NULL_HANDLE;
+
+    VkBuffer              address_buffer  = VK_NULL_HANDLE;
+    VmaAllocation         address_allocation;
+    VkDeviceAddress*      addresses       = nullptr;
+
+    Slots                 slots[k_bindless_type_count];
+    u32                   frame_count     = 0;
+    // Loaders add resources from their own threads
+    std::mutex            mutex;
+};
+
+} // namespace fizzengine
@@ -1,6 +1,16 @@
 #pragma once
 
+#include <foundation/allocators.hpp>
+#include <foundation/job_system.hpp>
+#include <foundation/profiler.hpp>
+#include <foundation/resource_pool.hpp>
+#include <renderer/async_uploader.hpp>
+#include <renderer/bindless.hpp>
+#include <renderer/gpu_profiler.hpp>
 #include <renderer/gpu_resources.hpp>
+#include <renderer/render_graph.hpp>
+#include <renderer/shader_hot_reload.hpp>
+#include <renderer/upload_manager.hpp>
 #include <renderer/vk_types.hpp>
 
 namespace vkb {
@@ -9,11 +19,24 @@ class Device;
 } // namespace vkb
 class SDL_Window;
 
-constexpr unsigned int k_frames_in_flight = 3;
+constexpr unsigned int k_max_frames_in_flight = 3;
+constexpr unsigned int k_max_buffers          = 4096;
 
 namespace fizzengine {
 class Window;
 
+enum FramePacing : u32 {
+    k_pacing_vsync = 0, // FIFO, never tears, up to frames in flight frames of queued latency
+    k_pacing_mailbox,   // Newest frame wins at vblank, falls back to FIFO where unsupported
+    k_pacing_immediate, // Tears, for measuring the engine rather than the display
+    // FIFO, and the CPU waits for the previous frame to finish before sampling input, so a frame
+    // never queues behind another one. Costs some throughput, the CPU and GPU no longer overlap.
+    k_pacing_low_latency,
+    k_pacing_count
+};
+
+cstring get_frame_pacing_name(FramePacing pacing);
+
 // clang-format off
 struct DeletionQueue {
 
@@ -34,21 +57,45 @@ struct DeletionQueue {
 };
 // clang-format on
 
+// Secondary command buffers of one worker for one frame. Buffers are handed out linearly and the
+// whole pool is reset once the frame retires, so nothing is reset or freed one buffer at a time.
+struct WorkerCommandPool {
+    VkCommandPool                m_command_pool;
+    std::vector<VkCommandBuffer> m_command_buffers;
+    u32                          m_used_command_buffers = 0;
+};
+
 struct FrameData {
-    VkCommandPool   m_command_pool;
-    VkCommandBuffer m_main_command_buffer;
+    VkCommandPool                  m_command_pool;
+    VkCommandBuffer                m_main_command_buffer;
+    std::vector<WorkerCommandPool> m_worker_pools; // Indexed by job system worker
+
+    // Transient sets for this frame only, all pools are reset once the frame retires
+    DescriptorAllocator            m_descriptor_allocator;
 
-    DeletionQueue   m_deletion_queue;
+    DeletionQueue                  m_deletion_queue;
 };
 
 struct GPUDevice {
     bool                     m_use_validation_layers{true};
+    // No surface or swapchain, frames render into a ring of offscreen targets and are only
+    // submitted. Set before init_vulkan, the window is then never touched beyond its size.
+    bool                     m_headless{false};
+    // Set before init_vulkan, 1 to k_max_frames_in_flight. Pacing can change later on.
+    u32                      m_frames_in_flight{k_max_frames_in_flight};
+    FramePacing              m_frame_pacing{k_pacing_vsync};
+#if defined(FIZZ_EMBED_SHADERS)
+    bool                     m_use_shader_hot_reload{false}; // Shaders are baked into the binary
+#else
+    bool                     m_use_shader_hot_reload{true};
+#endif
     VkInstance               m_instance;
     VkDebugUtilsMessengerEXT m_debug_messenger;
     VkPhysicalDevice         m_chosen_GPU;
     VkDevice                 m_device;
     VkSurfaceKHR             m_surface;
     VmaAllocator             m_vma_allocator;
+    bool                     m_supports_pipeline_statistics{false};
 
     VkSwapchainKHR           m_swapchain;
     VkPresentModeKHR         m_vulkan_present_mode;
@@ -57,38 +104,73 @@ struct GPUDevice {
     Texture                  m_draw_image;
     VkExtent2D               m_draw_extent;
 
+    // Offscreen targets in headless mode, one per frame in flight
     std::vector<VkImage>     m_swapchain_images;
     std::vector<VkImageView> m_swapchain_image_views;
     VkExtent2D               m_swapchain_extent;
 
-    u32                      m_frame_number;
+    u32                      m_frame_number{0};
     u32                      m_vulkan_image_index;
 
-    FrameData                m_frames[k_frames_in_flight];
+    FrameData                m_frames[k_max_frames_in_flight];
 
     // Per frame sync
-    VkSemaphore              m_image_acquired_semaphore[k_frames_in_flight];
-    VkSemaphore              m_render_complete_semaphore[k_frames_in_flight];
-    VkFence                  m_command_buffer_executed_fence[k_frames_in_flight];
+    VkSemaphore              m_image_acquired_semaphore[k_max_frames_in_flight];
+    VkSemaphore              m_render_complete_semaphore[k_max_frames_in_flight];
+    VkFence                  m_command_buffer_executed_fence[k_max_frames_in_flight];
 
     VkQueue                  m_graphics_queue;
     uint32_t                 m_graphics_queue_family;
+    // Dedicated transfer queue when the device has one, otherwise the graphics queue
+    VkQueue                  m_transfer_queue;
+    uint32_t                 m_transfer_queue_family;
+    // Held for any host access to a queue, as the upload thread submits concurrently. That covers
+    // submits, presents, ImGui's platform windows and device wide waits, which touch every queue.
+    std::mutex               m_queue_mutex;
 
     DescriptorAllocator      m_global_descriptor_allocator;
-
-    VkDescriptorSet          m_draw_image_descriptors;
-    VkDescriptorSetLayout    m_draw_image_descriptor_layout;
+    // Global set every pipeline binds, resources are addressed by index
+    BindlessHeap             m_bindless;
+
+    Pool<Buffer>             m_buffers;
+    // Staging for buffer and image uploads, flushed at the start of every frame
+    UploadManager            m_upload_manager;
+    // Streaming uploads on the transfer queue, finished ones are acquired every frame
+    AsyncUploader            m_async_uploader;
+    // Timeline value on m_async_uploader's semaphore the current frame's submit waits for
+    u64                      m_upload_wait_value{0};
+
+    // Shared by every pipeline creation, persisted to disk between runs
+    VkPipelineCache          m_pipeline_cache;
+    // Pipeline cache load, shader compilation and pipeline creation in init_vulkan
+    f64                      m_pipeline_startup_ms{0.0};
 
     VkPipeline               m_grad_pipeline;
-    VkPipelineLayout         m_grad_pipeline_layout;
+
+    // Rebuilt by the frame every time, begun in new_frame
+    RenderGraph              m_render_graph;
+
+    // Per pass GPU timings, read back frames in flight later
+    GPUProfiler              m_gpu_profiler;
+
+    // Rebuilds pipelines on shader edits, swapped in at the start of a frame
+    ShaderHotReload          m_shader_hot_reload;
 
     DeletionQueue            m_main_deletion_queue;
 
-    void                     init_vulkan(Window window);
+    Allocator*               m_allocator;
+    JobSystem*               m_job_system;
+    // Scratch memory for data recorded during a frame, rewound when that frame's fence signals
+    FrameAllocator           m_frame_allocator;
+
+    void                     init_vulkan(Window window, Allocator* allocator, JobSystem* job_system);
     void                     shutdown();
 
+    u32                      get_frame_index() const {
+        return m_frame_number % m_frames_in_flight;
+    }
     FrameData&               get_current_frame() {
-        return m_frames[m_frame_number % k_frames_in_flight];
+        return m_frames[get_frame_index()];
     }
 
     VkImage& get_current_swapchain_image() {
@@ -98,26 +180,110 @@ struct GPUDevice {
         return m_swapchain_image_views[m_vulkan_image_index];
     }
 
+    // Device local unless host_visible, in which case the buffer stays mapped. Every buffer can be
+    // an upload destination and has a device address, storage buffers also get a bindless slot.
+    ResourceHandle  create_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                  bool host_visible = false);
+    // The buffer is destroyed once the frames in flight that may still use it have retired
+    void            destroy_buffer(ResourceHandle handle);
+    Buffer*         get_buffer(ResourceHandle handle) {
+        return m_buffers.get(handle);
+    }
+
+    // Makes the current frame wait for an upload from m_async_uploader, finished or not, and
+    // acquires it on the frame's command buffer. Call before recording anything that reads it.
+    void            wait_for_upload(u64 ticket);
+
+    // With k_pacing_low_latency, blocks until the previous frame finished on the GPU. Call right
+    // before sampling input, everything after it then reaches the screen a frame sooner.
+    void            pace_frame();
+    // Switches the present mode, the swapchain is recreated at the start of the next frame
+    void            set_frame_pacing(FramePacing pacing);
+    // Recreates the swapchain at the start of the next frame, e.g. after the window was resized.
+    // Out of date and suboptimal swapchains are recreated without this.
+    void            invalidate_swapchain() {
+        m_swapchain_dirty = true;
+    }
+
+    // Waits for the frame slot and begins recording. VK_NULL_HANDLE when there is no swapchain
+    // image to render to, e.g. while minimized: skip the frame and do not call present.
     VkCommandBuffer new_frame();
+    // Submits the frame, and presents it unless headless
     void            present();
 
+    // Frames are numbered by m_frame_number at the time they were begun. Completion is read from
+    // the frame's fence, frames whose slot has been reused since are complete. Waiting on a frame
+    // that was not submitted yet returns right away.
+    bool            is_frame_complete(u32 frame_number);
+    void            wait_for_frame(u32 frame_number);
+
+    // Begins a secondary command buffer from the calling worker's pool. Pass rendering info to
+    // continue a dynamic rendering scope begun on the primary with
+    // VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT.
+    VkCommandBuffer
+    begin_secondary_command_buffer(const VkCommandBufferInheritanceRenderingInfo* rendering = nullptr);
+
+    // Records count secondary command buffers on the job system, record(index, cmd) runs on
+    // worker threads, then executes them on the primary in index order
+    template <typename Function>
+    void record_parallel(VkCommandBuffer primary, u32 count,
+                         const VkCommandBufferInheritanceRenderingInfo* rendering,
+                         Function&&                                     record);
+
   private:
     vkb::Device select_device(vkb::Instance vkb_inst);
 
+    SDL_Window* m_sdl_window{nullptr};
+    bool        m_swapchain_dirty{false};
+
     void        create_vulkan_surface(SDL_Window* window);
 
     void        create_draw_target(u32 width, u32 height);
 
-    void        create_swapchain(u32 width, u32 height);
+    void        create_swapchain(u32 width, u32 height,
+                                 VkSwapchainKHR old_swapchain = VK_NULL_HANDLE);
     void        destroy_swapchain();
+    // Builds the new swapchain from the old one, which is destroyed once the frames in flight
+    // that may still present its images have retired. Nothing waits for the device to go idle.
+    // Returns false while the window is minimized.
+    bool        recreate_swapchain();
+    void        create_offscreen_targets(u32 width, u32 height);
 
     void        init_commands();
+    void        reset_command_pools(FrameData& frame);
 
     void        init_sync_structures();
 
     void        init_descriptors();
 
+    void        init_pipeline_cache();
+    void        save_pipeline_cache();
+
     void        init_pipelines();
     void        init_grad_pipeline();
 };
+
+template <typename Function>
+inline void GPUDevice::record_parallel(VkCommandBuffer primary, u32 count,
+                                       const VkCommandBufferInheritanceRenderingInfo* rendering,
+                                       Function&&                                     record) {
+    if (count == 0) {
+        return;
+    }
+
+    VkCommandBuffer* secondaries = static_cast<VkCommandBuffer*>(
+        m_frame_allocator.allocate(sizeof(VkCommandBuffer) * count, alignof(VkCommandBuffer)));
+
+    m_job_system->parallel_for(count, 1, [&](u32 begin, u32 end) {
+        FIZZ_PROFILE_SCOPE("RecordSecondary");
+        for (u32 i = begin; i < end; ++i) {
+            VkCommandBuffer cmd = begin_secondary_command_buffer(rendering);
+            record(i, cmd);
+            VK_CHECK(vkEndCommandBuffer(cmd));
+            secondaries[i] = cmd;
+        }
+    });
+
+    vkCmdExecuteCommands(primary, count, secondaries);
+}
 } // namespace fizzengine
\ No newline at end of file
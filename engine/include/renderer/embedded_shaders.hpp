@@ -0,0 +1,23 @@
+#pragma once
+
+#include <foundation/platform.hpp>
+
+#include <span>
+
+namespace fizzengine {
+
+// SPIR-V compiled at build time from shaders/, see cmake/FizzShaders.cmake. Only linked in when
+// the engine is built with FIZZ_EMBED_SHADERS.
+struct EmbeddedShader {
+    cstring    name;        // Source file name, e.g. gradient.comp.slang
+    cstring    entry_point;
+    const u32* spirv;
+    sizet      word_count;
+};
+
+std::span<const EmbeddedShader> get_embedded_shaders();
+
+// Matches on the file name, so runtime shader paths keep working unchanged
+const EmbeddedShader*           find_embedded_shader(cstring path, cstring entry_point);
+
+} // namespace fizzengine
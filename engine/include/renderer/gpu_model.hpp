@@ -0,0 +1,22 @@
+#pragma once
+
+#include <assets/model.hpp>
+#include <foundation/resource_pool.hpp>
+
+namespace fizzengine {
+
+struct GPUDevice;
+
+// Device side of a ModelData. Every primitive shares one vertex and one index buffer and draws
+// with the offsets stored in its Primitive, shaders read vertices through the device address.
+struct GPUModel {
+    ResourceHandle vertex_buffer;
+    ResourceHandle index_buffer;
+};
+
+// Creates the buffers and queues both uploads on the device's upload manager, which copies them
+// together before the first pass of the next frame. model can be dropped once this returns.
+bool upload_model(GPUDevice& gpu, const ModelData& model, GPUModel& out_model);
+void destroy_model(GPUDevice& gpu, GPUModel& model);
+
+} // namespace fizzengine
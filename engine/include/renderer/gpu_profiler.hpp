@@ -0,0 +1,135 @@
+#pragma once
+
+#include <renderer/vk_types.hpp>
+
+#include <span>
+
+namespace fizzengine {
+
+enum GPUPipelineStatistic : u32 {
+    k_statistic_input_vertices = 0,
+    k_statistic_vertex_invocations,
+    k_statistic_fragment_invocations,
+    k_statistic_compute_invocations,
+    k_statistic_count
+};
+
+struct GPUScopeTiming {
+    cstring name       = "";
+    u32     depth      = 0;
+    f64     elapsed_ms = 0.0;
+    f64     average_ms = 0.0; // Rolling average over the last k_history_frames resolved frames
+    f64     min_ms     = 0.0;
+    f64     max_ms     = 0.0;
+    u64     statistics[k_statistic_count] = {}; // Only filled for top level scopes
+};
+
+// Timestamp queries around named, nested regions of a frame. Every frame in flight owns its own
+// query pools. They are read back in begin_frame, after the fence of that frame slot signaled,
+// so the results are those of frame N - frames in flight and reading them never stalls.
+// Scopes are written on the primary command buffer, wrap record_parallel to time secondaries.
+class GPUProfiler {
+  public:
+    static constexpr u32 k_max_frames     = 4;
+    static constexpr u32 k_max_scopes     = 64;
+    static constexpr u32 k_history_frames = 120;
+
+    // Pipeline statistics are only collected when the device has pipelineStatisticsQuery enabled
+    void                           init(VkDevice device, VkPhysicalDevice physical_device,
+                                        u32 queue_family, u32 frame_count,
+                                        bool pipeline_statistics);
+    void                           shutdown();
+
+    // Call with the frame's primary command buffer right after vkBeginCommandBuffer
+    void                           begin_frame(VkCommandBuffer cmd, u32 frame_index);
+
+    void                           push_scope(VkCommandBuffer cmd, cstring name);
+    void                           pop_scope(VkCommandBuffer cmd);
+
+    // Scopes of the most recent resolved frame, in the order they were opened
+    std::span<const GPUScopeTiming> get_timings() const {
+        return {timings, timing_count};
+    }
+    // Frame number the timings belong to, counted in begin_frame calls
+    u64                            get_resolved_frame() const {
+        return resolved_frame;
+    }
+    bool                           is_enabled() const {
+        return enabled;
+    }
+    // For secondaries executed while a statistics query is active, see inheritedQueries
+    VkQueryPipelineStatisticFlags  get_statistic_flags() const {
+        return statistic_flags;
+    }
+
+    bool                           export_csv(cstring path) const;
+    bool                           export_json(cstring path) const;
+
+  private:
+    struct Scope {
+        cstring name;
+        u32     depth;
+        u32     begin_query;
+        u32     statistics_query; // k_invalid_query for nested scopes
+    };
+
+    struct FrameQueries {
+        VkQueryPool timestamp_pool  = VK_NULL_HANDLE;
+        VkQueryPool statistics_pool = VK_NULL_HANDLE;
+        Scope       scopes[k_max_scopes];
+        u32         scope_count      = 0;
+        u32         timestamp_count  = 0;
+        u32         statistics_count = 0;
+        u64         frame            = 0;
+    };
+
+    struct ScopeHistory {
+        cstring name  = "";
+        u32     depth = 0;
+        f32     samples[k_history_frames];
+        u32     sample_count = 0;
+        u32     head         = 0;
+    };
+
+    static constexpr u32          k_invalid_query = 0xffffffff;
+
+    void                          resolve(FrameQueries& queries);
+    ScopeHistory&                 get_history(cstring name, u32 depth);
+
+    VkDevice                      device           = VK_NULL_HANDLE;
+    bool                          enabled          = false;
+    f64                           timestamp_period = 1.0; // Nanoseconds per tick
+    u64                           timestamp_mask   = ~0ull;
+    VkQueryPipelineStatisticFlags statistic_flags  = 0;
+
+    FrameQueries                  frames[k_max_frames];
+    u32                           frame_count  = 0;
+    FrameQueries*                 current      = nullptr;
+    u64                           frame_number = 0;
+
+    u32                           stack[k_max_scopes]; // Open scopes, indices into current->scopes
+    u32                           stack_depth = 0;
+
+    GPUScopeTiming                timings[k_max_scopes];
+    u32                           timing_count   = 0;
+    u64                           resolved_frame = 0;
+
+    ScopeHistory                  histories[k_max_scopes];
+    u32                           history_count = 0;
+};
+
+// Times the commands recorded on cmd while it is alive
+struct GPUProfileScope {
+    GPUProfileScope(GPUProfiler& profiler, VkCommandBuffer cmd, cstring name)
+        : profiler(profiler), cmd(cmd) {
+        profiler.push_scope(cmd, name);
+    }
+    ~GPUProfileScope() {
+        profiler.pop_scope(cmd);
+    }
+
+    GPUProfiler&    profiler;
+    VkCommandBuffer cmd;
+};
+
+} // namespace fizzengine
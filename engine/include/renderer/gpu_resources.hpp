@@ -1,4 +1,5 @@
 #pragma once
+#include <renderer/bindless.hpp>
 #include <renderer/vk_types.hpp>
 
 namespace fizzengine {
@@ -11,6 +12,11 @@ struct Texture {
     VkImageLayout m_image_layout;
     VmaAllocation m_vma_allocation;
 
+    // Slots in the bindless heap, k_invalid_bindless_index when the usage was not registered
+    u32           m_sampled_index = k_invalid_bindless_index;
+    u32           m_storage_index = k_invalid_bindless_index;
+    u32           m_sampler_index = k_invalid_bindless_index;
+
     u16           width   = 1;
     u16           height  = 1;
     u16           depth   = 1;
@@ -18,16 +24,32 @@ struct Texture {
     u8            flags   = 0;
 };
 
+struct Buffer {
+    VkBuffer           m_buffer         = VK_NULL_HANDLE;
+    VmaAllocation      m_vma_allocation = VK_NULL_HANDLE;
+    VkDeviceAddress    m_device_address = 0;
+    VkDeviceSize       m_size           = 0;
+    VkBufferUsageFlags m_usage          = 0;
+    // Only set for host visible buffers, which stay mapped for their whole lifetime
+    void*              m_mapped_data    = nullptr;
+
+    // Slot in the bindless address table, k_invalid_bindless_index when not registered
+    u32                m_bindless_index = k_invalid_bindless_index;
+};
+
 struct DescriptorLayoutBuilder {
 
     std::vector<VkDescriptorSetLayoutBinding> bindings;
 
-    void                                      add_binding(uint32_t binding, VkDescriptorType type);
-    void                                      clear();
+    void                  add_binding(uint32_t binding, VkDescriptorType type, uint32_t count = 1);
+    void                  clear();
     VkDescriptorSetLayout build(VkDevice device, VkShaderStageFlags shader_stages,
                                 void* pNext = nullptr, VkDescriptorSetLayoutCreateFlags flags = 0);
 };
 
+// Hands out descriptor sets from a list of pools. When a pool runs dry it is parked as full and a
+// new one, larger by k_growth_factor, takes its place, so allocation never fails on exhaustion.
+// Sets are never freed one by one, clear_pools resets every pool at once. Not thread safe.
 struct DescriptorAllocator {
 
     struct PoolSizeRatio {
@@ -35,13 +57,44 @@ struct DescriptorAllocator {
         float            ratio;
     };
 
-    VkDescriptorPool pool;
+    static constexpr u32 k_growth_factor     = 2;
+    static constexpr u32 k_max_sets_per_pool = 4096;
+
+    // No pool is created until the first allocation
+    void                 init(VkDevice device, u32 initial_sets,
+                              std::span<PoolSizeRatio> pool_ratios);
+    void                 clear_pools();
+    void                 destroy_pools();
+
+    VkDescriptorSet      allocate(VkDescriptorSetLayout layout, void* pNext = nullptr);
+
+  private:
+    VkDescriptorPool              get_pool();
+    VkDescriptorPool              create_pool(u32 set_count);
+
+    VkDevice                      device        = VK_NULL_HANDLE;
+    u32                           sets_per_pool = 0;
+    std::vector<PoolSizeRatio>    ratios;
+    std::vector<VkDescriptorPool> full_pools;
+    std::vector<VkDescriptorPool> ready_pools;
+};
+
+// Collects descriptor writes, possibly to several sets, and submits them in one
+// vkUpdateDescriptorSets call. Infos live in deques so the pointers in writes stay valid.
+struct DescriptorWriter {
+
+    std::deque<VkDescriptorImageInfo>  image_infos;
+    std::deque<VkDescriptorBufferInfo> buffer_infos;
+    std::vector<VkWriteDescriptorSet>  writes;
 
-    void init_pool(VkDevice device, uint32_t max_sets, std::span<PoolSizeRatio> pool_ratios);
-    void clear_descriptors(VkDevice device);
-    void destroy_pool(VkDevice device);
+    void write_image(VkDescriptorSet set, u32 binding, VkImageView image, VkSampler sampler,
+                     VkImageLayout layout, VkDescriptorType type, u32 array_element = 0);
+    void write_buffer(VkDescriptorSet set, u32 binding, VkBuffer buffer, VkDeviceSize size,
+                      VkDeviceSize offset, VkDescriptorType type, u32 array_element = 0);
 
-    VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout);
+    void clear();
+    // Issues every pending write and clears the writer
+    void flush(VkDevice device);
 };
 
 } // namespace fizzengine
\ No newline at end of file
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <renderer/barrier_builder.hpp>
+#include <renderer/vk_types.hpp>
+
+#include <unordered_map>
+
+namespace fizzengine {
+
+class GPUProfiler;
+
+// How a pass touches an image. Each usage maps to the exact pipeline stage, access and layout the
+// graph puts in its barriers, see get_usage_info.
+enum RenderGraphUsage : u32 {
+    k_usage_undefined = 0,
+    k_usage_compute_sampled,
+    k_usage_compute_storage_read,
+    k_usage_compute_storage_write, // Write only, previous contents are discarded
+    k_usage_compute_storage_read_write,
+    k_usage_fragment_sampled,
+    k_usage_color_attachment,
+    k_usage_depth_attachment,
+    k_usage_transfer_src,
+    k_usage_transfer_dst,
+    k_usage_present,
+    k_usage_count
+};
+
+struct RenderGraphUsageInfo {
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2        access;
+    VkImageLayout         layout;
+    bool                  write;
+    bool                  discard; // Contents do not matter when this is the first use
+};
+
+const RenderGraphUsageInfo& get_usage_info(RenderGraphUsage usage);
+
+struct RenderGraphImageDesc {
+    VkFormat           format = VK_FORMAT_UNDEFINED;
+    u32                width  = 1;
+    u32                height = 1;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+    bool               operator==(const RenderGraphImageDesc& other) const = default;
+};
+
+using RenderGraphResource = u32;
+static constexpr RenderGraphResource k_invalid_graph_resource = 0xffffffff;
+
+// Frame graph rebuilt every frame. Passes declare the images they read and write, compile culls
+// passes nothing visible depends on, derives one batched barrier per pass boundary with precise
+// stages, accesses and layouts, and places transient images with disjoint lifetimes in the same
+// memory. Imported images keep their last usage across frames, so nobody tracks layouts by hand.
+// Usage per frame: begin, import/create images, add passes, compile, execute.
+class RenderGraph {
+  public:
+    using ExecuteFunction = std::function<void(VkCommandBuffer cmd)>;
+
+    static constexpr u32 k_max_frames = 4;
+
+    void                init(VkDevice device, VmaAllocator vma_allocator, u32 frame_count);
+    void                shutdown();
+
+    // Call after the fence of frame_index signaled, transient memory is per frame in flight
+    void                begin(u32 frame_index);
+
+    // External image, its state at the end of the last graph that used it is carried over.
+    // initial_usage overrides that, k_usage_undefined for images whose contents are dropped.
+    RenderGraphResource import_image(cstring name, VkImage image, VkImageView view,
+                                     VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT,
+                                     RenderGraphUsage   initial_usage = k_usage_count);
+    // Image owned by the graph, alive for this frame only. Usage flags follow from the passes.
+    RenderGraphResource create_image(cstring name, const RenderGraphImageDesc& desc);
+    // State an imported image is left in after the last pass, e.g. k_usage_present
+    void                set_final_usage(RenderGraphResource resource, RenderGraphUsage usage);
+
+    // Passes run in the order they were added. side_effect passes are never culled.
+    u32                 add_pass(cstring name, ExecuteFunction&& execute, bool side_effect = false);
+    void                read(u32 pass, RenderGraphResource resource, RenderGraphUsage usage);
+    void                write(u32 pass, RenderGraphResource resource, RenderGraphUsage usage);
+
+    void                compile();
+    // Each pass gets a timing scope when profiler is set
+    void                execute(VkCommandBuffer cmd, GPUProfiler* profiler = nullptr);
+
+    // Valid from compile on
+    VkImage             get_image(RenderGraphResource resource) const;
+    VkImageView         get_image_view(RenderGraphResource resource) const;
+
+    // Drops the carried over state of an image that is about to be destroyed
+    void                forget_image(VkImage image);
+
+    u32                 get_culled_pass_count() const {
+        return culled_pass_count;
+    }
+    u32                 get_barrier_count() const {
+        return barrier_count;
+    }
+
+  private:
+    struct Access {
+        RenderGraphResource resource;
+        RenderGraphUsage    usage;
+        bool                write;
+    };
+
+    struct Pass {
+        cstring                            name;
+        ExecuteFunction                    execute;
+        std::vector<Access>                accesses;
+        bool                               side_effect;
+        bool                               culled;
+        BarrierBuilder                     barriers; // Recorded before the pass
+    };
+
+    struct State {
+        VkPipelineStageFlags2 stage  = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2        access = VK_ACCESS_2_NONE;
+        VkImageLayout         layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        bool                  write  = false;
+    };
+
+    struct Resource {
+        cstring              name;
+        VkImage              image = VK_NULL_HANDLE;
+        VkImageView          view  = VK_NULL_HANDLE;
+        VkImageAspectFlags   aspect;
+        bool                 imported;
+        RenderGraphUsage     final_usage = k_usage_count;
+        State                state;
+
+        // Transient only
+        RenderGraphImageDesc desc;
+        VkImageUsageFlags    usage_flags = 0;
+        u32                  first_pass  = 0xffffffff;
+        u32                  last_pass   = 0;
+        VkDeviceSize         offset      = 0;
+        // Every stage the transient is used in and every write access, for aliasing barriers
+        State                used;
+        // Stages and writes of the transients that used the same memory earlier in the frame
+        State                alias_predecessor;
+    };
+
+    // Transient images and the memory they alias, kept per frame in flight and rebuilt only
+    // when the set of transients or their lifetimes change
+    struct TransientHeap {
+        struct Key {
+            RenderGraphImageDesc desc;
+            VkImageUsageFlags    usage_flags;
+            u32                  first_pass;
+            u32                  last_pass;
+
+            bool                 operator==(const Key& other) const = default;
+        };
+
+        std::vector<Key>          keys;
+        std::vector<VkImage>      images;
+        std::vector<VkImageView>  views;
+        // Placement of each image in allocation
+        std::vector<VkDeviceSize> offsets;
+        std::vector<VkDeviceSize> sizes;
+        VmaAllocation             allocation = VK_NULL_HANDLE;
+    };
+
+    void                               cull_passes();
+    void                               allocate_transients();
+    void                               destroy_transients(TransientHeap& heap);
+    void add_barrier(BarrierBuilder& barriers, Resource& resource, const State& next,
+                     bool discard);
+
+    VkDevice                           device        = VK_NULL_HANDLE;
+    VmaAllocator                       vma_allocator = VK_NULL_HANDLE;
+    u32                                frame_count   = 0;
+    u32                                frame_index   = 0;
+
+    std::vector<Pass>                  passes;
+    std::vector<Resource>              resources;
+    BarrierBuilder                     final_barriers;
+    u32                                culled_pass_count = 0;
+    u32                                barrier_count     = 0;
+
+    TransientHeap                      heaps[k_max_frames];
+    std::unordered_map<VkImage, State> imported_states;
+};
+
+} // namespace fizzengine
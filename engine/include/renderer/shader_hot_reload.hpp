@@ -0,0 +1,67 @@
+#pragma once
+
+#include <renderer/vk_types.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fizzengine {
+
+// Watches the sources of registered pipelines (inotify on Linux, timestamp polling elsewhere).
+// When a file changes, every pipeline that includes it is recompiled and rebuilt on the watcher
+// thread. The render loop picks up finished pipelines at a frame boundary, so it never waits on
+// a compile.
+class ShaderHotReload {
+  public:
+    void init(VkDevice device, VkPipelineCache pipeline_cache);
+    void shutdown();
+
+    // pipeline points at the handle the renderer binds, it is overwritten on swap
+    void watch_compute_pipeline(const char* path, const char* entry_point, VkPipelineLayout layout,
+                                VkPipeline* pipeline);
+
+    // Call between frames. Swaps in rebuilt pipelines and appends the replaced handles to
+    // out_retired, they have to outlive the frames still in flight.
+    void apply_reloaded(std::vector<VkPipeline>& out_retired);
+
+  private:
+    struct WatchedPipeline {
+        std::string              path;
+        std::string              entry_point;
+        VkShaderStageFlagBits    stage;
+        VkPipelineLayout         layout;
+        VkPipeline*              pipeline;
+        std::vector<std::string> dependencies;
+    };
+
+    struct ReloadedPipeline {
+        VkPipeline* target;
+        VkPipeline  pipeline;
+    };
+
+    void                                   watch_loop();
+    void                                   watch_file(const std::string& path);
+    void                                   reload(const std::vector<std::string>& changed_paths);
+    VkPipeline                             build_compute_pipeline(WatchedPipeline& watched);
+
+    VkDevice                               device         = VK_NULL_HANDLE;
+    VkPipelineCache                        pipeline_cache = VK_NULL_HANDLE;
+
+    std::mutex                             mutex;
+    std::vector<WatchedPipeline>           pipelines;
+    std::vector<ReloadedPipeline>          reloaded;
+
+    // Directory watches for inotify, file timestamps for the polling fallback
+    std::unordered_map<int, std::string>   watch_directories;
+    std::unordered_map<std::string, i64>   file_timestamps;
+    int                                    inotify_fd = -1;
+
+    std::thread                            thread;
+    std::atomic<bool>                      running{false};
+};
+
+} // namespace fizzengine
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <renderer/barrier_builder.hpp>
+#include <renderer/vk_types.hpp>
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace fizzengine {
+
+// Streams CPU data into device local buffers and images through one persistently mapped staging
+// ring. Uploads only copy into the ring and queue a region, flush records the queued regions in
+// submission order with one vkCmdCopyBuffer2 per source and destination buffer, split by a
+// barrier wherever an upload overwrites bytes an earlier one of the same flush wrote, and one
+// vkCmdCopyBufferToImage2 per image.
+// flush marks how far the ring was written for the frame that records it. Once that frame's
+// fence signals, begin_frame gives the space back, so the ring never waits on the GPU.
+// Uploads larger than the ring, or that do not fit in it right now, get a dedicated staging
+// buffer. That buffer is destroyed once the frame that copied from it has retired.
+class UploadManager {
+  public:
+    static constexpr u32          k_max_frames        = 4;
+    static constexpr VkDeviceSize k_default_size      = 64 * 1024 * 1024;
+    static constexpr VkDeviceSize k_staging_alignment = 16;
+
+    void init(VkDevice device, VmaAllocator vma_allocator, u32 frame_count,
+              VkDeviceSize ring_size = k_default_size);
+    void shutdown();
+
+    // Call after the fence of frame_index signaled
+    void begin_frame(u32 frame_index);
+
+    // data is copied right away and may be freed on return. Safe to call from any thread.
+    void upload_buffer(VkBuffer destination, VkDeviceSize destination_offset, const void* data,
+                       VkDeviceSize size);
+    // Replaces mip 0 of a color image, the previous contents are discarded. The image ends up in
+    // final_layout, visible to every later command.
+    void upload_image(VkImage destination, VkExtent3D extent, const void* data, VkDeviceSize size,
+                      VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // Records every queued copy on cmd, cmd has to be submitted as part of frame_index
+    void flush(VkCommandBuffer cmd, u32 frame_index);
+
+    bool has_pending() const {
+        return !buffer_copies.empty() || !image_copies.empty();
+    }
+
+  private:
+    struct BufferCopy {
+        VkBuffer     source;
+        VkBuffer     destination;
+        VkDeviceSize source_offset;
+        VkDeviceSize destination_offset;
+        VkDeviceSize size;
+    };
+
+    struct ImageCopy {
+        VkBuffer      source;
+        VkImage       destination;
+        VkDeviceSize  source_offset;
+        VkExtent3D    extent;
+        VkImageLayout final_layout;
+    };
+
+    struct StagingBuffer {
+        VkBuffer      buffer;
+        VmaAllocation allocation;
+    };
+
+    // Copies data into the ring or a dedicated staging buffer, returns the buffer and offset
+    void                       stage(const void* data, VkDeviceSize size, VkBuffer& out_buffer,
+                                     VkDeviceSize& out_offset);
+    bool                       allocate_ring(VkDeviceSize size, VkDeviceSize& out_offset);
+    // Adds the copy's destination range to written_ranges, false when it overlaps one already there
+    bool                       claim_range(const BufferCopy& copy);
+    // Records buffer_copies[begin, end), which must not overlap each other
+    void                       record_buffer_copies(VkCommandBuffer cmd, sizet begin, sizet end);
+
+    VkDevice                   device        = VK_NULL_HANDLE;
+    VmaAllocator               vma_allocator = VK_NULL_HANDLE;
+
+    VkBuffer                   ring_buffer   = VK_NULL_HANDLE;
+    VmaAllocation              ring_allocation;
+    u8*                        ring_data     = nullptr;
+    VkDeviceSize               ring_size     = 0;
+    // Monotonic offsets, the physical offset is taken modulo ring_size
+    u64                        ring_head     = 0;
+    u64                        ring_tail     = 0;
+    u64                        frame_heads[k_max_frames] = {};
+    u32                        frame_count   = 0;
+
+    std::vector<BufferCopy>    buffer_copies;
+    std::vector<ImageCopy>     image_copies;
+    // Destination ranges written by the current run of copies, end offset keyed by buffer and start
+    std::map<std::pair<VkBuffer, VkDeviceSize>, VkDeviceSize> written_ranges;
+    std::vector<VkBufferCopy2> copy_regions;
+    BarrierBuilder             barriers;
+    std::vector<StagingBuffer> pending_staging;
+    std::vector<StagingBuffer> retired_staging[k_max_frames];
+
+    // Loaders upload from their own threads
+    std::mutex                 mutex;
+};
+
+} // namespace fizzengine
@@ -6,7 +6,9 @@ namespace vkinit {
 
 VkCommandPoolCreateInfo     command_pool_create_info(uint32_t                 queueFamilyIndex,
                                                      VkCommandPoolCreateFlags flags = 0);
-VkCommandBufferAllocateInfo command_buffer_allocate_info(VkCommandPool pool, uint32_t count = 1);
+VkCommandBufferAllocateInfo
+command_buffer_allocate_info(VkCommandPool pool, uint32_t count = 1,
+                             VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
 VkCommandBufferBeginInfo    command_buffer_begin_info(VkCommandBufferUsageFlags flags = 0);
 VkCommandBufferSubmitInfo   command_buffer_submit_info(VkCommandBuffer cmd);
@@ -1,17 +1,52 @@
 #pragma once
 #include <renderer/vk_types.hpp>
+#if !defined(FIZZ_EMBED_SHADERS)
 #include <slang/slang.h>
+#endif
 
-namespace vkutil {
-void transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout current_layout,
-                      VkImageLayout new_layout);
+namespace fizzengine {
+class JobSystem;
+}
 
+namespace vkutil {
 void copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage destination,
                          VkExtent2D srcSize, VkExtent2D dstSize);
 
+// Shader compilation keeps one Slang global session for the whole run, created on the first
+// cache miss. Compiled SPIR-V is cached in cache_directory, keyed by the source and everything it
+// includes, the entry point, stage, target profile and compiler version.
+// With FIZZ_EMBED_SHADERS shaders are compiled at build time instead, and the functions below
+// hand out the embedded SPIR-V without Slang being linked at all.
+void                    init_shader_compiler(const char* cache_directory = "shader_cache");
+void                    shutdown_shader_compiler();
+
+#if !defined(FIZZ_EMBED_SHADERS)
 slang::IGlobalSession*  CreateSlangSession();
 
 slang::ICompileRequest* CreateCompileRequest(slang::IGlobalSession* session);
+#endif
+
+// Source file followed by every file it pulls in through #include or import, transitively
+void collect_shader_dependencies(const char* shaderPath, std::vector<std::string>& out_paths);
+
+bool compile_slang_to_spirv(const char* shaderPath, const char* entryPoint,
+                            VkShaderStageFlagBits stage, std::vector<uint32_t>& out_spirv);
+
+struct ShaderCompileRequest {
+    const char*           path;
+    const char*           entry_point;
+    VkShaderStageFlagBits stage;
+
+    std::vector<uint32_t> spirv;
+    bool                  success = false;
+};
+
+// Compiles a batch on the job system workers. Cache lookups run in parallel, cache misses share
+// the global session and are compiled one at a time since Slang sessions are not thread safe.
+void           compile_slang_shaders(std::span<ShaderCompileRequest> requests,
+                                     fizzengine::JobSystem*          job_system);
+
+VkShaderModule create_shader_module(VkDevice device, std::span<const uint32_t> spirv);
 
 VkShaderModule CompileSlangShader(VkDevice device, const char* shaderPath, const char* entryPoint,
                                   VkShaderStageFlagBits stage);
@@ -16,7 +16,7 @@ bool Window::init() {
     }
     p_window_handle =
         SDL_CreateWindow(m_title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, m_width,
-                         m_height, SDL_WINDOW_VULKAN);
+                         m_height, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
 
     if (!p_window_handle) {
         spdlog::error("Failed to create SDL Window");
@@ -32,15 +32,38 @@ void Window::shutdown() {
 }
 void Window::handle_events(bool& quit) {
     SDL_Event event;
+    while (m_minimized && !quit && SDL_WaitEvent(&event) != 0) {
+        process_event(event, quit);
+    }
     while (SDL_PollEvent(&event) != 0) {
-        ImGui_ImplSDL2_ProcessEvent(&event);
-        if (event.type == SDL_QUIT) {
-            quit = true;
-        }
-        if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE &&
-            event.window.windowID == SDL_GetWindowID(p_window_handle)) {
-            quit = true;
-        }
+        process_event(event, quit);
+    }
+}
+void Window::process_event(const SDL_Event& event, bool& quit) {
+    ImGui_ImplSDL2_ProcessEvent(&event);
+    if (event.type == SDL_QUIT) {
+        quit = true;
+    }
+    if (event.type != SDL_WINDOWEVENT ||
+        event.window.windowID != SDL_GetWindowID(p_window_handle)) {
+        return;
+    }
+    switch (event.window.event) {
+    case SDL_WINDOWEVENT_CLOSE:
+        quit = true;
+        break;
+    case SDL_WINDOWEVENT_SIZE_CHANGED:
+        m_width   = event.window.data1;
+        m_height  = event.window.data2;
+        m_resized = true;
+        break;
+    case SDL_WINDOWEVENT_MINIMIZED:
+        m_minimized = true;
+        break;
+    case SDL_WINDOWEVENT_RESTORED:
+    case SDL_WINDOWEVENT_MAXIMIZED:
+        m_minimized = false;
+        break;
     }
 }
 } // namespace fizzengine
\ No newline at end of file
@@ -0,0 +1,318 @@
+#include <assets/cooked_model.hpp>
+
+#include <foundation/profiler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace fizzengine {
+
+static const u32   k_cooked_model_magic     = 0x4d445a46; // "FZDM"
+// Bump whenever the header, a section or any struct from model.hpp changes layout
+static const u32   k_cooked_model_version   = 1;
+static const sizet k_cooked_model_alignment = 16;
+
+static_assert(sizeof(Vertex) == 32 && sizeof(Primitive) == 44 && sizeof(Mesh) == 8 &&
+                  sizeof(Material) == 64 && sizeof(Node) == 136,
+              "Cooked model layout changed, bump k_cooked_model_version");
+
+enum CookedSectionType : u32 {
+    k_section_vertices = 0,
+    k_section_indices,
+    k_section_primitives,
+    k_section_meshes,
+    k_section_materials,
+    k_section_nodes,
+    k_section_images,
+    // Encoded image bytes and the image table's strings
+    k_section_image_data,
+    // Null terminated paths, only read by the cooker
+    k_section_dependencies,
+    k_section_count
+};
+
+struct CookedSection {
+    u64 offset;
+    u64 size;
+};
+
+struct CookedModelHeader {
+    u32           magic;
+    u32           version;
+    u64           file_size;
+    u64           source_hash;
+    u32           dependency_count;
+    u32           padding;
+    CookedSection sections[k_section_count];
+};
+
+// ImageSource with file offsets, u64_max for strings that are not set
+struct CookedImage {
+    u64 uri;
+    u64 mime_type;
+    u64 data;
+    u64 size;
+};
+
+// Writing /////////////////////////////////////////////////////////////////
+
+static u64 append(std::vector<u8>& file, const void* data, u64 size,
+                  sizet alignment = k_cooked_model_alignment) {
+    file.resize(memory_align(file.size(), alignment));
+    const u64 offset = file.size();
+    if (size != 0) {
+        file.insert(file.end(), (const u8*)data, (const u8*)data + size);
+    }
+    return offset;
+}
+
+template <typename T>
+static CookedSection append_section(std::vector<u8>& file, const T* array, u32 count) {
+    const u64 size = (u64)count * sizeof(T);
+    return {append(file, array, size), size};
+}
+
+static u64 append_string(std::vector<u8>& file, cstring string) {
+    return string ? append(file, string, strlen(string) + 1, 1) : u64_max;
+}
+
+bool write_cooked_model(cstring path, const ModelData& model, u64 source_hash,
+                        const std::vector<std::string>& dependencies) {
+    FIZZ_PROFILE_FUNCTION();
+    std::vector<u8>   file(sizeof(CookedModelHeader));
+
+    CookedModelHeader header{};
+    header.magic            = k_cooked_model_magic;
+    header.version          = k_cooked_model_version;
+    header.source_hash      = source_hash;
+    header.dependency_count = (u32)dependencies.size();
+
+    CookedSection* sections = header.sections;
+    sections[k_section_vertices]   = append_section(file, model.vertices, model.vertex_count);
+    sections[k_section_indices]    = append_section(file, model.indices, model.index_count);
+    sections[k_section_primitives] = append_section(file, model.primitives, model.primitive_count);
+    sections[k_section_meshes]     = append_section(file, model.meshes, model.mesh_count);
+    sections[k_section_materials]  = append_section(file, model.materials, model.material_count);
+    sections[k_section_nodes]      = append_section(file, model.nodes, model.node_count);
+
+    // Image bytes first, the table that points at them follows
+    std::vector<CookedImage> images(model.image_count);
+    const u64 image_data_begin = memory_align(file.size(), k_cooked_model_alignment);
+    for (u32 i = 0; i < model.image_count; ++i) {
+        const ImageSource& source = model.images[i];
+        images[i].size            = source.data ? source.size : 0;
+        images[i].data            = append(file, source.data, images[i].size);
+        images[i].uri             = append_string(file, source.uri);
+        images[i].mime_type       = append_string(file, source.mime_type);
+    }
+    sections[k_section_image_data] = {image_data_begin,
+                                      std::max<u64>(file.size(), image_data_begin) -
+                                          image_data_begin};
+    sections[k_section_images]     = append_section(file, images.data(), model.image_count);
+
+    const u64 dependencies_begin = memory_align(file.size(), k_cooked_model_alignment);
+    for (const std::string& dependency : dependencies) {
+        append(file, dependency.c_str(), dependency.size() + 1, 1);
+    }
+    sections[k_section_dependencies] = {dependencies_begin,
+                                        std::max<u64>(file.size(), dependencies_begin) -
+                                            dependencies_begin};
+
+    file.resize(memory_align(file.size(), k_cooked_model_alignment));
+    header.file_size = file.size();
+    memcpy(file.data(), &header, sizeof(header));
+
+    return write_file_atomic(path, file.data(), file.size());
+}
+
+// Loading /////////////////////////////////////////////////////////////////
+
+static bool read_header(const MappedFile& file, CookedModelHeader& out_header) {
+    if (file.get_size() < sizeof(CookedModelHeader)) {
+        return false;
+    }
+    memcpy(&out_header, file.get_data(), sizeof(out_header));
+    if (out_header.magic != k_cooked_model_magic ||
+        out_header.version != k_cooked_model_version || out_header.file_size != file.get_size()) {
+        return false;
+    }
+
+    for (const CookedSection& section : out_header.sections) {
+        if (section.offset % k_cooked_model_alignment != 0 ||
+            section.offset < sizeof(CookedModelHeader) || section.offset > out_header.file_size ||
+            section.size > out_header.file_size - section.offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+static bool get_section(const MappedFile& file, const CookedSection& section, T*& out_array,
+                        u32& out_count) {
+    if (section.size % sizeof(T) != 0 || section.size / sizeof(T) > u32_max) {
+        return false;
+    }
+    out_array = section.size != 0 ? (T*)(file.get_data() + section.offset) : nullptr;
+    out_count = (u32)(section.size / sizeof(T));
+    return true;
+}
+
+// nullptr when offset is u64_max, false when the string is not terminated inside the section
+static bool get_string(const MappedFile& file, const CookedSection& section, u64 offset,
+                       cstring& out_string) {
+    out_string = nullptr;
+    if (offset == u64_max) {
+        return true;
+    }
+    if (offset < section.offset || offset >= section.offset + section.size) {
+        return false;
+    }
+    const u8* begin = file.get_data() + offset;
+    if (!memchr(begin, '\0', section.offset + section.size - offset)) {
+        return false;
+    }
+    out_string = (cstring)begin;
+    return true;
+}
+
+// Ranges and cross references, cheap next to touching every index
+static bool validate_model(const ModelData& model) {
+    for (u32 i = 0; i < model.primitive_count; ++i) {
+        const Primitive& primitive = model.primitives[i];
+        if ((u64)primitive.first_index + primitive.index_count > model.index_count ||
+            (u64)primitive.vertex_offset + primitive.vertex_count > model.vertex_count ||
+            primitive.material >= model.material_count) {
+            return false;
+        }
+    }
+    for (u32 i = 0; i < model.mesh_count; ++i) {
+        const Mesh& mesh = model.meshes[i];
+        if ((u64)mesh.first_primitive + mesh.primitive_count > model.primitive_count) {
+            return false;
+        }
+    }
+    for (u32 i = 0; i < model.node_count; ++i) {
+        const Node& node = model.nodes[i];
+        if ((node.parent != u32_max && node.parent >= model.node_count) ||
+            (node.mesh != u32_max && node.mesh >= model.mesh_count)) {
+            return false;
+        }
+    }
+    for (u32 i = 0; i < model.material_count; ++i) {
+        const Material& material = model.materials[i];
+        for (u32 image : {material.base_color_image, material.metallic_roughness_image,
+                          material.normal_image, material.occlusion_image,
+                          material.emissive_image}) {
+            if (image != k_invalid_image && image >= model.image_count) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool load_images(const MappedFile& file, const CookedModelHeader& header, Arena& arena,
+                        ModelData& model) {
+    const CookedImage* images = nullptr;
+    if (!get_section(file, header.sections[k_section_images], images, model.image_count)) {
+        return false;
+    }
+    if (model.image_count == 0) {
+        return true;
+    }
+
+    model.images = (ImageSource*)arena.allocate(model.image_count * sizeof(ImageSource),
+                                                alignof(ImageSource));
+    if (!model.images) {
+        return false;
+    }
+
+    const CookedSection& data = header.sections[k_section_image_data];
+    for (u32 i = 0; i < model.image_count; ++i) {
+        const CookedImage& cooked = images[i];
+        ImageSource&       image  = model.images[i];
+        image                     = ImageSource{};
+        if (cooked.data < data.offset || cooked.data > data.offset + data.size ||
+            cooked.size > data.offset + data.size - cooked.data ||
+            !get_string(file, data, cooked.uri, image.uri) ||
+            !get_string(file, data, cooked.mime_type, image.mime_type)) {
+            return false;
+        }
+        image.data = cooked.size != 0 ? file.get_data() + cooked.data : nullptr;
+        image.size = cooked.size;
+    }
+    return true;
+}
+
+bool load_cooked_model(cstring path, MappedFile& file, Arena& arena, ModelData& out_model) {
+    FIZZ_PROFILE_FUNCTION();
+    const auto start = std::chrono::steady_clock::now();
+    out_model        = ModelData{};
+
+    if (!file.open(path)) {
+        spdlog::error("Cooked model: failed to open {}", path);
+        return false;
+    }
+
+    CookedModelHeader header;
+    if (!read_header(file, header)) {
+        spdlog::error("Cooked model: {} is corrupt or of another version, cook it again", path);
+        file.close();
+        return false;
+    }
+
+    const CookedSection* sections = header.sections;
+    const bool           loaded =
+        get_section(file, sections[k_section_vertices], out_model.vertices,
+                    out_model.vertex_count) &&
+        get_section(file, sections[k_section_indices], out_model.indices, out_model.index_count) &&
+        get_section(file, sections[k_section_primitives], out_model.primitives,
+                    out_model.primitive_count) &&
+        get_section(file, sections[k_section_meshes], out_model.meshes, out_model.mesh_count) &&
+        get_section(file, sections[k_section_materials], out_model.materials,
+                    out_model.material_count) &&
+        get_section(file, sections[k_section_nodes], out_model.nodes, out_model.node_count) &&
+        load_images(file, header, arena, out_model) && validate_model(out_model);
+    if (!loaded) {
+        spdlog::error("Cooked model: {} has invalid sections", path);
+        out_model = ModelData{};
+        file.close();
+        return false;
+    }
+
+    const f64 elapsed_ms =
+        std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("Mapped {} in {:.2f} ms: {} vertices, {} indices, {} primitives", path,
+                 elapsed_ms, out_model.vertex_count, out_model.index_count,
+                 out_model.primitive_count);
+    return true;
+}
+
+bool read_cooked_model_source(cstring path, u64& out_source_hash,
+                              std::vector<std::string>& out_dependencies) {
+    out_dependencies.clear();
+
+    MappedFile        file;
+    CookedModelHeader header;
+    if (!file.open(path) || !read_header(file, header)) {
+        return false;
+    }
+
+    const CookedSection& section = header.sections[k_section_dependencies];
+    u64                  offset  = section.offset;
+    for (u32 i = 0; i < header.dependency_count; ++i) {
+        cstring dependency = nullptr;
+        if (!get_string(file, section, offset, dependency)) {
+            out_dependencies.clear();
+            return false;
+        }
+        out_dependencies.emplace_back(dependency);
+        offset += strlen(dependency) + 1;
+    }
+    out_source_hash = header.source_hash;
+    return true;
+}
+
+} // namespace fizzengine
@@ -0,0 +1,942 @@
+#include <assets/gltf_loader.hpp>
+
+#include <foundation/file.hpp>
+#include <foundation/json.hpp>
+#include <foundation/profiler.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fizzengine {
+
+static const u32 k_glb_magic      = 0x46546c67; // "glTF"
+static const u32 k_glb_chunk_json = 0x4e4f534a; // "JSON"
+static const u32 k_glb_chunk_bin  = 0x004e4942; // "BIN\0"
+static const u32 k_glb_header     = 12;
+static const u32 k_glb_chunk      = 8;
+
+// Vertices or indices one decode job converts, small enough to balance a few huge primitives
+// across every worker and large enough to keep the per job overhead out of the profile
+static const u32 k_decode_batch = 64 * 1024;
+
+enum GltfComponentType : u32 {
+    k_gltf_byte           = 5120,
+    k_gltf_unsigned_byte  = 5121,
+    k_gltf_short          = 5122,
+    k_gltf_unsigned_short = 5123,
+    k_gltf_unsigned_int   = 5125,
+    k_gltf_float          = 5126
+};
+
+static const u32 k_gltf_mode_triangles = 4;
+
+struct BufferData {
+    const u8* data = nullptr;
+    u64       size = 0;
+};
+
+// Resolved accessor, data points at the first element
+struct AccessorView {
+    const u8* data           = nullptr;
+    u32       count          = 0;
+    u32       stride         = 0;
+    u32       component_type = 0;
+    u32       components     = 0;
+    bool      normalized     = false;
+};
+
+struct PrimitiveSource {
+    AccessorView position;
+    AccessorView normal;
+    AccessorView uv;
+    AccessorView indices;
+};
+
+struct DecodeJob {
+    u32  primitive;
+    u32  begin;
+    u32  end;
+    bool indices;
+};
+
+struct GltfContext {
+    const JsonValue*            root = nullptr;
+    std::filesystem::path       directory;
+    BufferData                  glb_binary;
+
+    std::vector<BufferData>     buffers;
+    // Backing storage of buffers that are not part of the main file
+    std::deque<MappedFile>      external_files;
+    std::deque<std::vector<u8>> decoded_uris;
+    std::vector<std::string>*   dependencies = nullptr;
+};
+
+template <typename T>
+static T* allocate_array(Arena& arena, u64 count) {
+    if (count == 0) {
+        return nullptr;
+    }
+    T* array = (T*)arena.allocate(count * sizeof(T), alignof(T));
+    if (!array) {
+        spdlog::error("glTF: out of arena memory for {} bytes", count * sizeof(T));
+    }
+    return array;
+}
+
+static cstring copy_string(Arena& arena, std::string_view string) {
+    if (string.empty()) {
+        return nullptr;
+    }
+    char* copy = allocate_array<char>(arena, string.size() + 1);
+    if (copy) {
+        memcpy(copy, string.data(), string.size());
+        copy[string.size()] = '\0';
+    }
+    return copy;
+}
+
+static bool copy_image_data(Arena& arena, const u8* data, u64 size, ImageSource& out_image) {
+    u8* copy = allocate_array<u8>(arena, size);
+    if (size != 0 && !copy) {
+        return false;
+    }
+    if (copy) {
+        memcpy(copy, data, size);
+    }
+    out_image.data = copy;
+    out_image.size = size;
+    return true;
+}
+
+// Largest byte offset or length accepted, every whole number up to it is exact in a double
+static const f64 k_max_byte_size = 9007199254740992.0; // 2^53
+
+// Optional byteOffset or byteLength, 0 when missing. False when it is not a whole number of bytes,
+// which is rejected before the cast to u64.
+static bool get_byte_size(const JsonValue& object, std::string_view key, u64& out_size) {
+    const JsonValue* value = object.find(key);
+    out_size               = 0;
+    if (!value) {
+        return true;
+    }
+    if (!value->is_integer(k_max_byte_size)) {
+        return false;
+    }
+    out_size = (u64)value->number;
+    return true;
+}
+
+static u32 read_u32(const u8* data) {
+    u32 value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// Files ///////////////////////////////////////////////////////////////////
+
+static bool read_glb(const MappedFile& file, std::string_view& out_json, BufferData& out_binary) {
+    const u8*   data = file.get_data();
+    const sizet size = file.get_size();
+    if (size < k_glb_header + k_glb_chunk || read_u32(data + 8) > size) {
+        spdlog::error("glTF: truncated GLB header");
+        return false;
+    }
+
+    const sizet length = read_u32(data + 8);
+    sizet       offset = k_glb_header;
+    while (offset + k_glb_chunk <= length) {
+        const u32 chunk_length = read_u32(data + offset);
+        const u32 chunk_type   = read_u32(data + offset + 4);
+        offset += k_glb_chunk;
+        if (chunk_length > length - offset) {
+            spdlog::error("glTF: GLB chunk runs past the end of the file");
+            return false;
+        }
+
+        if (chunk_type == k_glb_chunk_json && out_json.empty()) {
+            out_json = std::string_view((const char*)data + offset, chunk_length);
+        } else if (chunk_type == k_glb_chunk_bin && !out_binary.data) {
+            out_binary = {data + offset, chunk_length};
+        }
+        // Unknown chunks are skipped, as the spec asks. Chunks are 4 byte aligned.
+        offset += memory_align(chunk_length, 4);
+    }
+
+    if (out_json.empty()) {
+        spdlog::error("glTF: GLB without a JSON chunk");
+        return false;
+    }
+    return true;
+}
+
+static bool decode_base64(std::string_view text, std::vector<u8>& out_data) {
+    auto decode_char = [](char c) -> i32 {
+        if (c >= 'A' && c <= 'Z') {
+            return c - 'A';
+        }
+        if (c >= 'a' && c <= 'z') {
+            return c - 'a' + 26;
+        }
+        if (c >= '0' && c <= '9') {
+            return c - '0' + 52;
+        }
+        if (c == '+' || c == '-') {
+            return 62;
+        }
+        if (c == '/' || c == '_') {
+            return 63;
+        }
+        return -1;
+    };
+
+    while (!text.empty() && text.back() == '=') {
+        text.remove_suffix(1);
+    }
+    out_data.clear();
+    out_data.reserve(text.size() * 3 / 4);
+
+    u32 bits       = 0;
+    u32 bits_count = 0;
+    for (char c : text) {
+        const i32 value = decode_char(c);
+        if (value < 0) {
+            return false;
+        }
+        bits        = (bits << 6) | (u32)value;
+        bits_count += 6;
+        if (bits_count >= 8) {
+            bits_count -= 8;
+            out_data.push_back((u8)(bits >> bits_count));
+        }
+    }
+    return true;
+}
+
+// data:[<mime type>];base64,<data>, the only data URIs glTF allows
+static bool decode_data_uri(std::string_view uri, std::vector<u8>& out_data) {
+    const sizet comma = uri.find(',');
+    if (comma == std::string_view::npos ||
+        uri.substr(0, comma).find(";base64") == std::string_view::npos) {
+        return false;
+    }
+    return decode_base64(uri.substr(comma + 1), out_data);
+}
+
+// Relative URIs may escape spaces and other reserved characters
+static std::string decode_uri(std::string_view uri) {
+    std::string path;
+    path.reserve(uri.size());
+    for (sizet i = 0; i < uri.size(); ++i) {
+        if (uri[i] == '%' && i + 2 < uri.size()) {
+            const char hex[3] = {uri[i + 1], uri[i + 2], '\0'};
+            char*      end    = nullptr;
+            const long value  = strtol(hex, &end, 16);
+            if (end == hex + 2) {
+                path += (char)value;
+                i    += 2;
+                continue;
+            }
+        }
+        path += uri[i];
+    }
+    return path;
+}
+
+static bool load_buffers(GltfContext& context) {
+    const JsonValue* buffers = context.root->find("buffers");
+    if (!buffers) {
+        return true;
+    }
+    context.buffers.resize(buffers->count);
+
+    for (u32 i = 0; i < buffers->count; ++i) {
+        const JsonValue& buffer = (*buffers)[i];
+        std::string_view uri    = buffer.get_string("uri");
+        BufferData&      data   = context.buffers[i];
+        u64              size   = 0;
+        if (!get_byte_size(buffer, "byteLength", size)) {
+            spdlog::error("glTF: buffer {} has an invalid byteLength", i);
+            return false;
+        }
+
+        if (uri.empty()) {
+            // Only the first buffer of a GLB may live in its binary chunk
+            if (i != 0 || !context.glb_binary.data) {
+                spdlog::error("glTF: buffer {} has no uri", i);
+                return false;
+            }
+            data = context.glb_binary;
+        } else if (uri.starts_with("data:")) {
+            std::vector<u8>& decoded = context.decoded_uris.emplace_back();
+            if (!decode_data_uri(uri, decoded)) {
+                spdlog::error("glTF: buffer {} has a malformed data uri", i);
+                return false;
+            }
+            data = {decoded.data(), decoded.size()};
+        } else {
+            const std::string           relative_path = decode_uri(uri);
+            const std::filesystem::path path          = context.directory / relative_path;
+            MappedFile&                 file          = context.external_files.emplace_back();
+            if (!file.open(path.string().c_str())) {
+                spdlog::error("glTF: failed to open buffer {}", path.string());
+                return false;
+            }
+            data = {file.get_data(), file.get_size()};
+            if (context.dependencies) {
+                context.dependencies->push_back(relative_path);
+            }
+        }
+
+        if (data.size < size) {
+            spdlog::error("glTF: buffer {} holds {} bytes, {} expected", i, data.size, size);
+            return false;
+        }
+        data.size = size;
+    }
+    return true;
+}
+
+// Accessors ///////////////////////////////////////////////////////////////
+
+static u32 get_component_size(u32 component_type) {
+    switch (component_type) {
+    case k_gltf_byte:
+    case k_gltf_unsigned_byte:
+        return 1;
+    case k_gltf_short:
+    case k_gltf_unsigned_short:
+        return 2;
+    case k_gltf_unsigned_int:
+    case k_gltf_float:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static u32 get_component_count(std::string_view type) {
+    if (type == "SCALAR") {
+        return 1;
+    }
+    if (type == "VEC2") {
+        return 2;
+    }
+    if (type == "VEC3") {
+        return 3;
+    }
+    if (type == "VEC4" || type == "MAT2") {
+        return 4;
+    }
+    if (type == "MAT3") {
+        return 9;
+    }
+    if (type == "MAT4") {
+        return 16;
+    }
+    return 0;
+}
+
+// Validates the accessor's whole range against its buffer view, decoding then never bounds checks
+static bool resolve_accessor(const GltfContext& context, u32 index, AccessorView& out_view) {
+    const JsonValue* accessors    = context.root->find("accessors");
+    const JsonValue* buffer_views = context.root->find("bufferViews");
+    if (!accessors || index >= accessors->count) {
+        spdlog::error("glTF: accessor {} does not exist", index);
+        return false;
+    }
+
+    const JsonValue& accessor = (*accessors)[index];
+    if (accessor.find("sparse")) {
+        spdlog::error("glTF: accessor {} is sparse, which is not supported", index);
+        return false;
+    }
+    const u32 view_index = accessor.get_u32("bufferView", u32_max);
+    if (!buffer_views || view_index >= buffer_views->count) {
+        spdlog::error("glTF: accessor {} has no buffer view", index);
+        return false;
+    }
+
+    out_view.count          = accessor.get_u32("count", 0);
+    out_view.component_type = accessor.get_u32("componentType", 0);
+    out_view.components     = get_component_count(accessor.get_string("type"));
+    out_view.normalized     = accessor.get_bool("normalized", false);
+    const u32 element_size  = get_component_size(out_view.component_type) * out_view.components;
+    if (element_size == 0) {
+        spdlog::error("glTF: accessor {} has an unknown type", index);
+        return false;
+    }
+
+    const JsonValue& view         = (*buffer_views)[view_index];
+    const u32        buffer_index = view.get_u32("buffer", u32_max);
+    if (buffer_index >= context.buffers.size()) {
+        spdlog::error("glTF: buffer view {} has no buffer", view_index);
+        return false;
+    }
+    const BufferData& buffer      = context.buffers[buffer_index];
+    u64               view_offset = 0;
+    u64               view_length = 0;
+    u64               offset      = 0;
+    if (!get_byte_size(view, "byteOffset", view_offset) ||
+        !get_byte_size(view, "byteLength", view_length) ||
+        !get_byte_size(accessor, "byteOffset", offset)) {
+        spdlog::error("glTF: accessor {} has an invalid byte offset or length", index);
+        return false;
+    }
+    out_view.stride = view.get_u32("byteStride", element_size);
+
+    // Bytes from the accessor's offset to the end of its last element. Both factors are u32, so
+    // this can't wrap, and the checks below subtract instead of adding for the same reason.
+    const u64 extent = out_view.count == 0
+                           ? 0
+                           : (u64)out_view.stride * (out_view.count - 1) + element_size;
+    if (view_offset > buffer.size || view_length > buffer.size - view_offset ||
+        offset > view_length || extent > view_length - offset) {
+        spdlog::error("glTF: accessor {} runs past the end of its buffer", index);
+        return false;
+    }
+    out_view.data = buffer.data + view_offset + offset;
+    return true;
+}
+
+// Converts up to count components of one element to floats, applying normalization as the spec
+// defines it
+static void read_floats(const AccessorView& view, u32 element, f32* out, u32 count) {
+    const u8* data = view.data + (u64)view.stride * element;
+    count          = count < view.components ? count : view.components;
+
+    switch (view.component_type) {
+    case k_gltf_float:
+        memcpy(out, data, count * sizeof(f32));
+        return;
+    case k_gltf_byte:
+        for (u32 i = 0; i < count; ++i) {
+            const f32 value = (f32)(i8)data[i];
+            out[i]          = view.normalized ? std::max(value / 127.0f, -1.0f) : value;
+        }
+        return;
+    case k_gltf_unsigned_byte:
+        for (u32 i = 0; i < count; ++i) {
+            out[i] = view.normalized ? data[i] / 255.0f : (f32)data[i];
+        }
+        return;
+    case k_gltf_short:
+        for (u32 i = 0; i < count; ++i) {
+            i16 value;
+            memcpy(&value, data + i * 2, sizeof(value));
+            out[i] = view.normalized ? std::max(value / 32767.0f, -1.0f) : (f32)value;
+        }
+        return;
+    case k_gltf_unsigned_short:
+        for (u32 i = 0; i < count; ++i) {
+            u16 value;
+            memcpy(&value, data + i * 2, sizeof(value));
+            out[i] = view.normalized ? value / 65535.0f : (f32)value;
+        }
+        return;
+    case k_gltf_unsigned_int:
+        for (u32 i = 0; i < count; ++i) {
+            out[i] = (f32)read_u32(data + i * 4);
+        }
+        return;
+    }
+}
+
+static u32 read_index(const AccessorView& view, u32 element) {
+    const u8* data = view.data + (u64)view.stride * element;
+    switch (view.component_type) {
+    case k_gltf_unsigned_byte:
+        return data[0];
+    case k_gltf_unsigned_short: {
+        u16 value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+    default:
+        return read_u32(data);
+    }
+}
+
+// Decode jobs run on the workers, each one writes a disjoint range of the model's arrays
+static bool decode(const DecodeJob& job, const PrimitiveSource& source, ModelData& model) {
+    const Primitive& primitive = model.primitives[job.primitive];
+
+    if (job.indices) {
+        u32* indices = model.indices + primitive.first_index;
+        if (!source.indices.data) {
+            for (u32 i = job.begin; i < job.end; ++i) {
+                indices[i] = i;
+            }
+            return true;
+        }
+        bool valid = true;
+        for (u32 i = job.begin; i < job.end; ++i) {
+            indices[i] = read_index(source.indices, i);
+            valid      = valid && indices[i] < primitive.vertex_count;
+        }
+        return valid;
+    }
+
+    Vertex* vertices = model.vertices + primitive.vertex_offset;
+    for (u32 i = job.begin; i < job.end; ++i) {
+        Vertex& vertex = vertices[i];
+        memset(&vertex, 0, sizeof(vertex));
+        read_floats(source.position, i, vertex.position, 3);
+        if (source.normal.data) {
+            read_floats(source.normal, i, vertex.normal, 3);
+        }
+        if (source.uv.data) {
+            read_floats(source.uv, i, vertex.uv, 2);
+        }
+    }
+    return true;
+}
+
+// Scene ///////////////////////////////////////////////////////////////////
+
+static void read_float_array(const JsonValue* array, f32* out, u32 count) {
+    if (!array || !array->is_array() || array->count != count) {
+        return;
+    }
+    for (u32 i = 0; i < count; ++i) {
+        out[i] = (f32)(*array)[i].number;
+    }
+}
+
+// Column major T * R * S, r is a quaternion (x, y, z, w)
+static void compose_transform(const f32 t[3], const f32 r[4], const f32 s[3], f32 out[16]) {
+    const f32 x = r[0], y = r[1], z = r[2], w = r[3];
+    out[0]      = (1.0f - 2.0f * (y * y + z * z)) * s[0];
+    out[1]      = 2.0f * (x * y + z * w) * s[0];
+    out[2]      = 2.0f * (x * z - y * w) * s[0];
+    out[3]      = 0.0f;
+    out[4]      = 2.0f * (x * y - z * w) * s[1];
+    out[5]      = (1.0f - 2.0f * (x * x + z * z)) * s[1];
+    out[6]      = 2.0f * (y * z + x * w) * s[1];
+    out[7]      = 0.0f;
+    out[8]      = 2.0f * (x * z + y * w) * s[2];
+    out[9]      = 2.0f * (y * z - x * w) * s[2];
+    out[10]     = (1.0f - 2.0f * (x * x + y * y)) * s[2];
+    out[11]     = 0.0f;
+    out[12]     = t[0];
+    out[13]     = t[1];
+    out[14]     = t[2];
+    out[15]     = 1.0f;
+}
+
+static void multiply_transform(const f32 a[16], const f32 b[16], f32 out[16]) {
+    for (u32 column = 0; column < 4; ++column) {
+        for (u32 row = 0; row < 4; ++row) {
+            f32 sum = 0.0f;
+            for (u32 k = 0; k < 4; ++k) {
+                sum += a[k * 4 + row] * b[column * 4 + k];
+            }
+            out[column * 4 + row] = sum;
+        }
+    }
+}
+
+static bool load_nodes(const GltfContext& context, Arena& arena, ModelData& model) {
+    const JsonValue* nodes = context.root->find("nodes");
+    if (!nodes || nodes->count == 0) {
+        return true;
+    }
+    model.node_count = nodes->count;
+    model.nodes      = allocate_array<Node>(arena, model.node_count);
+    if (!model.nodes) {
+        return false;
+    }
+
+    for (u32 i = 0; i < model.node_count; ++i) {
+        const JsonValue& source = (*nodes)[i];
+        Node&            node   = model.nodes[i];
+        node.parent             = u32_max;
+        node.mesh               = source.get_u32("mesh", u32_max);
+        if (node.mesh != u32_max && node.mesh >= model.mesh_count) {
+            spdlog::error("glTF: node {} references mesh {} which does not exist", i, node.mesh);
+            return false;
+        }
+
+        f32 translation[3] = {0.0f, 0.0f, 0.0f};
+        f32 rotation[4]    = {0.0f, 0.0f, 0.0f, 1.0f};
+        f32 scale[3]       = {1.0f, 1.0f, 1.0f};
+        read_float_array(source.find("translation"), translation, 3);
+        read_float_array(source.find("rotation"), rotation, 4);
+        read_float_array(source.find("scale"), scale, 3);
+        compose_transform(translation, rotation, scale, node.local);
+        read_float_array(source.find("matrix"), node.local, 16);
+    }
+
+    for (u32 i = 0; i < model.node_count; ++i) {
+        const JsonValue* children = (*nodes)[i].find("children");
+        for (u32 c = 0; children && c < children->count; ++c) {
+            const JsonValue& value = (*children)[c];
+            if (!value.is_integer((f64)(model.node_count - 1))) {
+                spdlog::error("glTF: node {} has an invalid child", i);
+                return false;
+            }
+            const u32 child = (u32)value.number;
+            if (model.nodes[child].parent != u32_max || child == i) {
+                spdlog::error("glTF: node {} has an invalid child {}", i, child);
+                return false;
+            }
+            model.nodes[child].parent = i;
+        }
+    }
+
+    // Parents first, walking down from every root. Nodes caught in a cycle are never reached
+    // and keep their local transform.
+    std::vector<u32> stack;
+    for (u32 i = 0; i < model.node_count; ++i) {
+        memcpy(model.nodes[i].world, model.nodes[i].local, sizeof(model.nodes[i].world));
+        if (model.nodes[i].parent == u32_max) {
+            stack.push_back(i);
+        }
+    }
+    while (!stack.empty()) {
+        const u32 index = stack.back();
+        stack.pop_back();
+        const Node&      node     = model.nodes[index];
+        const JsonValue* children = (*nodes)[index].find("children");
+        // Every child index passed the checks above
+        for (u32 c = 0; children && c < children->count; ++c) {
+            const u32 child_index = (u32)(*children)[c].number;
+            Node&     child       = model.nodes[child_index];
+            multiply_transform(node.world, child.local, child.world);
+            stack.push_back(child_index);
+        }
+    }
+    return true;
+}
+
+static u32 get_texture_image(const GltfContext& context, const JsonValue* texture_info) {
+    const JsonValue* textures = context.root->find("textures");
+    const u32        texture  = texture_info ? texture_info->get_u32("index", u32_max) : u32_max;
+    if (!textures || texture >= textures->count) {
+        return k_invalid_image;
+    }
+    return (*textures)[texture].get_u32("source", k_invalid_image);
+}
+
+static bool load_materials(const GltfContext& context, Arena& arena, ModelData& model) {
+    const JsonValue* materials = context.root->find("materials");
+    const u32        count     = materials ? materials->count : 0;
+
+    // One more at the end for primitives without a material
+    model.material_count       = count + 1;
+    model.materials            = allocate_array<Material>(arena, model.material_count);
+    if (!model.materials) {
+        return false;
+    }
+
+    for (u32 i = 0; i < model.material_count; ++i) {
+        Material& material = model.materials[i];
+        material           = Material{};
+        if (i == count) {
+            break;
+        }
+
+        const JsonValue& source = (*materials)[i];
+        if (const JsonValue* pbr = source.find("pbrMetallicRoughness")) {
+            read_float_array(pbr->find("baseColorFactor"), material.base_color_factor, 4);
+            material.metallic_factor  = (f32)pbr->get_number("metallicFactor", 1.0);
+            material.roughness_factor = (f32)pbr->get_number("roughnessFactor", 1.0);
+            material.base_color_image = get_texture_image(context, pbr->find("baseColorTexture"));
+            material.metallic_roughness_image =
+                get_texture_image(context, pbr->find("metallicRoughnessTexture"));
+        }
+        read_float_array(source.find("emissiveFactor"), material.emissive_factor, 3);
+        material.normal_image    = get_texture_image(context, source.find("normalTexture"));
+        material.occlusion_image = get_texture_image(context, source.find("occlusionTexture"));
+        material.emissive_image  = get_texture_image(context, source.find("emissiveTexture"));
+        material.alpha_cutoff    = (f32)source.get_number("alphaCutoff", 0.5);
+        material.double_sided    = source.get_bool("doubleSided", false);
+
+        const std::string_view alpha_mode = source.get_string("alphaMode", "OPAQUE");
+        material.alpha_mode               = alpha_mode == "MASK"    ? k_alpha_mask
+                                            : alpha_mode == "BLEND" ? k_alpha_blend
+                                                                    : k_alpha_opaque;
+    }
+    return true;
+}
+
+static bool load_images(const GltfContext& context, Arena& arena, ModelData& model) {
+    const JsonValue* images       = context.root->find("images");
+    const JsonValue* buffer_views = context.root->find("bufferViews");
+    if (!images || images->count == 0) {
+        return true;
+    }
+    model.image_count = images->count;
+    model.images      = allocate_array<ImageSource>(arena, model.image_count);
+    if (!model.images) {
+        return false;
+    }
+
+    for (u32 i = 0; i < model.image_count; ++i) {
+        const JsonValue& source = (*images)[i];
+        ImageSource&     image  = model.images[i];
+        image                   = ImageSource{};
+        image.mime_type         = copy_string(arena, source.get_string("mimeType"));
+
+        // Embedded images are copied, the model outlives the mapped file
+        const std::string_view uri        = source.get_string("uri");
+        const u32              view_index = source.get_u32("bufferView", u32_max);
+        if (view_index != u32_max) {
+            const JsonValue* view   = buffer_views && view_index < buffer_views->count
+                                          ? &(*buffer_views)[view_index]
+                                          : nullptr;
+            const u32        buffer = view ? view->get_u32("buffer", u32_max) : u32_max;
+            u64              offset = 0;
+            u64              length = 0;
+            if (buffer >= context.buffers.size() || !get_byte_size(*view, "byteOffset", offset) ||
+                !get_byte_size(*view, "byteLength", length) ||
+                offset > context.buffers[buffer].size ||
+                length > context.buffers[buffer].size - offset) {
+                spdlog::error("glTF: image {} has an invalid buffer view", i);
+                return false;
+            }
+            if (!copy_image_data(arena, context.buffers[buffer].data + offset, length, image)) {
+                return false;
+            }
+        } else if (uri.starts_with("data:")) {
+            std::vector<u8> decoded;
+            if (!decode_data_uri(uri, decoded)) {
+                spdlog::error("glTF: image {} has a malformed data uri", i);
+                return false;
+            }
+            if (!copy_image_data(arena, decoded.data(), decoded.size(), image)) {
+                return false;
+            }
+            if (!image.mime_type) {
+                const std::string_view header = uri.substr(0, uri.find(';'));
+                image.mime_type               = copy_string(arena, header.substr(5));
+            }
+        } else {
+            const std::string relative_path = decode_uri(uri);
+            image.uri                       = copy_string(arena, relative_path);
+            if (context.dependencies) {
+                context.dependencies->push_back(relative_path);
+            }
+        }
+    }
+    return true;
+}
+
+// Meshes //////////////////////////////////////////////////////////////////
+
+static bool load_meshes(GltfContext& context, JobSystem* job_system, Arena& arena,
+                        ModelData& model) {
+    const JsonValue* meshes = context.root->find("meshes");
+    if (!meshes || meshes->count == 0) {
+        return true;
+    }
+
+    // Resolve and validate every accessor up front, so the decode jobs only convert data
+    std::vector<Primitive>       primitives;
+    std::vector<PrimitiveSource> sources;
+    model.mesh_count = meshes->count;
+    model.meshes     = allocate_array<Mesh>(arena, model.mesh_count);
+    if (!model.meshes) {
+        return false;
+    }
+
+    u64 vertex_count = 0;
+    u64 index_count  = 0;
+    for (u32 m = 0; m < meshes->count; ++m) {
+        const JsonValue* mesh_primitives = (*meshes)[m].find("primitives");
+        Mesh&            mesh            = model.meshes[m];
+        mesh.first_primitive             = (u32)primitives.size();
+
+        for (u32 p = 0; mesh_primitives && p < mesh_primitives->count; ++p) {
+            const JsonValue& source     = (*mesh_primitives)[p];
+            const JsonValue* attributes = source.find("attributes");
+            if (source.get_u32("mode", k_gltf_mode_triangles) != k_gltf_mode_triangles) {
+                spdlog::warn("glTF: mesh {} primitive {} is not a triangle list, skipped", m, p);
+                continue;
+            }
+            if (!attributes || !attributes->find("POSITION")) {
+                spdlog::warn("glTF: mesh {} primitive {} has no positions, skipped", m, p);
+                continue;
+            }
+
+            PrimitiveSource accessors;
+            auto            resolve = [&](std::string_view name, AccessorView& out_view) {
+                const u32 accessor = attributes->get_u32(name, u32_max);
+                return accessor == u32_max || resolve_accessor(context, accessor, out_view);
+            };
+            if (!resolve("POSITION", accessors.position) || !resolve("NORMAL", accessors.normal) ||
+                !resolve("TEXCOORD_0", accessors.uv)) {
+                return false;
+            }
+            const u32 indices = source.get_u32("indices", u32_max);
+            if (indices != u32_max && !resolve_accessor(context, indices, accessors.indices)) {
+                return false;
+            }
+
+            const u32 count = accessors.position.count;
+            if ((accessors.normal.data && accessors.normal.count != count) ||
+                (accessors.uv.data && accessors.uv.count != count)) {
+                spdlog::error("glTF: mesh {} primitive {} has attributes of different lengths", m,
+                              p);
+                return false;
+            }
+            if (accessors.indices.data &&
+                (accessors.indices.components != 1 ||
+                 accessors.indices.component_type == k_gltf_byte ||
+                 accessors.indices.component_type == k_gltf_short ||
+                 accessors.indices.component_type == k_gltf_float)) {
+                spdlog::error("glTF: mesh {} primitive {} has invalid indices", m, p);
+                return false;
+            }
+
+            Primitive primitive{};
+            primitive.vertex_offset = (u32)vertex_count;
+            primitive.vertex_count  = count;
+            primitive.first_index   = (u32)index_count;
+            primitive.index_count   = accessors.indices.data ? accessors.indices.count : count;
+            primitive.material      = source.get_u32("material", model.material_count - 1);
+            if (primitive.material >= model.material_count) {
+                primitive.material = model.material_count - 1;
+            }
+            // The spec requires min and max on positions
+            const JsonValue& position =
+                (*context.root->find("accessors"))[attributes->get_u32("POSITION", 0)];
+            read_float_array(position.find("min"), primitive.bounds_min, 3);
+            read_float_array(position.find("max"), primitive.bounds_max, 3);
+
+            vertex_count += primitive.vertex_count;
+            index_count  += primitive.index_count;
+            if (vertex_count > u32_max || index_count > u32_max) {
+                spdlog::error("glTF: model has more than 2^32 vertices or indices");
+                return false;
+            }
+            primitives.push_back(primitive);
+            sources.push_back(accessors);
+        }
+        mesh.primitive_count = (u32)primitives.size() - mesh.first_primitive;
+    }
+
+    model.primitive_count = (u32)primitives.size();
+    model.vertex_count    = (u32)vertex_count;
+    model.index_count     = (u32)index_count;
+    model.primitives      = allocate_array<Primitive>(arena, model.primitive_count);
+    model.vertices        = allocate_array<Vertex>(arena, model.vertex_count);
+    model.indices         = allocate_array<u32>(arena, model.index_count);
+    if ((model.primitive_count && !model.primitives) || (model.vertex_count && !model.vertices) ||
+        (model.index_count && !model.indices)) {
+        return false;
+    }
+    if (model.primitive_count) {
+        memcpy(model.primitives, primitives.data(), primitives.size() * sizeof(Primitive));
+    }
+
+    std::vector<DecodeJob> jobs;
+    for (u32 p = 0; p < model.primitive_count; ++p) {
+        const Primitive& primitive = model.primitives[p];
+        for (u32 begin = 0; begin < primitive.vertex_count; begin += k_decode_batch) {
+            jobs.push_back(
+                {p, begin, std::min(begin + k_decode_batch, primitive.vertex_count), false});
+        }
+        for (u32 begin = 0; begin < primitive.index_count; begin += k_decode_batch) {
+            jobs.push_back(
+                {p, begin, std::min(begin + k_decode_batch, primitive.index_count), true});
+        }
+    }
+
+    FIZZ_PROFILE_SCOPE("DecodeAccessors");
+    std::atomic<bool> valid{true};
+    auto              decode_jobs = [&](u32 begin, u32 end) {
+        FIZZ_PROFILE_SCOPE("DecodeBatch");
+        for (u32 i = begin; i < end; ++i) {
+            if (!decode(jobs[i], sources[jobs[i].primitive], model)) {
+                valid.store(false, std::memory_order_relaxed);
+            }
+        }
+    };
+    if (job_system) {
+        job_system->parallel_for((u32)jobs.size(), 1, decode_jobs);
+    } else {
+        decode_jobs(0, (u32)jobs.size());
+    }
+
+    if (!valid.load()) {
+        spdlog::error("glTF: indices reference vertices past the end of their primitive");
+        return false;
+    }
+    return true;
+}
+
+bool load_gltf(cstring path, JobSystem* job_system, Arena& arena, ModelData& out_model,
+               std::vector<std::string>* out_dependencies) {
+    FIZZ_PROFILE_FUNCTION();
+    const auto start = std::chrono::steady_clock::now();
+    out_model        = ModelData{};
+
+    MappedFile file;
+    if (!file.open(path)) {
+        spdlog::error("glTF: failed to open {}", path);
+        return false;
+    }
+
+    GltfContext context;
+    context.directory    = std::filesystem::path(path).parent_path();
+    context.dependencies = out_dependencies;
+
+    std::string_view json;
+    if (file.get_size() >= 4 && read_u32(file.get_data()) == k_glb_magic) {
+        if (!read_glb(file, json, context.glb_binary)) {
+            return false;
+        }
+    } else {
+        json = std::string_view((const char*)file.get_data(), file.get_size());
+    }
+
+    // The document is only needed while loading, keep it out of the model's arena. The densest
+    // documents, arrays of one digit numbers, take a JsonValue per two bytes, so a JsonValue per
+    // byte always fits. It is only reserved, pages are committed as the tree grows.
+    Arena scratch;
+    if (!scratch.init(memory_align(json.size() * sizeof(JsonValue), mega(1)) + mega(16))) {
+        spdlog::error("glTF: failed to reserve scratch memory");
+        return false;
+    }
+
+    JsonValue root;
+    bool      loaded = false;
+    {
+        FIZZ_PROFILE_SCOPE("ParseJson");
+        loaded = json_parse(json.data(), json.size(), &scratch, root);
+    }
+    if (loaded && !root.is_object()) {
+        spdlog::error("glTF: document root is not an object");
+        loaded = false;
+    }
+
+    if (loaded) {
+        // Materials before meshes and meshes before nodes, each validates indices into the last
+        context.root = &root;
+        loaded       = load_buffers(context) && load_materials(context, arena, out_model) &&
+                 load_meshes(context, job_system, arena, out_model) &&
+                 load_nodes(context, arena, out_model) && load_images(context, arena, out_model);
+    }
+    scratch.shutdown();
+
+    if (!loaded) {
+        spdlog::error("glTF: failed to load {}", path);
+        out_model = ModelData{};
+        return false;
+    }
+
+    const f64 elapsed_ms =
+        std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("Loaded {} in {:.1f} ms: {} vertices, {} indices, {} primitives", path,
+                 elapsed_ms, out_model.vertex_count, out_model.index_count,
+                 out_model.primitive_count);
+    return true;
+}
+
+} // namespace fizzengine
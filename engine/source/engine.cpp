@@ -5,6 +5,7 @@
 #include <backends/imgui_impl_sdl2.h>
 #include <backends/imgui_impl_vulkan.h>
 #include <foundation/allocators.hpp>
+#include <foundation/profiler.hpp>
 #include <foundation/resource_pool.hpp>
 #include <imgui.h>
 #include <renderer/renderer.hpp>
@@ -13,63 +14,140 @@
 
 namespace fizzengine {
 
-void FizzEngine::init() {
-    m_window.init();
-    m_gpu.init_vulkan(m_window);
-    init_imgui();
-    img = ImGui_ImplVulkan_AddTexture(m_gpu.m_draw_image.m_sampler, m_gpu.m_draw_image.m_image_view,
-                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    spdlog::info("Fizz Engine Initialized");
+#ifdef NDEBUG
+static const bool k_capture_allocation_callstacks = false;
+#else
+static const bool k_capture_allocation_callstacks = true;
+#endif
+
+// Matches PushConstants in shaders/gradient.comp.slang
+struct GradientPushConstants {
+    u32 draw_image;
+};
+
+void FizzEngine::init(const EngineCreation& creation) {
+    profiler_init();
+    // FIZZ_CPU_CAPTURE=<frames> records a trace from startup without touching the UI
+    if (const char* capture_frames = getenv("FIZZ_CPU_CAPTURE")) {
+        profiler_begin_capture((u32)atoi(capture_frames));
+    }
+
+    m_heap_allocator.init(mega(32));
+    // The main thread becomes worker 0 and helps out whenever it waits on jobs
+    m_job_system.init();
+    m_gpu_allocator.init("GPUDevice", &m_heap_allocator, k_capture_allocation_callstacks);
+
+    m_headless               = creation.headless;
+    m_max_frames             = creation.max_frames;
+    m_window                 = Window("Fizz Engine", creation.width, creation.height);
+    m_gpu.m_headless         = m_headless;
+    m_gpu.m_frame_pacing     = creation.pacing;
+    m_gpu.m_frames_in_flight = creation.frames_in_flight;
+    if (!m_headless) {
+        m_window.init();
+    }
+    m_gpu.init_vulkan(m_window, &m_gpu_allocator, &m_job_system);
+    if (!m_headless) {
+        init_imgui();
+        img = ImGui_ImplVulkan_AddTexture(m_gpu.m_draw_image.m_sampler,
+                                          m_gpu.m_draw_image.m_image_view,
+                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+    spdlog::info("Fizz Engine Initialized{}", m_headless ? " (headless)" : "");
     is_initialized = true;
 }
 
 void FizzEngine::shutdown() {
-    ImGui_ImplVulkan_RemoveTexture(img);
+    if (!m_headless) {
+        ImGui_ImplVulkan_RemoveTexture(img);
+    }
     m_gpu.shutdown();
-    m_window.shutdown();
+    if (!m_headless) {
+        m_window.shutdown();
+    }
+    m_job_system.shutdown();
+    m_gpu_allocator.shutdown();
+    m_heap_allocator.shutdown();
+    profiler_shutdown();
 
     spdlog::info("Fizz Engine Closed");
 }
 
 void FizzEngine::update() {
+    // No simulation state yet, its work goes through m_job_system once there is some
 }
 
 void FizzEngine::render() {
+    FIZZ_PROFILE_FUNCTION();
     VkCommandBuffer cmd = m_gpu.new_frame();
+    if (cmd == VK_NULL_HANDLE) {
+        // No image to render to while minimized, ImGui still expects its platform windows updated
+        if (!m_headless && ImGui::GetIO().ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
+            std::lock_guard lock(m_gpu.m_queue_mutex);
+            ImGui::UpdatePlatformWindows();
+        }
+        return;
+    }
 
     {
-        VkImage draw_image = m_gpu.m_draw_image.m_image;
-        vkutil::transition_image(cmd, draw_image, VK_IMAGE_LAYOUT_UNDEFINED,
-                                 VK_IMAGE_LAYOUT_GENERAL);
-
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_gpu.m_grad_pipeline);
-        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_gpu.m_grad_pipeline_layout,
-                                0, 1, &m_gpu.m_draw_image_descriptors, 0, nullptr);
-
-        vkCmdDispatch(cmd, std::ceil(m_gpu.m_draw_extent.width / 16.0),
-                      std::ceil(m_gpu.m_draw_extent.height / 16.0), 1);
-
-        // make the draw image into presentable mode
-        vkutil::transition_image(cmd, draw_image, VK_IMAGE_LAYOUT_GENERAL,
-                                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        // vkutil::transition_image(cmd, m_gpu.get_current_swapchain_image(),
-        // VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        // vkutil::copy_image_to_image(cmd, draw_image, m_gpu.get_current_swapchain_image(),
-        // m_gpu.m_draw_extent, m_gpu.m_swapchain_extent);
-
-        vkutil::transition_image(cmd, m_gpu.get_current_swapchain_image(),
-                                 VK_IMAGE_LAYOUT_UNDEFINED,
-                                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-        draw_imgui(cmd, m_gpu.get_current_swapchain_image_view());
-        // set swapchain image layout to Present so we can show it on the screen
-        vkutil::transition_image(cmd, m_gpu.get_current_swapchain_image(),
-                                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                 VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
-
-        // finalize the command buffer (we can no longer add commands, but it can now be executed)
-        VK_CHECK(vkEndCommandBuffer(cmd));
-    }
-    if (ImGui::GetIO().ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
+        GPUProfileScope frame_scope(m_gpu.m_gpu_profiler, cmd, "Frame");
+
+        RenderGraph&        graph      = m_gpu.m_render_graph;
+        RenderGraphResource draw_image = graph.import_image(
+            "DrawImage", m_gpu.m_draw_image.m_image, m_gpu.m_draw_image.m_image_view);
+        // The viewport windows ImGui renders outside the graph sample it too
+        graph.set_final_usage(draw_image, k_usage_fragment_sampled);
+
+        // Freshly acquired, whatever it held is gone
+        RenderGraphResource swapchain = graph.import_image(
+            "Swapchain", m_gpu.get_current_swapchain_image(),
+            m_gpu.get_current_swapchain_image_view(), VK_IMAGE_ASPECT_COLOR_BIT, k_usage_undefined);
+        // Headless targets are left ready for readback
+        graph.set_final_usage(swapchain, m_headless ? k_usage_transfer_src : k_usage_present);
+
+        u32 gradient = graph.add_pass("Gradient", [this](VkCommandBuffer cmd) {
+            // Passes are recorded into secondaries on the workers and stitched in order here
+            m_gpu.record_parallel(cmd, 1, nullptr, [this](u32 index, VkCommandBuffer pass_cmd) {
+                vkCmdBindPipeline(pass_cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_gpu.m_grad_pipeline);
+                m_gpu.m_bindless.bind(pass_cmd, VK_PIPELINE_BIND_POINT_COMPUTE);
+
+                GradientPushConstants push_constants{m_gpu.m_draw_image.m_storage_index};
+                vkCmdPushConstants(pass_cmd, m_gpu.m_bindless.get_pipeline_layout(),
+                                   VK_SHADER_STAGE_ALL, 0, sizeof(push_constants),
+                                   &push_constants);
+
+                vkCmdDispatch(pass_cmd, std::ceil(m_gpu.m_draw_extent.width / 16.0),
+                              std::ceil(m_gpu.m_draw_extent.height / 16.0), 1);
+            });
+        });
+        graph.write(gradient, draw_image, k_usage_compute_storage_write);
+
+        if (m_headless) {
+            // Stands in for the UI pass so the frame still ends with a full size write
+            u32 blit = graph.add_pass("Blit", [this](VkCommandBuffer cmd) {
+                vkutil::copy_image_to_image(cmd, m_gpu.m_draw_image.m_image,
+                                            m_gpu.get_current_swapchain_image(), m_gpu.m_draw_extent,
+                                            m_gpu.m_swapchain_extent);
+            });
+            graph.read(blit, draw_image, k_usage_transfer_src);
+            graph.write(blit, swapchain, k_usage_transfer_dst);
+        } else {
+            u32 imgui = graph.add_pass("ImGui", [this](VkCommandBuffer cmd) {
+                draw_imgui(cmd, m_gpu.get_current_swapchain_image_view());
+            });
+            graph.read(imgui, draw_image, k_usage_fragment_sampled);
+            graph.write(imgui, swapchain, k_usage_color_attachment);
+        }
+
+        graph.compile();
+        graph.execute(cmd, &m_gpu.m_gpu_profiler);
+    }
+    // finalize the command buffer (we can no longer add commands, but it can now be executed)
+    VK_CHECK(vkEndCommandBuffer(cmd));
+    if (!m_headless && ImGui::GetIO().ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
+        // Submits and presents on the graphics queue, and waits for the device when windows are
+        // resized, while the upload thread may be submitting
+        std::lock_guard lock(m_gpu.m_queue_mutex);
         ImGui::UpdatePlatformWindows();
         ImGui::RenderPlatformWindowsDefault();
     }
@@ -78,8 +156,32 @@ void FizzEngine::render() {
 
 void FizzEngine::run() {
     bool b_quit = false;
-    while (!b_quit) {
-        m_window.handle_events(b_quit);
+    for (u32 frame = 0; !b_quit && (m_max_frames == 0 || frame < m_max_frames); ++frame) {
+        run_frame(b_quit);
+    }
+}
+
+void FizzEngine::run_frame(bool& quit) {
+    FIZZ_PROFILE_FRAME();
+    if (m_headless) {
+        update();
+        render();
+        return;
+    }
+
+    // Low latency pacing waits here, so the events below are as fresh as they can be
+    m_gpu.pace_frame();
+    {
+        FIZZ_PROFILE_SCOPE("HandleEvents");
+        m_window.handle_events(quit);
+    }
+    if (m_window.consume_resize()) {
+        m_gpu.invalidate_swapchain();
+    }
+    update();
+
+    {
+        FIZZ_PROFILE_SCOPE("ImGui");
         ImGui_ImplVulkan_NewFrame();
         ImGui_ImplSDL2_NewFrame();
         ImGui::NewFrame();
@@ -93,12 +195,14 @@ void FizzEngine::run() {
         ImGui::End();
         // some imgui UI to test
         ImGui::ShowDemoWindow();
+        draw_memory_panel();
+        draw_profiler_panel();
         // make imgui calculate internal draw structures
         ImGui::Render();
-        // our draw function
-
-        render();
     }
+    // our draw function
+
+    render();
 }
 
 void FizzEngine::init_imgui() {
@@ -153,14 +257,21 @@ void FizzEngine::init_imgui() {
 
     ImGui_ImplVulkan_Init(&init_info);
 
-    ImGui_ImplVulkan_CreateFontsTexture();
+    {
+        std::lock_guard lock(m_gpu.m_queue_mutex);
+        ImGui_ImplVulkan_CreateFontsTexture();
+    }
     ImGuiIO& io = ImGui::GetIO();
     io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
     io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
     ImGui::StyleColorsDark();
     // add the destroy the imgui created structures
     m_gpu.m_main_deletion_queue.push_function([=, this]() {
-        ImGui_ImplVulkan_Shutdown();
+        {
+            // Waits for the device, which touches the queue the upload thread submits to
+            std::lock_guard lock(m_gpu.m_queue_mutex);
+            ImGui_ImplVulkan_Shutdown();
+        }
         vkDestroyDescriptorPool(m_gpu.m_device, imguiPool, nullptr);
     });
 }
@@ -178,4 +289,136 @@ void FizzEngine::draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView) {
     vkCmdEndRendering(cmd);
 }
 
+void FizzEngine::draw_memory_panel() {
+    ImGui::Begin("Memory");
+
+    HeapStatistics heap = m_heap_allocator.get_statistics();
+    ImGui::Text("Heap: %.2f / %.2f MB in %u pools, %u allocations", heap.used_bytes / 1048576.0,
+                heap.total_bytes / 1048576.0, heap.pool_count, heap.allocation_count);
+    ImGui::Text("Largest free block %.2f MB, fragmentation %.1f%%",
+                heap.largest_free_block / 1048576.0, heap.fragmentation * 100.0f);
+    ImGui::Separator();
+
+    TrackingAllocator* trackers[32];
+    const u32          tracker_count = TrackingAllocator::get_registered(trackers);
+
+    if (ImGui::BeginTable("allocators", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Tag");
+        ImGui::TableSetupColumn("Live KB");
+        ImGui::TableSetupColumn("Peak KB");
+        ImGui::TableSetupColumn("Live allocs");
+        ImGui::TableSetupColumn("Total allocs");
+        ImGui::TableHeadersRow();
+
+        for (u32 i = 0; i < tracker_count; ++i) {
+            AllocationStats stats = trackers[i]->get_stats();
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(stats.tag);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", stats.live_bytes / 1024.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", stats.peak_bytes / 1024.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", stats.live_allocations);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", stats.total_allocations);
+        }
+        ImGui::EndTable();
+    }
+
+    for (u32 i = 0; i < tracker_count; ++i) {
+        AllocationStats stats = trackers[i]->get_stats();
+        if (ImGui::TreeNode(stats.tag, "%s size histogram (16B .. 256KB+)", stats.tag)) {
+            f32 buckets[AllocationStats::k_histogram_buckets];
+            for (u32 b = 0; b < AllocationStats::k_histogram_buckets; ++b) {
+                buckets[b] = (f32)stats.size_histogram[b];
+            }
+            ImGui::PlotHistogram("##sizes", buckets, AllocationStats::k_histogram_buckets, 0,
+                                 nullptr, 0.0f, FLT_MAX, ImVec2(0, 80));
+            ImGui::TreePop();
+        }
+    }
+
+    ImGui::End();
+}
+
+void FizzEngine::draw_profiler_panel() {
+    GPUProfiler& profiler = m_gpu.m_gpu_profiler;
+    ImGui::Begin("Profiler");
+
+    if (ImGui::BeginCombo("Frame pacing", get_frame_pacing_name(m_gpu.m_frame_pacing))) {
+        for (u32 pacing = 0; pacing < k_pacing_count; ++pacing) {
+            if (ImGui::Selectable(get_frame_pacing_name((FramePacing)pacing),
+                                  pacing == m_gpu.m_frame_pacing)) {
+                m_gpu.set_frame_pacing((FramePacing)pacing);
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+#if defined(FIZZ_ENABLE_PROFILER)
+    if (profiler_is_capturing()) {
+        ImGui::TextUnformatted("Capturing CPU trace...");
+    } else if (ImGui::Button("Capture CPU trace (60 frames)")) {
+        profiler_begin_capture(60);
+    }
+#endif
+
+    if (!profiler.is_enabled()) {
+        ImGui::TextUnformatted("Timestamps are not supported on this queue");
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Text("Frame %llu", (unsigned long long)profiler.get_resolved_frame());
+    ImGui::SameLine();
+    if (ImGui::Button("Export CSV")) {
+        profiler.export_csv("gpu_timings.csv");
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export JSON")) {
+        profiler.export_json("gpu_timings.json");
+    }
+
+    const bool statistics = profiler.get_statistic_flags() != 0;
+    if (ImGui::BeginTable("scopes", statistics ? 6 : 4,
+                          ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("Last ms");
+        ImGui::TableSetupColumn("Avg ms");
+        ImGui::TableSetupColumn("Max ms");
+        if (statistics) {
+            ImGui::TableSetupColumn("VS / FS invocations");
+            ImGui::TableSetupColumn("CS invocations");
+        }
+        ImGui::TableHeadersRow();
+
+        // Scopes come in the order they were opened, indent by depth to show the hierarchy
+        for (const GPUScopeTiming& timing : profiler.get_timings()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%*s%s", (int)timing.depth * 2, "", timing.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", timing.elapsed_ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", timing.average_ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", timing.max_ms);
+            if (statistics) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu / %llu",
+                            (unsigned long long)timing.statistics[k_statistic_vertex_invocations],
+                            (unsigned long long)timing.statistics[k_statistic_fragment_invocations]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu",
+                            (unsigned long long)timing.statistics[k_statistic_compute_invocations]);
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
 } // namespace fizzengine
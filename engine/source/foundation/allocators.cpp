@@ -1,30 +1,575 @@
 #include <foundation/allocators.hpp>
+#include <stddef.h>
 #include <stdlib.h>
+
+#include <bit>
+#include <new>
+
+#if defined(FIZZ_PLATFORM_WINDOWS)
 #include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 
 namespace fizzengine {
+
+// Virtual memory backend ////////////////////////////////////////////////
+// Reserve only claims address space, pages have to be committed before they are touched.
+#if defined(FIZZ_PLATFORM_WINDOWS)
+
+static u8* reserve_pages(sizet size, sizet alignment) {
+    // VirtualAlloc reservations are already 64KB aligned, large pages need a privilege we do not
+    // ask for, so alignment beyond that is ignored here
+    return (u8*)VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_READWRITE);
+}
+
+static bool commit_pages(u8* address, sizet size) {
+    return VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+}
+
+static void decommit_pages(u8* address, sizet size) {
+    VirtualFree(address, size, MEM_DECOMMIT);
+}
+
+static void release_pages(u8* address, sizet size) {
+    VirtualFree(address, 0, MEM_RELEASE);
+}
+
+static void advise_huge_pages(u8* address, sizet size) {
+}
+
+#else
+
+static u8* reserve_pages(sizet size, sizet alignment) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    // Over reserve so the base can be aligned, then hand the slack back
+    const sizet reserve_size = size + alignment;
+    void*       memory       = mmap(nullptr, reserve_size, PROT_NONE, flags, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+
+    u8*       reserved = static_cast<u8*>(memory);
+    u8*       aligned  = (u8*)memory_align((sizet)reserved, alignment);
+    const u64 head     = aligned - reserved;
+    const u64 tail     = reserve_size - head - size;
+    if (head != 0) {
+        munmap(reserved, head);
+    }
+    if (tail != 0) {
+        munmap(aligned + size, tail);
+    }
+    return aligned;
+}
+
+static bool commit_pages(u8* address, sizet size) {
+    return mprotect(address, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+static void decommit_pages(u8* address, sizet size) {
+    // Drop the physical pages first, PROT_NONE makes stray accesses fault like on windows
+    madvise(address, size, MADV_DONTNEED);
+    mprotect(address, size, PROT_NONE);
+}
+
+static void release_pages(u8* address, sizet size) {
+    munmap(address, size);
+}
+
+static void advise_huge_pages(u8* address, sizet size) {
+#ifdef MADV_HUGEPAGE
+    if (madvise(address, size, MADV_HUGEPAGE) != 0) {
+        spdlog::warn("Arena: transparent huge pages unavailable, falling back to 4KB pages");
+    }
+#endif
+}
+
+#endif
+
 sizet memory_align(sizet size, sizet alignment) {
     const sizet alignment_mask = alignment - 1;
     return (size + alignment_mask) & ~alignment_mask;
 }
 
+// TLSF heap ///////////////////////////////////////////////////////////////
+// Follows the layout of Matthew Conte's TLSF 3.1. The prev_physical link of a block overlaps the
+// last word of the previous block and is only valid while that block is free, so a used block
+// costs a single size word of overhead.
+
+static const u32   k_sl_index_count_log2  = 5;
+static const u32   k_align_size_log2      = 3;
+static const sizet k_align_size           = sizet(1) << k_align_size_log2;
+static const u32   k_fl_index_max         = 32;
+static const u32   k_sl_index_count       = 1 << k_sl_index_count_log2;
+static const u32   k_fl_index_shift       = k_sl_index_count_log2 + k_align_size_log2;
+static const u32   k_fl_index_count       = k_fl_index_max - k_fl_index_shift + 1;
+static const sizet k_small_block_size     = sizet(1) << k_fl_index_shift;
+
+static const sizet k_block_free_bit       = 1 << 0;
+static const sizet k_block_prev_free_bit  = 1 << 1;
+
+struct BlockHeader {
+    BlockHeader* prev_physical;
+    sizet        size; // Low two bits hold the free / previous free flags
+    BlockHeader* next_free;
+    BlockHeader* prev_free;
+};
+
+static const sizet k_block_header_overhead = sizeof(sizet);
+static const sizet k_block_start_offset    = offsetof(BlockHeader, size) + sizeof(sizet);
+static const sizet k_block_size_min        = sizeof(BlockHeader) - sizeof(BlockHeader*);
+static const sizet k_block_size_max        = sizet(1) << k_fl_index_max;
+// Growth stops doubling here, well inside what a single free block can describe
+static const sizet k_pool_size_max         = k_block_size_max / 2;
+static const sizet k_pool_overhead         = 2 * k_block_header_overhead;
+
+struct HeapControl {
+    BlockHeader  block_null;
+    u32          fl_bitmap;
+    u32          sl_bitmap[k_fl_index_count];
+    BlockHeader* blocks[k_fl_index_count][k_sl_index_count];
+};
+
+static sizet block_size(const BlockHeader* block) {
+    return block->size & ~(k_block_free_bit | k_block_prev_free_bit);
+}
+
+static void block_set_size(BlockHeader* block, sizet size) {
+    block->size = size | (block->size & (k_block_free_bit | k_block_prev_free_bit));
+}
+
+static bool block_is_free(const BlockHeader* block) {
+    return block->size & k_block_free_bit;
+}
+
+static void block_set_free(BlockHeader* block, bool free) {
+    block->size = free ? block->size | k_block_free_bit : block->size & ~k_block_free_bit;
+}
+
+static bool block_is_prev_free(const BlockHeader* block) {
+    return block->size & k_block_prev_free_bit;
+}
+
+static void block_set_prev_free(BlockHeader* block, bool free) {
+    block->size = free ? block->size | k_block_prev_free_bit : block->size & ~k_block_prev_free_bit;
+}
+
+static BlockHeader* block_from_ptr(const void* ptr) {
+    return (BlockHeader*)((u8*)ptr - k_block_start_offset);
+}
+
+static void* block_to_ptr(const BlockHeader* block) {
+    return (u8*)block + k_block_start_offset;
+}
+
+static BlockHeader* offset_to_block(const void* ptr, i64 offset) {
+    return (BlockHeader*)((u8*)ptr + offset);
+}
+
+static BlockHeader* block_next(const BlockHeader* block) {
+    return offset_to_block(block_to_ptr(block), block_size(block) - k_block_header_overhead);
+}
+
+static BlockHeader* block_link_next(BlockHeader* block) {
+    BlockHeader* next   = block_next(block);
+    next->prev_physical = block;
+    return next;
+}
+
+static void block_mark_as_free(BlockHeader* block) {
+    BlockHeader* next = block_link_next(block);
+    block_set_prev_free(next, true);
+    block_set_free(block, true);
+}
+
+static void block_mark_as_used(BlockHeader* block) {
+    BlockHeader* next = block_next(block);
+    block_set_prev_free(next, false);
+    block_set_free(block, false);
+}
+
+static sizet align_down(sizet x, sizet align) {
+    return x - (x & (align - 1));
+}
+
+static sizet adjust_request_size(sizet size, sizet align) {
+    if (size == 0) {
+        return 0;
+    }
+    const sizet aligned = memory_align(size, align);
+    if (aligned >= k_block_size_max) {
+        return 0;
+    }
+    return aligned < k_block_size_min ? k_block_size_min : aligned;
+}
+
+static u32 find_last_set(sizet value) {
+    return 63 - std::countl_zero((u64)value);
+}
+
+static void mapping_insert(sizet size, u32* fl, u32* sl) {
+    if (size < k_small_block_size) {
+        *fl = 0;
+        *sl = u32(size / (k_small_block_size / k_sl_index_count));
+    } else {
+        const u32 f = find_last_set(size);
+        *sl         = u32(size >> (f - k_sl_index_count_log2)) ^ (1 << k_sl_index_count_log2);
+        *fl         = f - (k_fl_index_shift - 1);
+    }
+}
+
+// Round up to the next bin so any block found there is large enough
+static void mapping_search(sizet size, u32* fl, u32* sl) {
+    if (size >= k_small_block_size) {
+        size += (sizet(1) << (find_last_set(size) - k_sl_index_count_log2)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+static BlockHeader* search_suitable_block(HeapControl* control, u32* fl, u32* sl) {
+    u32 sl_map = control->sl_bitmap[*fl] & (~0U << *sl);
+    if (!sl_map) {
+        const u32 fl_map = (*fl + 1 < 32) ? control->fl_bitmap & (~0U << (*fl + 1)) : 0;
+        if (!fl_map) {
+            return nullptr;
+        }
+        *fl    = std::countr_zero(fl_map);
+        sl_map = control->sl_bitmap[*fl];
+    }
+    *sl = std::countr_zero(sl_map);
+    return control->blocks[*fl][*sl];
+}
+
+static void remove_free_block(HeapControl* control, BlockHeader* block, u32 fl, u32 sl) {
+    BlockHeader* prev = block->prev_free;
+    BlockHeader* next = block->next_free;
+    next->prev_free   = prev;
+    prev->next_free   = next;
+
+    if (control->blocks[fl][sl] == block) {
+        control->blocks[fl][sl] = next;
+        if (next == &control->block_null) {
+            control->sl_bitmap[fl] &= ~(1U << sl);
+            if (!control->sl_bitmap[fl]) {
+                control->fl_bitmap &= ~(1U << fl);
+            }
+        }
+    }
+}
+
+static void insert_free_block(HeapControl* control, BlockHeader* block, u32 fl, u32 sl) {
+    BlockHeader* current    = control->blocks[fl][sl];
+    block->next_free        = current;
+    block->prev_free        = &control->block_null;
+    current->prev_free      = block;
+
+    control->blocks[fl][sl] = block;
+    control->fl_bitmap |= 1U << fl;
+    control->sl_bitmap[fl] |= 1U << sl;
+}
+
+static void block_remove(HeapControl* control, BlockHeader* block) {
+    u32 fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+    remove_free_block(control, block, fl, sl);
+}
+
+static void block_insert(HeapControl* control, BlockHeader* block) {
+    u32 fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+    insert_free_block(control, block, fl, sl);
+}
+
+static bool block_can_split(BlockHeader* block, sizet size) {
+    return block_size(block) >= sizeof(BlockHeader) + size;
+}
+
+static BlockHeader* block_split(BlockHeader* block, sizet size) {
+    BlockHeader* remaining =
+        offset_to_block(block_to_ptr(block), i64(size) - i64(k_block_header_overhead));
+    const sizet remain_size = block_size(block) - (size + k_block_header_overhead);
+
+    block_set_size(remaining, remain_size);
+    block_set_size(block, size);
+    block_mark_as_free(remaining);
+    return remaining;
+}
+
+static BlockHeader* block_absorb(BlockHeader* prev, BlockHeader* block) {
+    prev->size += block_size(block) + k_block_header_overhead;
+    block_link_next(prev);
+    return prev;
+}
+
+static BlockHeader* block_merge_prev(HeapControl* control, BlockHeader* block) {
+    if (block_is_prev_free(block)) {
+        BlockHeader* prev = block->prev_physical;
+        block_remove(control, prev);
+        block = block_absorb(prev, block);
+    }
+    return block;
+}
+
+static BlockHeader* block_merge_next(HeapControl* control, BlockHeader* block) {
+    BlockHeader* next = block_next(block);
+    if (block_is_free(next)) {
+        block_remove(control, next);
+        block = block_absorb(block, next);
+    }
+    return block;
+}
+
+static void block_trim_free(HeapControl* control, BlockHeader* block, sizet size) {
+    if (block_can_split(block, size)) {
+        BlockHeader* remaining = block_split(block, size);
+        block_link_next(block);
+        block_set_prev_free(remaining, true);
+        block_insert(control, remaining);
+    }
+}
+
+static BlockHeader* block_trim_free_leading(HeapControl* control, BlockHeader* block, sizet size) {
+    BlockHeader* remaining = block;
+    if (block_can_split(block, size)) {
+        remaining = block_split(block, size - k_block_header_overhead);
+        block_set_prev_free(remaining, true);
+        block_link_next(block);
+        block_insert(control, block);
+    }
+    return remaining;
+}
+
+static BlockHeader* block_locate_free(HeapControl* control, sizet size) {
+    u32 fl = 0, sl = 0;
+    if (size) {
+        mapping_search(size, &fl, &sl);
+        if (fl < k_fl_index_count) {
+            BlockHeader* block = search_suitable_block(control, &fl, &sl);
+            if (block) {
+                remove_free_block(control, block, fl, sl);
+                return block;
+            }
+        }
+    }
+    return nullptr;
+}
+
+static void* block_prepare_used(HeapControl* control, BlockHeader* block, sizet size) {
+    block_trim_free(control, block, size);
+    block_mark_as_used(block);
+    return block_to_ptr(block);
+}
+
+bool HeapAllocator::init(sizet pool_size_, Arena* backing_arena) {
+    if (control != nullptr)
+        return false; // Already initialized
+
+    arena     = backing_arena;
+    pool_size = pool_size_;
+
+    // The control structure rides at the front of the first pool
+    const sizet control_size = memory_align(sizeof(HeapControl), k_align_size);
+    if (!add_pool(pool_size + control_size)) {
+        return false;
+    }
+    return true;
+}
+
+void HeapAllocator::shutdown() {
+    std::lock_guard lock(mutex);
+    if (allocation_count != 0) {
+        spdlog::warn("Heap allocator has {} unfreed allocations ({} bytes).", allocation_count,
+                     used_bytes);
+    }
+
+    // Arena backed pools go away with the arena
+    if (!arena) {
+        for (u32 i = 0; i < pool_count; ++i) {
+            free(pools[i]);
+        }
+    }
+    control          = nullptr;
+    pool_count       = 0;
+    used_bytes       = 0;
+    allocation_count = 0;
+}
+
+bool HeapAllocator::add_pool(sizet size) {
+    if (pool_count == k_max_pools) {
+        spdlog::error("Heap allocator reached its limit of {} pools", k_max_pools);
+        return false;
+    }
+
+    u8* memory = arena ? (u8*)arena->allocate(size, k_align_size) : (u8*)malloc(size);
+    if (!memory) {
+        return false;
+    }
+    pools[pool_count++] = memory;
+
+    if (!control) {
+        control                       = new (memory) HeapControl();
+        control->block_null.next_free = &control->block_null;
+        control->block_null.prev_free = &control->block_null;
+        control->fl_bitmap            = 0;
+        for (u32 i = 0; i < k_fl_index_count; ++i) {
+            control->sl_bitmap[i] = 0;
+            for (u32 j = 0; j < k_sl_index_count; ++j) {
+                control->blocks[i][j] = &control->block_null;
+            }
+        }
+
+        const sizet control_size = memory_align(sizeof(HeapControl), k_align_size);
+        memory += control_size;
+        size -= control_size;
+    }
+
+    const sizet pool_bytes = align_down(size - k_pool_overhead, k_align_size);
+    if (pool_bytes < k_block_size_min || pool_bytes > k_block_size_max) {
+        spdlog::error("Heap allocator pool size {} is out of range", size);
+        return false;
+    }
+
+    // One big free block covering the pool, followed by a zero sized used sentinel. The first
+    // block starts one word early so its prev_physical link falls outside the pool, it is never
+    // read because the block is flagged as having a used predecessor.
+    BlockHeader* block = offset_to_block(memory, -i64(k_block_header_overhead));
+    block->size        = pool_bytes;
+    block_set_free(block, true);
+    block_set_prev_free(block, false);
+    block_insert(control, block);
+
+    BlockHeader* next = block_link_next(block);
+    next->size        = 0;
+    block_set_free(next, false);
+    block_set_prev_free(next, true);
+    return true;
+}
+
 void* HeapAllocator::allocate(sizet size, sizet alignment) {
-    return malloc(size);
+    std::lock_guard lock(mutex);
+    if (!control && !add_pool(mega(32))) {
+        return nullptr;
+    }
+
+    alignment = alignment < k_align_size ? k_align_size : alignment;
+
+    // Over allocate so an aligned pointer with room for a leading free block fits in the block
+    const sizet adjust       = adjust_request_size(size, k_align_size);
+    const sizet gap_minimum  = sizeof(BlockHeader);
+    const sizet aligned_size = alignment > k_align_size
+                                   ? adjust_request_size(adjust + alignment + gap_minimum, alignment)
+                                   : adjust;
+    if (adjust == 0) {
+        return nullptr;
+    }
+
+    BlockHeader* block = block_locate_free(control, aligned_size);
+    if (!block) {
+        // mapping_search rounds up to the next bin, the new pool has to cover that as well
+        const sizet bin_slack = aligned_size >= k_small_block_size
+                                    ? sizet(1) << (find_last_set(aligned_size) - k_sl_index_count_log2)
+                                    : 0;
+        const sizet grow_size = aligned_size + bin_slack + k_pool_overhead + k_align_size;
+        if (!add_pool(grow_size > pool_size ? grow_size : pool_size)) {
+            spdlog::error("Heap allocator failed to allocate {} bytes", size);
+            return nullptr;
+        }
+        // Geometric growth, so the fixed pool table covers working sets far beyond the first pool
+        pool_size = pool_size * 2 < k_pool_size_max ? pool_size * 2 : k_pool_size_max;
+        block = block_locate_free(control, aligned_size);
+        if (!block) {
+            return nullptr;
+        }
+    }
+
+    u8*   ptr     = (u8*)block_to_ptr(block);
+    u8*   aligned = (u8*)memory_align((sizet)ptr, alignment);
+    sizet gap     = aligned - ptr;
+
+    // A leading gap has to hold a free block header, bump to the next aligned address otherwise
+    if (gap && gap < gap_minimum) {
+        const sizet gap_remain = gap_minimum - gap;
+        const sizet offset     = gap_remain > alignment ? gap_remain : alignment;
+        aligned                = (u8*)memory_align((sizet)(aligned + offset), alignment);
+        gap                    = aligned - ptr;
+    }
+    if (gap) {
+        block = block_trim_free_leading(control, block, gap);
+    }
+
+    void* result = block_prepare_used(control, block, adjust);
+    used_bytes += block_size(block);
+    ++allocation_count;
+    return result;
 }
 
 void HeapAllocator::deallocate(void* pointer) {
-    free(pointer);
+    if (!pointer) {
+        return;
+    }
+
+    std::lock_guard lock(mutex);
+    BlockHeader*    block = block_from_ptr(pointer);
+    used_bytes -= block_size(block);
+    --allocation_count;
+
+    block_mark_as_free(block);
+    block = block_merge_prev(control, block);
+    block = block_merge_next(control, block);
+    block_insert(control, block);
 }
 
-bool Arena::init(size_t size) {
+HeapStatistics HeapAllocator::get_statistics() const {
+    std::lock_guard lock(mutex);
+    HeapStatistics  stats;
+    stats.used_bytes       = used_bytes;
+    stats.allocation_count = allocation_count;
+    stats.pool_count       = pool_count;
+
+    if (!control) {
+        return stats;
+    }
+
+    // Walk the free lists, this is meant for debug panels rather than hot code
+    for (u32 fl = 0; fl < k_fl_index_count; ++fl) {
+        for (u32 sl = 0; sl < k_sl_index_count; ++sl) {
+            for (BlockHeader* block = control->blocks[fl][sl]; block != &control->block_null;
+                 block              = block->next_free) {
+                const sizet size = block_size(block);
+                stats.free_bytes += size;
+                if (size > stats.largest_free_block) {
+                    stats.largest_free_block = size;
+                }
+            }
+        }
+    }
+
+    stats.total_bytes   = stats.used_bytes + stats.free_bytes;
+    stats.fragmentation = stats.free_bytes
+                              ? 1.0f - f32(stats.largest_free_block) / f32(stats.free_bytes)
+                              : 0.0f;
+    return stats;
+}
+
+bool Arena::init(size_t size, bool use_huge_pages) {
     if (base != nullptr)
         return false; // Already initialized
 
-    base = (u8*)VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_READWRITE);
+    commit_size = use_huge_pages ? HUGE_PAGE_SIZE : PAGE_SIZE;
+    size        = memory_align(size, commit_size);
+
+    base        = reserve_pages(size, commit_size);
     if (!base) {
         return false;
     }
 
+    if (use_huge_pages) {
+        advise_huge_pages(base, size);
+    }
+
     allocated_size = 0;
     committed_size = 0;
     total_size     = size;
@@ -35,7 +580,7 @@ void Arena::shutdown() {
     if (base == nullptr)
         return; // Not initialized
 
-    VirtualFree(base, 0, MEM_RELEASE);
+    release_pages(base, total_size);
 
     base           = nullptr;
     allocated_size = 0;
@@ -55,10 +600,10 @@ void* Arena::allocate(size_t size, size_t alignment) {
     if (new_allocated_size > committed_size) {
 
         sizet bytes_needed    = new_allocated_size - committed_size;
-        sizet pages_needed    = (bytes_needed + PAGE_SIZE - 1) / PAGE_SIZE;
-        sizet bytes_to_commit = pages_needed * PAGE_SIZE;
+        sizet pages_needed    = (bytes_needed + commit_size - 1) / commit_size;
+        sizet bytes_to_commit = pages_needed * commit_size;
 
-        if (!VirtualAlloc(base + committed_size, bytes_to_commit, MEM_COMMIT, PAGE_READWRITE)) {
+        if (!commit_pages(base + committed_size, bytes_to_commit)) {
             return nullptr;
         }
         committed_size += bytes_to_commit;
@@ -72,4 +617,130 @@ void Arena::deallocate(void* pointer) {
     // No-op for arena allocator
 }
 
-} // namespace fizzengine
\ No newline at end of file
+void Arena::reset() {
+    allocated_size = 0;
+}
+
+void Arena::reset_to(sizet marker) {
+    if (marker <= allocated_size) {
+        allocated_size = marker;
+    }
+}
+
+void Arena::decommit_unused() {
+    if (base == nullptr)
+        return;
+
+    const sizet keep_size = memory_align(allocated_size, commit_size);
+    if (keep_size < committed_size) {
+        decommit_pages(base + keep_size, committed_size - keep_size);
+        committed_size = keep_size;
+    }
+}
+
+void ArenaFixed::init(void* memory_, sizet size) {
+    memory         = static_cast<u8*>(memory_);
+    backing        = nullptr;
+    allocated_size = 0;
+    total_size     = size;
+}
+
+bool ArenaFixed::init(Allocator* backing_, sizet size) {
+    memory = static_cast<u8*>(backing_->allocate(size, k_default_alignment));
+    if (!memory) {
+        return false;
+    }
+
+    backing        = backing_;
+    allocated_size = 0;
+    total_size     = size;
+    return true;
+}
+
+void ArenaFixed::shutdown() {
+    if (backing) {
+        backing->deallocate(memory);
+    }
+
+    memory         = nullptr;
+    backing        = nullptr;
+    allocated_size = 0;
+    total_size     = 0;
+}
+
+void* ArenaFixed::allocate(sizet size, sizet alignment) {
+    // Align the address rather than the offset, the block itself may be less aligned
+    const sizet new_start =
+        memory_align((sizet)memory + allocated_size, alignment) - (sizet)memory;
+    const sizet new_allocated_size = new_start + size;
+    if (new_allocated_size > total_size) {
+        spdlog::error("ArenaFixed out of memory, requested {} bytes with {} of {} used", size,
+                      allocated_size, total_size);
+        return nullptr;
+    }
+
+    allocated_size = new_allocated_size;
+    return memory + new_start;
+}
+
+void ArenaFixed::deallocate(void* pointer) {
+    // No-op, memory is given back with free_to_marker or clear
+}
+
+void ArenaFixed::free_to_marker(sizet marker) {
+    if (marker <= allocated_size) {
+        allocated_size = marker;
+    }
+}
+
+void ArenaFixed::clear() {
+    allocated_size = 0;
+}
+
+bool FrameAllocator::init(Allocator* backing_, sizet frame_size, u32 frame_count_) {
+    if (frame_count_ == 0 || frame_count_ > k_max_frames) {
+        return false;
+    }
+
+    frame_size = memory_align(frame_size, k_default_alignment);
+    memory     = static_cast<u8*>(backing_->allocate(frame_size * frame_count_, k_default_alignment));
+    if (!memory) {
+        return false;
+    }
+
+    backing       = backing_;
+    frame_count   = frame_count_;
+    current_frame = 0;
+    for (u32 i = 0; i < frame_count; ++i) {
+        regions[i].init(memory + i * frame_size, frame_size);
+    }
+    return true;
+}
+
+void FrameAllocator::shutdown() {
+    if (backing) {
+        backing->deallocate(memory);
+    }
+
+    for (u32 i = 0; i < frame_count; ++i) {
+        regions[i].shutdown();
+    }
+    memory      = nullptr;
+    backing     = nullptr;
+    frame_count = 0;
+}
+
+void FrameAllocator::begin_frame(u32 frame_index) {
+    current_frame = frame_index % frame_count;
+    regions[current_frame].clear();
+}
+
+void* FrameAllocator::allocate(sizet size, sizet alignment) {
+    return regions[current_frame].allocate(size, alignment);
+}
+
+void FrameAllocator::deallocate(void* pointer) {
+    // No-op, the whole region is rewound in begin_frame
+}
+
+} // namespace fizzengine
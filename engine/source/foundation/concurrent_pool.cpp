@@ -0,0 +1,187 @@
+#include <foundation/concurrent_pool.hpp>
+#include <spdlog/spdlog.h>
+#include <string.h>
+
+namespace fizzengine {
+
+static u64 make_free_head(u64 tag, u32 index) {
+    return (tag << 32) | index;
+}
+
+void ConcurrentResourcePool::init(const ResourcePoolCreation& creation) {
+    allocator     = creation.allocator;
+    pool_size     = creation.pool_size;
+    resource_size = (u32)memory_align(creation.resource_size, creation.resource_alignment);
+
+    // Same layout as ResourcePool: cache line aligned slots followed by the bookkeeping arrays
+    const sizet slots_size        = memory_align((sizet)pool_size * resource_size, k_cache_line_size);
+    const sizet array_size        = pool_size * sizeof(std::atomic<u32>);
+    const sizet bytes_to_allocate = slots_size + array_size * 2;
+    const sizet alignment         = creation.resource_alignment > k_cache_line_size
+                                        ? creation.resource_alignment
+                                        : k_cache_line_size;
+
+    pool_memory = static_cast<u8*>(allocator->allocate(bytes_to_allocate, alignment));
+    memset(pool_memory, 0, slots_size);
+
+    generations = reinterpret_cast<std::atomic<u32>*>(pool_memory + slots_size);
+    next_free   = generations + pool_size;
+
+    for (u32 i = 0; i < pool_size; ++i) {
+        new (&generations[i]) std::atomic<u32>(0);
+        new (&next_free[i]) std::atomic<u32>(i + 1 < pool_size ? i + 1 : k_invalid_index);
+    }
+
+    free_head.store(make_free_head(0, pool_size ? 0 : k_invalid_index), std::memory_order_release);
+    used_resources.store(0, std::memory_order_release);
+}
+
+void ConcurrentResourcePool::shutdown() {
+    const u32 used = used_resources.load(std::memory_order_acquire);
+    if (used != 0) {
+        spdlog::warn("Concurrent resource pool has {} unfreed resources.", used);
+    }
+
+    allocator->deallocate(pool_memory);
+}
+
+u32 ConcurrentResourcePool::pop_free(u32* indices, u32 max_count) {
+    u64 head = free_head.load(std::memory_order_acquire);
+    for (;;) {
+        u32 index = (u32)head;
+        if (index == k_invalid_index) {
+            return 0;
+        }
+
+        // Walk the chain we want to detach. Another thread may be popping the same nodes and
+        // rewriting their links, in which case the tag moved on and the CAS below fails.
+        u32 count = 0;
+        while (count < max_count && index < pool_size) {
+            indices[count++] = index;
+            index            = next_free[index].load(std::memory_order_relaxed);
+        }
+        if (index != k_invalid_index && index >= pool_size) {
+            head = free_head.load(std::memory_order_acquire);
+            continue;
+        }
+
+        const u64 new_head = make_free_head((head >> 32) + 1, index);
+        if (free_head.compare_exchange_weak(head, new_head, std::memory_order_acq_rel,
+                                            std::memory_order_acquire)) {
+            return count;
+        }
+    }
+}
+
+void ConcurrentResourcePool::push_free(const u32* indices, u32 count) {
+    if (count == 0) {
+        return;
+    }
+
+    // Link the batch up front, it is private to this thread until the CAS publishes it
+    for (u32 i = 0; i + 1 < count; ++i) {
+        next_free[indices[i]].store(indices[i + 1], std::memory_order_relaxed);
+    }
+
+    const u32 last = indices[count - 1];
+    u64       head = free_head.load(std::memory_order_relaxed);
+    u64       new_head;
+    do {
+        next_free[last].store((u32)head, std::memory_order_relaxed);
+        new_head = make_free_head((head >> 32) + 1, indices[0]);
+    } while (!free_head.compare_exchange_weak(head, new_head, std::memory_order_release,
+                                              std::memory_order_relaxed));
+}
+
+bool ConcurrentResourcePool::mark_released(ResourceHandle handle) {
+    u32 expected = handle.generation;
+    if (handle.index >= pool_size || (handle.generation & 1) == 0 ||
+        !generations[handle.index].compare_exchange_strong(expected, expected + 1,
+                                                           std::memory_order_acq_rel)) {
+        spdlog::warn("Releasing stale resource handle {} (generation {}).", handle.index,
+                     handle.generation);
+        return false;
+    }
+    return true;
+}
+
+ResourceHandle ConcurrentResourcePool::obtain_resource() {
+    u32 index;
+    if (pop_free(&index, 1) == 0) {
+        return k_invalid_handle;
+    }
+
+    used_resources.fetch_add(1, std::memory_order_relaxed);
+    const u32 generation = generations[index].fetch_add(1, std::memory_order_acq_rel) + 1;
+    return {.index = index, .generation = generation};
+}
+
+ResourceHandle ConcurrentResourcePool::obtain_resource(ConcurrentPoolCache& cache) {
+    if (cache.count == 0) {
+        cache.count = pop_free(cache.indices, ConcurrentPoolCache::k_capacity / 2);
+        if (cache.count == 0) {
+            return k_invalid_handle;
+        }
+    }
+
+    const u32 index = cache.indices[--cache.count];
+    used_resources.fetch_add(1, std::memory_order_relaxed);
+    const u32 generation = generations[index].fetch_add(1, std::memory_order_acq_rel) + 1;
+    return {.index = index, .generation = generation};
+}
+
+void ConcurrentResourcePool::release_resource(ResourceHandle handle) {
+    if (mark_released(handle)) {
+        free_slot(handle.index);
+    }
+}
+
+void ConcurrentResourcePool::release_resource(ConcurrentPoolCache& cache, ResourceHandle handle) {
+    if (mark_released(handle)) {
+        free_slot(cache, handle.index);
+    }
+}
+
+void ConcurrentResourcePool::free_slot(u32 index) {
+    used_resources.fetch_sub(1, std::memory_order_relaxed);
+    push_free(&index, 1);
+}
+
+void ConcurrentResourcePool::free_slot(ConcurrentPoolCache& cache, u32 index) {
+    used_resources.fetch_sub(1, std::memory_order_relaxed);
+
+    // Spill the older half so the cache keeps some slots for the next obtains
+    if (cache.count == ConcurrentPoolCache::k_capacity) {
+        const u32 half = ConcurrentPoolCache::k_capacity / 2;
+        push_free(cache.indices, half);
+        memmove(cache.indices, cache.indices + half, half * sizeof(u32));
+        cache.count = half;
+    }
+    cache.indices[cache.count++] = index;
+}
+
+void ConcurrentResourcePool::flush_cache(ConcurrentPoolCache& cache) {
+    push_free(cache.indices, cache.count);
+    cache.count = 0;
+}
+
+bool ConcurrentResourcePool::is_valid(ResourceHandle handle) const {
+    return handle.index < pool_size && (handle.generation & 1) != 0 &&
+           generations[handle.index].load(std::memory_order_acquire) == handle.generation;
+}
+
+void* ConcurrentResourcePool::access_resource(ResourceHandle handle) {
+    if (is_valid(handle)) {
+        return &pool_memory[handle.index * resource_size];
+    }
+    return nullptr;
+}
+
+const void* ConcurrentResourcePool::access_resource(ResourceHandle handle) const {
+    if (is_valid(handle)) {
+        return &pool_memory[handle.index * resource_size];
+    }
+    return nullptr;
+}
+
+} // namespace fizzengine
@@ -0,0 +1,155 @@
+#include <foundation/file.hpp>
+
+#include <stdio.h>
+
+#if defined(FIZZ_PLATFORM_WINDOWS)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <filesystem>
+#include <string>
+
+namespace fizzengine {
+
+bool read_file(cstring path, std::vector<u8>& out_data) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(file);
+        return false;
+    }
+
+    out_data.resize((sizet)size);
+    const sizet read = fread(out_data.data(), 1, (sizet)size, file);
+    fclose(file);
+    return read == (sizet)size;
+}
+
+bool write_file_atomic(cstring path, const void* data, sizet size) {
+    const std::string temp_path = std::string(path) + ".tmp";
+
+    FILE*             file      = fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        spdlog::error("Failed to open {} for writing", temp_path);
+        return false;
+    }
+
+    const sizet written = fwrite(data, 1, size, file);
+    const bool  flushed = fflush(file) == 0;
+    fclose(file);
+    if (written != size || !flushed) {
+        spdlog::error("Failed to write {}", temp_path);
+        std::filesystem::remove(temp_path);
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        spdlog::error("Failed to move {} into place: {}", temp_path, error.message());
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
+
+#if defined(FIZZ_PLATFORM_WINDOWS)
+
+bool MappedFile::open(cstring path) {
+    close();
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return false;
+    }
+    if (file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return true; // Nothing to map
+    }
+
+    // The mapping keeps the file open, the handle itself is not needed anymore
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        return false;
+    }
+    data = (const u8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+        return false;
+    }
+    size = (sizet)file_size.QuadPart;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data) {
+        UnmapViewOfFile(data);
+        CloseHandle(mapping);
+    }
+    data    = nullptr;
+    mapping = nullptr;
+    size    = 0;
+}
+
+#else
+
+bool MappedFile::open(cstring path) {
+    close();
+    const int file = ::open(path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0) {
+        ::close(file);
+        return false;
+    }
+    if (status.st_size == 0) {
+        ::close(file);
+        return true; // mmap rejects empty ranges
+    }
+
+    // The mapping holds its own reference to the file
+    void* memory = mmap(nullptr, (sizet)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+    madvise(memory, (sizet)status.st_size, MADV_WILLNEED);
+
+    data = (const u8*)memory;
+    size = (sizet)status.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data) {
+        munmap((void*)data, size);
+    }
+    data = nullptr;
+    size = 0;
+}
+
+#endif
+
+} // namespace fizzengine
@@ -0,0 +1,26 @@
+#include <foundation/hash.hpp>
+
+namespace fizzengine {
+
+static const u64 k_fnv_prime = 0x100000001b3ull;
+
+u64 hash_bytes(const void* data, sizet size, u64 seed) {
+    const u8* bytes = static_cast<const u8*>(data);
+    u64       hash  = seed;
+    for (sizet i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= k_fnv_prime;
+    }
+    return hash;
+}
+
+u64 hash_string(cstring string, u64 seed) {
+    u64 hash = seed;
+    for (; *string; ++string) {
+        hash ^= (u8)*string;
+        hash *= k_fnv_prime;
+    }
+    return hash;
+}
+
+} // namespace fizzengine
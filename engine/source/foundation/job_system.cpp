@@ -0,0 +1,242 @@
+#include <foundation/job_system.hpp>
+#include <foundation/profiler.hpp>
+
+namespace fizzengine {
+
+static thread_local u32 t_worker_index = JobSystem::k_invalid_worker;
+
+// Spin this many failed lookups before a worker goes to sleep
+static const u32        k_spin_count   = 64;
+
+// WorkStealingQueue ///////////////////////////////////////////////////////
+
+void WorkStealingQueue::store(i64 index, const Job& job) {
+    Slot& slot = slots[index & (k_capacity - 1)];
+    slot.function.store(job.function, std::memory_order_relaxed);
+    slot.data.store(job.data, std::memory_order_relaxed);
+    slot.counter.store(job.counter, std::memory_order_relaxed);
+}
+
+Job WorkStealingQueue::load(i64 index) const {
+    const Slot& slot = slots[index & (k_capacity - 1)];
+    return {.function = slot.function.load(std::memory_order_relaxed),
+            .data     = slot.data.load(std::memory_order_relaxed),
+            .counter  = slot.counter.load(std::memory_order_relaxed)};
+}
+
+bool WorkStealingQueue::push(const Job& job) {
+    const i64 b = bottom.load(std::memory_order_relaxed);
+    const i64 t = top.load(std::memory_order_acquire);
+    if (b - t >= k_capacity) {
+        return false;
+    }
+
+    store(b, job);
+    bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+bool WorkStealingQueue::pop(Job& job) {
+    const i64 b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // Empty, restore bottom
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    job = load(b);
+    if (t == b) {
+        // Last job, race the thieves for it
+        const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                     std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+bool WorkStealingQueue::steal(Job& job) {
+    i64 t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const i64 b = bottom.load(std::memory_order_acquire);
+
+    if (t >= b) {
+        return false;
+    }
+
+    job = load(t);
+    return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed);
+}
+
+// JobSystem ///////////////////////////////////////////////////////////////
+
+void JobSystem::init(u32 worker_count_) {
+    if (worker_count_ == 0) {
+        worker_count_ = std::thread::hardware_concurrency();
+    }
+    worker_count = worker_count_ ? worker_count_ : 1;
+
+    queues       = std::make_unique<WorkStealingQueue[]>(worker_count);
+    running.store(true, std::memory_order_release);
+
+    t_worker_index = 0;
+    for (u32 i = 1; i < worker_count; ++i) {
+        threads.emplace_back([this, i]() { worker_loop(i); });
+    }
+
+    spdlog::info("Job system started with {} workers", worker_count);
+}
+
+void JobSystem::shutdown() {
+    {
+        std::lock_guard lock(sleep_mutex);
+        running.store(false, std::memory_order_release);
+    }
+    sleep_condition.notify_all();
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    queues.reset();
+    t_worker_index = k_invalid_worker;
+}
+
+u32 JobSystem::get_current_worker_index() {
+    return t_worker_index;
+}
+
+void JobSystem::run(const Job& job) {
+    run(&job, 1);
+}
+
+void JobSystem::run(const Job* jobs, u32 count) {
+    const u32 worker_index = t_worker_index;
+
+    for (u32 i = 0; i < count; ++i) {
+        if (jobs[i].counter) {
+            jobs[i].counter->value.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    // seq_cst pairs with the worker going to sleep, see wake_workers
+    pending_jobs.fetch_add((i32)count, std::memory_order_seq_cst);
+
+    if (worker_index == k_invalid_worker) {
+        std::lock_guard lock(external_mutex);
+        external_jobs.insert(external_jobs.end(), jobs, jobs + count);
+    } else {
+        for (u32 i = 0; i < count; ++i) {
+            // A full deque means plenty of work is queued already, run this one inline
+            if (!queues[worker_index].push(jobs[i])) {
+                pending_jobs.fetch_sub(1, std::memory_order_relaxed);
+                execute(jobs[i]);
+            }
+        }
+    }
+
+    wake_workers(count);
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    const u32 worker_index = t_worker_index;
+    while (!counter.is_done()) {
+        if (worker_index == k_invalid_worker || !try_execute(worker_index)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::wake_workers(u32 count) {
+    // Store then load here, and the mirror image in a worker about to sleep. With all four seq_cst
+    // at least one side sees the other: either this sees the sleeper, or the sleeper sees the jobs.
+    if (sleeping_workers.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+
+    // Taking the lock orders this wake up after a worker's last check of pending_jobs
+    { std::lock_guard lock(sleep_mutex); }
+    if (count == 1) {
+        sleep_condition.notify_one();
+    } else {
+        sleep_condition.notify_all();
+    }
+}
+
+bool JobSystem::find_job(u32 worker_index, Job& job) {
+    if (queues[worker_index].pop(job)) {
+        return true;
+    }
+
+    {
+        std::lock_guard lock(external_mutex);
+        if (!external_jobs.empty()) {
+            job = external_jobs.front();
+            external_jobs.pop_front();
+            return true;
+        }
+    }
+
+    // Start stealing from the next worker so thieves spread over the victims
+    for (u32 i = 1; i < worker_count; ++i) {
+        const u32 victim = (worker_index + i) % worker_count;
+        if (queues[victim].steal(job)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(const Job& job) {
+    job.function(job.data);
+    if (job.counter) {
+        job.counter->value.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+bool JobSystem::try_execute(u32 worker_index) {
+    Job job;
+    if (!find_job(worker_index, job)) {
+        return false;
+    }
+    // Only queued jobs count, so idle workers keep sleeping while long jobs run
+    pending_jobs.fetch_sub(1, std::memory_order_relaxed);
+    execute(job);
+    return true;
+}
+
+void JobSystem::worker_loop(u32 worker_index) {
+    t_worker_index = worker_index;
+
+    char thread_name[32];
+    snprintf(thread_name, sizeof(thread_name), "Worker %u", worker_index);
+    FIZZ_PROFILE_THREAD(thread_name);
+
+    u32 idle_spins = 0;
+    while (running.load(std::memory_order_acquire)) {
+        if (try_execute(worker_index)) {
+            idle_spins = 0;
+            continue;
+        }
+
+        if (++idle_spins < k_spin_count) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock lock(sleep_mutex);
+        sleeping_workers.fetch_add(1, std::memory_order_seq_cst);
+        sleep_condition.wait(lock, [this]() {
+            return pending_jobs.load(std::memory_order_seq_cst) > 0 ||
+                   !running.load(std::memory_order_acquire);
+        });
+        sleeping_workers.fetch_sub(1, std::memory_order_acq_rel);
+        idle_spins = 0;
+    }
+}
+
+} // namespace fizzengine
@@ -0,0 +1,381 @@
+#include <foundation/json.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace fizzengine {
+
+const JsonValue* JsonValue::find(std::string_view key) const {
+    if (type != k_json_object) {
+        return nullptr;
+    }
+    for (u32 i = 0; i < count; ++i) {
+        if (keys[i] == key) {
+            return &children[i];
+        }
+    }
+    return nullptr;
+}
+
+bool JsonValue::is_integer(f64 max_value) const {
+    // Written so NaN fails every comparison
+    return type == k_json_number && number >= 0.0 && number <= max_value &&
+           std::floor(number) == number;
+}
+
+f64 JsonValue::get_number(std::string_view key, f64 default_value) const {
+    const JsonValue* value = find(key);
+    return value && value->type == k_json_number ? value->number : default_value;
+}
+
+u32 JsonValue::get_u32(std::string_view key, u32 default_value) const {
+    const JsonValue* value = find(key);
+    if (!value || !value->is_integer((f64)u32_max)) {
+        return default_value;
+    }
+    return (u32)value->number;
+}
+
+bool JsonValue::get_bool(std::string_view key, bool default_value) const {
+    const JsonValue* value = find(key);
+    return value && value->type == k_json_bool ? value->boolean : default_value;
+}
+
+std::string_view JsonValue::get_string(std::string_view key,
+                                       std::string_view default_value) const {
+    const JsonValue* value = find(key);
+    return value && value->type == k_json_string ? value->string : default_value;
+}
+
+// Recursive descent. Children are gathered on a shared scratch stack and copied into the
+// allocator once their container closes, so every array and object is one allocation.
+struct JsonParser {
+    static constexpr u32          k_max_depth = 256;
+
+    const char*                   text;
+    const char*                   end;
+    const char*                   cursor;
+    Allocator*                    allocator;
+    u32                           depth = 0;
+
+    std::vector<JsonValue>        value_stack;
+    std::vector<std::string_view> key_stack;
+
+    bool                          fail(cstring message) {
+        spdlog::error("JSON: {} at offset {}", message, cursor - text);
+        return false;
+    }
+
+    template <typename T>
+    T* allocate_array(sizet count) {
+        T* array = (T*)allocator->allocate(count * sizeof(T), alignof(T));
+        if (!array) {
+            fail("Out of memory");
+        }
+        return array;
+    }
+
+    void skip_whitespace() {
+        while (cursor < end &&
+               (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) {
+            ++cursor;
+        }
+    }
+
+    bool match(cstring literal) {
+        const sizet length = strlen(literal);
+        if ((sizet)(end - cursor) < length || memcmp(cursor, literal, length) != 0) {
+            return false;
+        }
+        cursor += length;
+        return true;
+    }
+
+    bool parse_value(JsonValue& out_value);
+    bool parse_string(std::string_view& out_string);
+    bool parse_number(JsonValue& out_value);
+    bool parse_array(JsonValue& out_value);
+    bool parse_object(JsonValue& out_value);
+};
+
+static bool parse_hex4(const char* text, u32& out_code) {
+    out_code = 0;
+    for (u32 i = 0; i < 4; ++i) {
+        const char c = text[i];
+        out_code <<= 4;
+        if (c >= '0' && c <= '9') {
+            out_code |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            out_code |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            out_code |= c - 'A' + 10;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static char* write_utf8(char* out, u32 code) {
+    if (code < 0x80) {
+        *out++ = (char)code;
+    } else if (code < 0x800) {
+        *out++ = (char)(0xc0 | (code >> 6));
+        *out++ = (char)(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        *out++ = (char)(0xe0 | (code >> 12));
+        *out++ = (char)(0x80 | ((code >> 6) & 0x3f));
+        *out++ = (char)(0x80 | (code & 0x3f));
+    } else {
+        *out++ = (char)(0xf0 | (code >> 18));
+        *out++ = (char)(0x80 | ((code >> 12) & 0x3f));
+        *out++ = (char)(0x80 | ((code >> 6) & 0x3f));
+        *out++ = (char)(0x80 | (code & 0x3f));
+    }
+    return out;
+}
+
+bool JsonParser::parse_string(std::string_view& out_string) {
+    ++cursor; // Opening quote
+    const char* begin   = cursor;
+    bool        escaped = false;
+    while (cursor < end && *cursor != '"') {
+        if (*cursor == '\\') {
+            escaped = true;
+            ++cursor;
+        } else if ((u8)*cursor < 0x20) {
+            return fail("Control character in string");
+        }
+        ++cursor;
+    }
+    if (cursor >= end) {
+        return fail("Unterminated string");
+    }
+    const char* string_end = cursor++;
+
+    if (!escaped) {
+        out_string = std::string_view(begin, string_end - begin);
+        return true;
+    }
+
+    // Unescaping never makes a string longer, \u escapes included
+    char* out = allocate_array<char>(string_end - begin);
+    if (!out) {
+        return false;
+    }
+    char* write = out;
+    for (const char* read = begin; read < string_end; ++read) {
+        if (*read != '\\') {
+            *write++ = *read;
+            continue;
+        }
+        switch (*++read) {
+        case '"':
+        case '\\':
+        case '/':
+            *write++ = *read;
+            break;
+        case 'b':
+            *write++ = '\b';
+            break;
+        case 'f':
+            *write++ = '\f';
+            break;
+        case 'n':
+            *write++ = '\n';
+            break;
+        case 'r':
+            *write++ = '\r';
+            break;
+        case 't':
+            *write++ = '\t';
+            break;
+        case 'u': {
+            u32 code = 0;
+            if (string_end - read < 5 || !parse_hex4(read + 1, code)) {
+                return fail("Invalid \\u escape");
+            }
+            read += 4;
+            // Surrogate pairs encode code points past the basic plane
+            u32 low = 0;
+            if (code >= 0xd800 && code < 0xdc00 && string_end - read >= 7 && read[1] == '\\' &&
+                read[2] == 'u' && parse_hex4(read + 3, low) && low >= 0xdc00 && low < 0xe000) {
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                read += 6;
+            }
+            write = write_utf8(write, code);
+            break;
+        }
+        default:
+            return fail("Invalid escape");
+        }
+    }
+    out_string = std::string_view(out, write - out);
+    return true;
+}
+
+bool JsonParser::parse_number(JsonValue& out_value) {
+    // from_chars is a little laxer than JSON, it also takes leading zeros, inf and nan
+    const std::from_chars_result result = std::from_chars(cursor, end, out_value.number);
+    if (result.ec != std::errc()) {
+        return fail("Invalid number");
+    }
+    out_value.type = k_json_number;
+    cursor         = result.ptr;
+    return true;
+}
+
+bool JsonParser::parse_array(JsonValue& out_value) {
+    ++cursor; // [
+    const sizet first = value_stack.size();
+
+    skip_whitespace();
+    if (cursor < end && *cursor == ']') {
+        ++cursor;
+    } else {
+        while (true) {
+            JsonValue element;
+            if (!parse_value(element)) {
+                return false;
+            }
+            value_stack.push_back(element);
+
+            skip_whitespace();
+            if (cursor < end && *cursor == ',') {
+                ++cursor;
+            } else if (cursor < end && *cursor == ']') {
+                ++cursor;
+                break;
+            } else {
+                return fail("Expected ',' or ']'");
+            }
+        }
+    }
+
+    out_value.type  = k_json_array;
+    out_value.count = (u32)(value_stack.size() - first);
+    if (out_value.count != 0) {
+        out_value.children = allocate_array<JsonValue>(out_value.count);
+        if (!out_value.children) {
+            return false;
+        }
+        std::copy(value_stack.begin() + first, value_stack.end(), out_value.children);
+    }
+    value_stack.resize(first);
+    return true;
+}
+
+bool JsonParser::parse_object(JsonValue& out_value) {
+    ++cursor; // {
+    const sizet first = value_stack.size();
+
+    skip_whitespace();
+    if (cursor < end && *cursor == '}') {
+        ++cursor;
+    } else {
+        while (true) {
+            skip_whitespace();
+            std::string_view key;
+            if (cursor >= end || *cursor != '"') {
+                return fail("Expected a key");
+            }
+            if (!parse_string(key)) {
+                return false;
+            }
+            skip_whitespace();
+            if (cursor >= end || *cursor != ':') {
+                return fail("Expected ':'");
+            }
+            ++cursor;
+
+            JsonValue member;
+            if (!parse_value(member)) {
+                return false;
+            }
+            value_stack.push_back(member);
+            key_stack.push_back(key);
+
+            skip_whitespace();
+            if (cursor < end && *cursor == ',') {
+                ++cursor;
+            } else if (cursor < end && *cursor == '}') {
+                ++cursor;
+                break;
+            } else {
+                return fail("Expected ',' or '}'");
+            }
+        }
+    }
+
+    // Keys are only pushed by objects, so both stacks hold this object's members at the top
+    out_value.type        = k_json_object;
+    out_value.count       = (u32)(value_stack.size() - first);
+    const sizet first_key = key_stack.size() - out_value.count;
+    if (out_value.count != 0) {
+        out_value.children = allocate_array<JsonValue>(out_value.count);
+        out_value.keys     = allocate_array<std::string_view>(out_value.count);
+        if (!out_value.children || !out_value.keys) {
+            return false;
+        }
+        std::copy(value_stack.begin() + first, value_stack.end(), out_value.children);
+        std::copy(key_stack.begin() + first_key, key_stack.end(), out_value.keys);
+    }
+    value_stack.resize(first);
+    key_stack.resize(first_key);
+    return true;
+}
+
+bool JsonParser::parse_value(JsonValue& out_value) {
+    skip_whitespace();
+    if (cursor >= end) {
+        return fail("Unexpected end of input");
+    }
+
+    switch (*cursor) {
+    case '{':
+    case '[': {
+        if (++depth > k_max_depth) {
+            return fail("Nesting too deep");
+        }
+        const bool parsed = *cursor == '{' ? parse_object(out_value) : parse_array(out_value);
+        --depth;
+        return parsed;
+    }
+    case '"':
+        out_value.type = k_json_string;
+        return parse_string(out_value.string);
+    case 't':
+    case 'f':
+        out_value.type    = k_json_bool;
+        out_value.boolean = *cursor == 't';
+        return match(out_value.boolean ? "true" : "false") || fail("Invalid literal");
+    case 'n':
+        out_value.type = k_json_null;
+        return match("null") || fail("Invalid literal");
+    default:
+        return parse_number(out_value);
+    }
+}
+
+bool json_parse(const char* text, sizet length, Allocator* allocator, JsonValue& out_root) {
+    JsonParser parser;
+    parser.text      = text;
+    parser.end       = text + length;
+    parser.cursor    = text;
+    parser.allocator = allocator;
+
+    out_root         = JsonValue{};
+    if (!parser.parse_value(out_root)) {
+        return false;
+    }
+    parser.skip_whitespace();
+    if (parser.cursor != parser.end) {
+        return parser.fail("Trailing characters");
+    }
+    return true;
+}
+
+} // namespace fizzengine
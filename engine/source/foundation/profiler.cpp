@@ -0,0 +1,157 @@
+#include <foundation/profiler.hpp>
+
+#include <foundation/file.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fizzengine {
+
+// 16K events of 24 bytes per thread, enough for a few hundred frames of coarse zones
+static const u32 k_events_per_thread = 16384;
+
+struct ThreadEvents {
+    ProfileEvent     events[k_events_per_thread];
+    // Only the owning thread writes, the exporter reads up to the published count
+    std::atomic<u64> write_count{0};
+    u32              thread_id = 0;
+    char             name[32]  = {};
+};
+
+static std::mutex                                 s_threads_mutex;
+static std::vector<std::unique_ptr<ThreadEvents>> s_threads;
+static thread_local ThreadEvents*                 t_events = nullptr;
+
+static std::atomic<bool>                          s_capturing{false};
+static std::atomic<u32>                           s_frames_requested{0};
+static u32                                        s_frames_left   = 0;
+static u64                                        s_capture_begin = 0;
+static u64                                        s_frame_begin   = 0;
+static std::string                                s_capture_path;
+
+// Timestamp and steady clock at init, the second sample is taken at export
+static u64                                        s_base_timestamp = 0;
+static std::chrono::steady_clock::time_point      s_base_time;
+
+static ThreadEvents*                              get_thread_events() {
+    if (!t_events) {
+        std::lock_guard lock(s_threads_mutex);
+        s_threads.push_back(std::make_unique<ThreadEvents>());
+        t_events            = s_threads.back().get();
+        t_events->thread_id = (u32)s_threads.size();
+        snprintf(t_events->name, sizeof(t_events->name), "Thread %u", t_events->thread_id);
+    }
+    return t_events;
+}
+
+void profiler_init() {
+    s_base_timestamp = profiler_timestamp();
+    s_base_time      = std::chrono::steady_clock::now();
+    profiler_set_thread_name("Main");
+}
+
+void profiler_shutdown() {
+    s_capturing.store(false, std::memory_order_release);
+    // Buffers stay alive, threads that outlive shutdown may still hold on to theirs
+}
+
+void profiler_set_thread_name(cstring name) {
+    ThreadEvents*   events = get_thread_events();
+    // The exporter reads names under the same lock
+    std::lock_guard lock(s_threads_mutex);
+    snprintf(events->name, sizeof(events->name), "%s", name);
+}
+
+void profiler_begin_capture(u32 frame_count, cstring path) {
+    if (s_capturing.load(std::memory_order_acquire)) {
+        return;
+    }
+    s_capture_path = path;
+    s_frames_requested.store(frame_count, std::memory_order_release);
+}
+
+bool profiler_is_capturing() {
+    return s_capturing.load(std::memory_order_acquire) ||
+           s_frames_requested.load(std::memory_order_acquire) > 0;
+}
+
+void profiler_record(cstring name, u64 begin, u64 end) {
+    if (!s_capturing.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    ThreadEvents* events = get_thread_events();
+    const u64     index  = events->write_count.load(std::memory_order_relaxed);
+    events->events[index % k_events_per_thread] = {name, begin, end};
+    events->write_count.store(index + 1, std::memory_order_release);
+}
+
+static void write_chrome_trace(u64 capture_begin, u64 capture_end) {
+    // Ticks per microsecond, measured over the whole run so far
+    const u64 now_timestamp = profiler_timestamp();
+    const f64 elapsed_us    = std::chrono::duration<f64, std::micro>(
+                               std::chrono::steady_clock::now() - s_base_time)
+                               .count();
+    const f64 ticks_per_us  = elapsed_us > 0.0 ? (now_timestamp - s_base_timestamp) / elapsed_us
+                                                : 1.0;
+
+    std::string text = "{\"traceEvents\":[\n";
+    bool        first = true;
+
+    std::lock_guard lock(s_threads_mutex);
+    for (const std::unique_ptr<ThreadEvents>& thread : s_threads) {
+        fmt::format_to(std::back_inserter(text),
+                       "{}{{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":{},"
+                       "\"args\":{{\"name\":\"{}\"}}}}",
+                       first ? "" : ",\n", thread->thread_id, thread->name);
+        first = false;
+
+        // A full ring has lost its oldest events, skip a margin in case the owner is writing
+        const u64 count = thread->write_count.load(std::memory_order_acquire);
+        const u64 start = count > k_events_per_thread ? count - k_events_per_thread + 64 : 0;
+        for (u64 i = start; i < count; ++i) {
+            const ProfileEvent& event = thread->events[i % k_events_per_thread];
+            if (event.begin < capture_begin || event.begin > capture_end) {
+                continue;
+            }
+            fmt::format_to(std::back_inserter(text),
+                           ",\n{{\"ph\":\"X\",\"name\":\"{}\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},"
+                           "\"dur\":{:.3f}}}",
+                           event.name, thread->thread_id,
+                           (event.begin - s_base_timestamp) / ticks_per_us,
+                           (event.end - event.begin) / ticks_per_us);
+        }
+    }
+    text += "\n]}\n";
+
+    if (write_file_atomic(s_capture_path.c_str(), text.data(), text.size())) {
+        spdlog::info("Wrote CPU trace to {}", s_capture_path);
+    }
+}
+
+void profiler_frame_mark() {
+    const u64 now = profiler_timestamp();
+
+    if (s_capturing.load(std::memory_order_relaxed)) {
+        profiler_record("Frame", s_frame_begin, now);
+        if (--s_frames_left == 0) {
+            s_capturing.store(false, std::memory_order_release);
+            write_chrome_trace(s_capture_begin, now);
+        }
+    } else {
+        const u32 requested = s_frames_requested.exchange(0, std::memory_order_acq_rel);
+        if (requested > 0) {
+            s_frames_left   = requested;
+            s_capture_begin = now;
+            s_capturing.store(true, std::memory_order_release);
+        }
+    }
+    s_frame_begin = now;
+}
+
+} // namespace fizzengine
@@ -5,65 +5,109 @@
 namespace fizzengine {
 
 void ResourcePool::init(const ResourcePoolCreation& creation) {
-    allocator               = creation.allocator;
-    pool_size               = creation.pool_size;
-    resource_size           = creation.resource_size;
-
-    sizet bytes_to_allocate = pool_size * (resource_size + sizeof(u32));
-
-    // Ignores alignment of object, split allocation into two if its a big deal
-    pool_memory = static_cast<u8*>(allocator->allocate(bytes_to_allocate, 1));
+    allocator     = creation.allocator;
+    pool_size     = creation.pool_size;
+    resource_size = (u32)memory_align(creation.resource_size, creation.resource_alignment);
+
+    // Slots first so they start on a cache line, bookkeeping arrays are packed after them
+    const sizet slots_size        = memory_align((sizet)pool_size * resource_size, k_cache_line_size);
+    const sizet array_size        = pool_size * sizeof(u32);
+    const sizet bytes_to_allocate = slots_size + array_size * 3;
+    const sizet alignment         = creation.resource_alignment > k_cache_line_size
+                                        ? creation.resource_alignment
+                                        : k_cache_line_size;
+
+    pool_memory = static_cast<u8*>(allocator->allocate(bytes_to_allocate, alignment));
     memset(pool_memory, 0, bytes_to_allocate);
 
-    free_indices   = reinterpret_cast<u32*>(pool_memory + (pool_size * resource_size));
-    used_resources = 0;
+    generations      = reinterpret_cast<u32*>(pool_memory + slots_size);
+    dense_indices    = generations + pool_size;
+    sparse_positions = dense_indices + pool_size;
 
+    // Generation 0 is never handed out so a zeroed handle is always stale
     for (u32 i = 0; i < pool_size; ++i) {
-        free_indices[i] = i;
+        generations[i] = 1;
     }
+    free_all_resources();
 }
 
 void ResourcePool::shutdown() {
 
     if (used_resources != 0) {
-        spdlog::warn("Resource pool has unfreed resources.\n");
+        spdlog::warn("Resource pool has {} unfreed resources.", used_resources);
     }
 
     allocator->deallocate(pool_memory);
 }
 
-u32 ResourcePool::obtain_resource() {
+ResourceHandle ResourcePool::obtain_resource() {
     if (used_resources < pool_size) {
-        const u32 free_index = free_indices[used_resources++];
-        return free_index;
+        const u32 free_index         = dense_indices[used_resources];
+        sparse_positions[free_index] = used_resources++;
+        return {.index = free_index, .generation = generations[free_index]};
     }
-    return k_invalid_index;
+    return k_invalid_handle;
 }
 
-void ResourcePool::release_resource(u32 handle) {
-    free_indices[--used_resources] = handle;
+void ResourcePool::release_resource(ResourceHandle handle) {
+    if (!is_valid(handle)) {
+        spdlog::warn("Releasing stale resource handle {} (generation {}).", handle.index,
+                     handle.generation);
+        return;
+    }
+
+    ++generations[handle.index];
+
+    // Swap the released slot with the last live one to keep the live range packed
+    const u32 position             = sparse_positions[handle.index];
+    const u32 last_index           = dense_indices[--used_resources];
+    dense_indices[position]        = last_index;
+    sparse_positions[last_index]   = position;
+    dense_indices[used_resources]  = handle.index;
+    sparse_positions[handle.index] = used_resources;
 }
 
 void ResourcePool::free_all_resources() {
+    for (u32 i = 0; i < used_resources; ++i) {
+        ++generations[dense_indices[i]];
+    }
     used_resources = 0;
 
     for (uint32_t i = 0; i < pool_size; ++i) {
-        free_indices[i] = i;
+        dense_indices[i]    = i;
+        sparse_positions[i] = i;
     }
 }
 
-void* ResourcePool::access_resource(u32 handle) {
-    if (handle != k_invalid_index) {
-        return &pool_memory[handle * resource_size];
+bool ResourcePool::is_valid(ResourceHandle handle) const {
+    return handle.index < pool_size && generations[handle.index] == handle.generation &&
+           sparse_positions[handle.index] < used_resources;
+}
+
+ResourceHandle ResourcePool::get_handle(u32 index) const {
+    return {.index = index, .generation = generations[index]};
+}
+
+void* ResourcePool::access_resource(ResourceHandle handle) {
+    if (is_valid(handle)) {
+        return &pool_memory[handle.index * resource_size];
     }
     return nullptr;
 }
 
-const void* ResourcePool::access_resource(u32 handle) const {
-    if (handle != k_invalid_index) {
-        return &pool_memory[handle * resource_size];
+const void* ResourcePool::access_resource(ResourceHandle handle) const {
+    if (is_valid(handle)) {
+        return &pool_memory[handle.index * resource_size];
     }
     return nullptr;
 }
 
+void* ResourcePool::access_slot(u32 index) {
+    return &pool_memory[index * resource_size];
+}
+
+const void* ResourcePool::access_slot(u32 index) const {
+    return &pool_memory[index * resource_size];
+}
+
 } // namespace fizzengine
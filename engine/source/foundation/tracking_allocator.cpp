@@ -0,0 +1,151 @@
+#include <foundation/tracking_allocator.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <vector>
+
+#if defined(FIZZ_PLATFORM_WINDOWS)
+#include <windows.h>
+#else
+#include <execinfo.h>
+#endif
+
+namespace fizzengine {
+
+static std::mutex                      s_registry_mutex;
+static std::vector<TrackingAllocator*> s_registry;
+
+static u32 capture_callstack(void** frames, u32 max_frames) {
+#if defined(FIZZ_PLATFORM_WINDOWS)
+    // Skip this function and TrackingAllocator::allocate
+    return CaptureStackBackTrace(2, max_frames, frames, nullptr);
+#else
+    void* raw[TrackingAllocator::k_max_callstack_depth + 2];
+    int   count = backtrace(raw, (int)max_frames + 2);
+    u32   kept  = count > 2 ? u32(count - 2) : 0;
+    std::copy(raw + 2, raw + 2 + kept, frames);
+    return kept;
+#endif
+}
+
+static u32 histogram_bucket(sizet size) {
+    const u32 bits   = size > 1 ? 64 - std::countl_zero((u64)(size - 1)) : 0;
+    const u32 bucket = bits > 4 ? bits - 4 : 0;
+    return std::min(bucket, AllocationStats::k_histogram_buckets - 1);
+}
+
+void TrackingAllocator::init(cstring tag, Allocator* backing_, bool capture_callstacks_) {
+    backing            = backing_;
+    capture_callstacks = capture_callstacks_;
+    stats              = {};
+    stats.tag          = tag;
+
+    std::lock_guard lock(s_registry_mutex);
+    s_registry.push_back(this);
+}
+
+void TrackingAllocator::shutdown() {
+    report_leaks();
+
+    {
+        std::lock_guard lock(s_registry_mutex);
+        s_registry.erase(std::remove(s_registry.begin(), s_registry.end(), this), s_registry.end());
+    }
+
+    std::lock_guard lock(mutex);
+    allocations.clear();
+    backing = nullptr;
+}
+
+void* TrackingAllocator::allocate(sizet size, sizet alignment) {
+    void* pointer = backing->allocate(size, alignment);
+    if (!pointer) {
+        return nullptr;
+    }
+
+    AllocationRecord record;
+    record.size = size;
+    if (capture_callstacks) {
+        record.frame_count = capture_callstack(record.frames, k_max_callstack_depth);
+    }
+
+    std::lock_guard lock(mutex);
+    allocations[pointer] = record;
+
+    stats.live_bytes += size;
+    stats.total_bytes += size;
+    stats.peak_bytes = std::max(stats.peak_bytes, stats.live_bytes);
+    ++stats.live_allocations;
+    ++stats.total_allocations;
+    ++stats.size_histogram[histogram_bucket(size)];
+    return pointer;
+}
+
+void TrackingAllocator::deallocate(void* pointer) {
+    if (!pointer) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        auto            it = allocations.find(pointer);
+        if (it == allocations.end()) {
+            spdlog::error("[{}] Freeing {} which was not allocated here", stats.tag, pointer);
+            return;
+        }
+        stats.live_bytes -= it->second.size;
+        --stats.live_allocations;
+        allocations.erase(it);
+    }
+
+    backing->deallocate(pointer);
+}
+
+AllocationStats TrackingAllocator::get_stats() const {
+    std::lock_guard lock(mutex);
+    return stats;
+}
+
+u32 TrackingAllocator::get_registered(std::span<TrackingAllocator*> out) {
+    std::lock_guard lock(s_registry_mutex);
+    const u32       count = (u32)std::min(out.size(), s_registry.size());
+    std::copy_n(s_registry.begin(), count, out.begin());
+    return count;
+}
+
+void TrackingAllocator::report_leaks() {
+    static const u32 k_max_reported_leaks = 32;
+
+    std::lock_guard  lock(mutex);
+    if (allocations.empty()) {
+        return;
+    }
+
+    spdlog::warn("[{}] {} allocations leaked, {} bytes (peak {} bytes)", stats.tag,
+                 stats.live_allocations, stats.live_bytes, stats.peak_bytes);
+
+    u32 reported = 0;
+    for (const auto& [pointer, record] : allocations) {
+        if (reported++ == k_max_reported_leaks) {
+            spdlog::warn("[{}] ... {} more", stats.tag, allocations.size() - k_max_reported_leaks);
+            break;
+        }
+        spdlog::warn("[{}]   {} bytes at {}", stats.tag, record.size, pointer);
+
+#if !defined(FIZZ_PLATFORM_WINDOWS)
+        if (record.frame_count) {
+            char** symbols = backtrace_symbols(record.frames, (int)record.frame_count);
+            for (u32 i = 0; i < record.frame_count; ++i) {
+                spdlog::warn("[{}]     {}", stats.tag, symbols ? symbols[i] : "?");
+            }
+            free(symbols);
+        }
+#else
+        for (u32 i = 0; i < record.frame_count; ++i) {
+            spdlog::warn("[{}]     {}", stats.tag, record.frames[i]);
+        }
+#endif
+    }
+}
+
+} // namespace fizzengine
@@ -0,0 +1,290 @@
+#include <renderer/async_uploader.hpp>
+#include <renderer/vk_initializers.hpp>
+
+#include <foundation/profiler.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace fizzengine {
+
+void AsyncUploader::init(VkDevice device_, VmaAllocator vma_allocator_, VkQueue transfer_queue,
+                         u32 transfer_family_, u32 graphics_family_, std::mutex* queue_mutex_) {
+    device          = device_;
+    vma_allocator   = vma_allocator_;
+    queue           = transfer_queue;
+    transfer_family = transfer_family_;
+    graphics_family = graphics_family_;
+    queue_mutex     = queue_mutex_;
+
+    VkSemaphoreTypeCreateInfo type_info{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue  = 0;
+
+    VkSemaphoreCreateInfo semaphore_info = vkinit::semaphore_create_info();
+    semaphore_info.pNext                 = &type_info;
+    VK_CHECK(vkCreateSemaphore(device, &semaphore_info, nullptr, &timeline));
+
+    VkCommandPoolCreateInfo pool_info = vkinit::command_pool_create_info(
+        transfer_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+    for (Batch& batch : batches) {
+        VK_CHECK(vkCreateCommandPool(device, &pool_info, nullptr, &batch.command_pool));
+        VkCommandBufferAllocateInfo alloc_info =
+            vkinit::command_buffer_allocate_info(batch.command_pool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(device, &alloc_info, &batch.command_buffer));
+    }
+
+    running = true;
+    worker  = std::thread([this]() { worker_loop(); });
+}
+
+void AsyncUploader::shutdown() {
+    {
+        std::lock_guard lock(mutex);
+        running = false;
+    }
+    wake.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    for (Batch& batch : batches) {
+        if (batch.ticket != 0) {
+            VkSemaphoreWaitInfo wait_info{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+            wait_info.semaphoreCount = 1;
+            wait_info.pSemaphores    = &timeline;
+            wait_info.pValues        = &batch.ticket;
+            VK_CHECK(vkWaitSemaphores(device, &wait_info, UINT64_MAX));
+        }
+        release_staging(batch);
+        vkDestroyCommandPool(device, batch.command_pool, nullptr);
+    }
+    to_acquire.clear();
+
+    vkDestroySemaphore(device, timeline, nullptr);
+}
+
+u64 AsyncUploader::enqueue(Request& request, const void* data) {
+    // Staging is suballocated by VMA, the copy into it happens here so the caller can free data
+    VkBufferCreateInfo buffer_info{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.size  = request.size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+    allocation_info.flags =
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo mapped{};
+    VK_CHECK(vmaCreateBuffer(vma_allocator, &buffer_info, &allocation_info, &request.staging,
+                             &request.staging_allocation, &mapped));
+    memcpy(mapped.pMappedData, data, request.size);
+    vmaFlushAllocation(vma_allocator, request.staging_allocation, 0, request.size);
+
+    {
+        std::lock_guard lock(mutex);
+        request.ticket = next_ticket++;
+        pending.push_back(request);
+        to_acquire.push_back(request);
+    }
+    wake.notify_one();
+    return request.ticket;
+}
+
+u64 AsyncUploader::upload_buffer(VkBuffer destination, VkDeviceSize destination_offset,
+                                 const void* data, VkDeviceSize size) {
+    Request request{};
+    request.buffer        = destination;
+    request.buffer_offset = destination_offset;
+    request.size          = size;
+    return enqueue(request, data);
+}
+
+u64 AsyncUploader::upload_image(VkImage destination, VkExtent3D extent, const void* data,
+                                VkDeviceSize size, VkImageLayout final_layout) {
+    Request request{};
+    request.image        = destination;
+    request.extent       = extent;
+    request.size         = size;
+    request.final_layout = final_layout;
+    return enqueue(request, data);
+}
+
+bool AsyncUploader::is_complete(u64 ticket) const {
+    u64 value = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, timeline, &value));
+    return value >= ticket;
+}
+
+void AsyncUploader::worker_loop() {
+    profiler_set_thread_name("AsyncUpload");
+
+    while (true) {
+        std::vector<Request> work;
+        {
+            std::unique_lock lock(mutex);
+            wake.wait(lock, [this]() { return !running || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+            work.swap(pending);
+        }
+
+        FIZZ_PROFILE_SCOPE("AsyncUploadBatch");
+        Batch& batch = batches[next_batch];
+        next_batch   = (next_batch + 1) % k_max_batches_in_flight;
+
+        // Only blocks when uploads come in faster than the transfer queue drains them
+        if (batch.ticket != 0) {
+            VkSemaphoreWaitInfo wait_info{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+            wait_info.semaphoreCount = 1;
+            wait_info.pSemaphores    = &timeline;
+            wait_info.pValues        = &batch.ticket;
+            VK_CHECK(vkWaitSemaphores(device, &wait_info, UINT64_MAX));
+            release_staging(batch);
+        }
+
+        batch.requests = std::move(work);
+        submit(batch);
+    }
+}
+
+void AsyncUploader::release_staging(Batch& batch) {
+    for (Request& request : batch.requests) {
+        vmaDestroyBuffer(vma_allocator, request.staging, request.staging_allocation);
+    }
+    batch.requests.clear();
+}
+
+void AsyncUploader::ownership_barriers(const Request& request, bool acquire,
+                                       BarrierBuilder& barriers) const {
+    // Within one family the semaphore alone orders the copy before its readers, only image layout
+    // transitions need a barrier. Across families both queues record the same transfer.
+    const bool transfer_ownership = transfer_family != graphics_family;
+
+    // The release half only makes the copy available, the acquire half makes it visible
+    VkPipelineStageFlags2 src_stage  = VK_PIPELINE_STAGE_2_COPY_BIT;
+    VkAccessFlags2        src_access = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    VkPipelineStageFlags2 dst_stage  = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2        dst_access = VK_ACCESS_2_NONE;
+    if (acquire) {
+        src_stage  = VK_PIPELINE_STAGE_2_NONE;
+        src_access = VK_ACCESS_2_NONE;
+        dst_stage  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        dst_access = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+    }
+
+    if (request.image == VK_NULL_HANDLE) {
+        if (!transfer_ownership) {
+            return;
+        }
+        barriers
+            .buffer(request.buffer, src_stage, src_access, dst_stage, dst_access,
+                    request.buffer_offset, request.size)
+            .queue_transfer(transfer_family, graphics_family);
+        return;
+    }
+
+    if (acquire && !transfer_ownership) {
+        return;
+    }
+    barriers.image(request.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, request.final_layout,
+                   src_stage, src_access, dst_stage, dst_access);
+    if (transfer_ownership) {
+        barriers.queue_transfer(transfer_family, graphics_family);
+    }
+}
+
+void AsyncUploader::submit(Batch& batch) {
+    VK_CHECK(vkResetCommandPool(device, batch.command_pool, 0));
+
+    VkCommandBuffer          cmd = batch.command_buffer;
+    VkCommandBufferBeginInfo begin_info =
+        vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+    BarrierBuilder barriers;
+    for (const Request& request : batch.requests) {
+        if (request.image != VK_NULL_HANDLE) {
+            barriers.image(request.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_NONE,
+                           VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_COPY_BIT,
+                           VK_ACCESS_2_TRANSFER_WRITE_BIT);
+        }
+    }
+    barriers.flush(cmd);
+
+    for (const Request& request : batch.requests) {
+        if (request.image == VK_NULL_HANDLE) {
+            VkBufferCopy2 region{.sType = VK_STRUCTURE_TYPE_BUFFER_COPY_2};
+            region.dstOffset = request.buffer_offset;
+            region.size      = request.size;
+
+            VkCopyBufferInfo2 copy_info{.sType = VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2};
+            copy_info.srcBuffer   = request.staging;
+            copy_info.dstBuffer   = request.buffer;
+            copy_info.regionCount = 1;
+            copy_info.pRegions    = &region;
+            vkCmdCopyBuffer2(cmd, &copy_info);
+        } else {
+            VkBufferImageCopy2 region{.sType = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2};
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent                 = request.extent;
+
+            VkCopyBufferToImageInfo2 copy_info{
+                .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_TO_IMAGE_INFO_2};
+            copy_info.srcBuffer      = request.staging;
+            copy_info.dstImage       = request.image;
+            copy_info.dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            copy_info.regionCount    = 1;
+            copy_info.pRegions       = &region;
+            vkCmdCopyBufferToImage2(cmd, &copy_info);
+        }
+        ownership_barriers(request, false, barriers);
+    }
+    barriers.flush(cmd);
+
+    VK_CHECK(vkEndCommandBuffer(cmd));
+
+    // Tickets are handed out in order and batches are submitted in order
+    batch.ticket                          = batch.requests.back().ticket;
+
+    VkCommandBufferSubmitInfo cmd_info    = vkinit::command_buffer_submit_info(cmd);
+    VkSemaphoreSubmitInfo     signal_info = vkinit::semaphore_submit_info(
+        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, timeline);
+    signal_info.value    = batch.ticket;
+    VkSubmitInfo2 submit = vkinit::submit_info(&cmd_info, &signal_info, nullptr);
+
+    if (queue_mutex) {
+        std::lock_guard lock(*queue_mutex);
+        VK_CHECK(vkQueueSubmit2(queue, 1, &submit, VK_NULL_HANDLE));
+    } else {
+        VK_CHECK(vkQueueSubmit2(queue, 1, &submit, VK_NULL_HANDLE));
+    }
+}
+
+u64 AsyncUploader::acquire(VkCommandBuffer cmd, u64 required_ticket) {
+    std::lock_guard lock(mutex);
+    if (to_acquire.empty()) {
+        return 0;
+    }
+
+    u64 completed = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, timeline, &completed));
+    const u64 limit = std::max(completed, required_ticket);
+
+    BarrierBuilder barriers;
+    u64            wait_value = 0;
+    sizet          count      = 0;
+    for (; count < to_acquire.size() && to_acquire[count].ticket <= limit; ++count) {
+        ownership_barriers(to_acquire[count], true, barriers);
+        wait_value = to_acquire[count].ticket;
+    }
+    to_acquire.erase(to_acquire.begin(), to_acquire.begin() + count);
+
+    barriers.flush(cmd);
+    return wait_value;
+}
+
+} // namespace fizzengine
@@ -0,0 +1,185 @@
+#include <renderer/barrier_builder.hpp>
+
+#if defined(FIZZ_VALIDATE_BARRIERS)
+#include <mutex>
+#include <unordered_map>
+#endif
+
+namespace fizzengine {
+
+VkImageSubresourceRange subresource_range(VkImageAspectFlags aspect, u32 base_mip, u32 mip_count,
+                                          u32 base_layer, u32 layer_count) {
+    VkImageSubresourceRange range{};
+    range.aspectMask     = aspect;
+    range.baseMipLevel   = base_mip;
+    range.levelCount     = mip_count;
+    range.baseArrayLayer = base_layer;
+    range.layerCount     = layer_count;
+    return range;
+}
+
+#if defined(FIZZ_VALIDATE_BARRIERS)
+struct TrackedImage {
+    u32                        mip_count;
+    u32                        layer_count;
+    std::vector<VkImageLayout> layouts; // mip major
+};
+
+static std::mutex                                s_tracked_mutex;
+static std::unordered_map<VkImage, TrackedImage> s_tracked_images;
+
+void track_image_layout(VkImage image, u32 mip_count, u32 layer_count, VkImageLayout layout) {
+    std::lock_guard lock(s_tracked_mutex);
+    s_tracked_images[image] = {mip_count, layer_count,
+                               std::vector<VkImageLayout>(mip_count * layer_count, layout)};
+}
+
+void untrack_image_layout(VkImage image) {
+    std::lock_guard lock(s_tracked_mutex);
+    s_tracked_images.erase(image);
+}
+
+// Checks old_layout against every subresource in range, then moves them to new_layout
+static void validate_image_barrier(const VkImageMemoryBarrier2& barrier) {
+    std::lock_guard lock(s_tracked_mutex);
+    auto            it = s_tracked_images.find(barrier.image);
+    if (it == s_tracked_images.end()) {
+        return;
+    }
+
+    TrackedImage&                  tracked = it->second;
+    const VkImageSubresourceRange& range   = barrier.subresourceRange;
+    const u32 mip_end   = range.levelCount == VK_REMAINING_MIP_LEVELS
+                              ? tracked.mip_count
+                              : range.baseMipLevel + range.levelCount;
+    const u32 layer_end = range.layerCount == VK_REMAINING_ARRAY_LAYERS
+                              ? tracked.layer_count
+                              : range.baseArrayLayer + range.layerCount;
+    if (mip_end > tracked.mip_count || layer_end > tracked.layer_count) {
+        spdlog::error("Barrier on image {} covers mips up to {} and layers up to {}, image has "
+                      "{} and {}",
+                      (void*)barrier.image, mip_end, layer_end, tracked.mip_count,
+                      tracked.layer_count);
+        return;
+    }
+
+    for (u32 mip = range.baseMipLevel; mip < mip_end; ++mip) {
+        for (u32 layer = range.baseArrayLayer; layer < layer_end; ++layer) {
+            VkImageLayout& layout = tracked.layouts[mip * tracked.layer_count + layer];
+            // Transitions from UNDEFINED drop the contents and are valid from any layout
+            if (barrier.oldLayout != VK_IMAGE_LAYOUT_UNDEFINED && barrier.oldLayout != layout) {
+                spdlog::error("Barrier on image {} mip {} layer {} expects {}, it is in {}",
+                              (void*)barrier.image, mip, layer,
+                              string_VkImageLayout(barrier.oldLayout),
+                              string_VkImageLayout(layout));
+            }
+            layout = barrier.newLayout;
+        }
+    }
+}
+#else
+void track_image_layout(VkImage, u32, u32, VkImageLayout) {
+}
+
+void untrack_image_layout(VkImage) {
+}
+#endif
+
+BarrierBuilder& BarrierBuilder::image(VkImage image, VkImageLayout old_layout,
+                                      VkImageLayout new_layout, VkPipelineStageFlags2 src_stage,
+                                      VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage,
+                                      VkAccessFlags2                 dst_access,
+                                      const VkImageSubresourceRange& range) {
+    VkImageMemoryBarrier2 barrier{.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+    barrier.srcStageMask        = src_stage;
+    barrier.srcAccessMask       = src_access;
+    barrier.dstStageMask        = dst_stage;
+    barrier.dstAccessMask       = dst_access;
+    barrier.oldLayout           = old_layout;
+    barrier.newLayout           = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image               = image;
+    barrier.subresourceRange    = range;
+    image_barriers.push_back(barrier);
+    last = k_last_image;
+    return *this;
+}
+
+BarrierBuilder& BarrierBuilder::buffer(VkBuffer buffer, VkPipelineStageFlags2 src_stage,
+                                       VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage,
+                                       VkAccessFlags2 dst_access, VkDeviceSize offset,
+                                       VkDeviceSize size) {
+    VkBufferMemoryBarrier2 barrier{.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+    barrier.srcStageMask        = src_stage;
+    barrier.srcAccessMask       = src_access;
+    barrier.dstStageMask        = dst_stage;
+    barrier.dstAccessMask       = dst_access;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer              = buffer;
+    barrier.offset              = offset;
+    barrier.size                = size;
+    buffer_barriers.push_back(barrier);
+    last = k_last_buffer;
+    return *this;
+}
+
+BarrierBuilder& BarrierBuilder::memory(VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access,
+                                       VkPipelineStageFlags2 dst_stage,
+                                       VkAccessFlags2        dst_access) {
+    VkMemoryBarrier2 barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    barrier.srcStageMask  = src_stage;
+    barrier.srcAccessMask = src_access;
+    barrier.dstStageMask  = dst_stage;
+    barrier.dstAccessMask = dst_access;
+    memory_barriers.push_back(barrier);
+    last = k_last_none;
+    return *this;
+}
+
+BarrierBuilder& BarrierBuilder::queue_transfer(u32 src_family, u32 dst_family) {
+    if (last == k_last_image) {
+        image_barriers.back().srcQueueFamilyIndex = src_family;
+        image_barriers.back().dstQueueFamilyIndex = dst_family;
+    } else if (last == k_last_buffer) {
+        buffer_barriers.back().srcQueueFamilyIndex = src_family;
+        buffer_barriers.back().dstQueueFamilyIndex = dst_family;
+    }
+    return *this;
+}
+
+void BarrierBuilder::record(VkCommandBuffer cmd) const {
+    if (empty()) {
+        return;
+    }
+
+#if defined(FIZZ_VALIDATE_BARRIERS)
+    for (const VkImageMemoryBarrier2& barrier : image_barriers) {
+        validate_image_barrier(barrier);
+    }
+#endif
+
+    VkDependencyInfo dep_info{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    dep_info.memoryBarrierCount       = (u32)memory_barriers.size();
+    dep_info.pMemoryBarriers          = memory_barriers.data();
+    dep_info.bufferMemoryBarrierCount = (u32)buffer_barriers.size();
+    dep_info.pBufferMemoryBarriers    = buffer_barriers.data();
+    dep_info.imageMemoryBarrierCount  = (u32)image_barriers.size();
+    dep_info.pImageMemoryBarriers     = image_barriers.data();
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+}
+
+void BarrierBuilder::flush(VkCommandBuffer cmd) {
+    record(cmd);
+    clear();
+}
+
+void BarrierBuilder::clear() {
+    image_barriers.clear();
+    buffer_barriers.clear();
+    memory_barriers.clear();
+    last = k_last_none;
+}
+
+} // namespace fizzengine
@@ -0,0 +1,236 @@
+#include <renderer/bindless.hpp>
+#include <renderer/gpu_resources.hpp>
+
+#include <algorithm>
+
+namespace fizzengine {
+
+// Upper bounds, clamped to the device's update after bind limits
+static const u32 k_max_sampled_images = 16384;
+static const u32 k_max_storage_images = 1024;
+static const u32 k_max_samplers       = 128;
+static const u32 k_max_buffers        = 16384;
+
+void BindlessHeap::init(VkDevice device_, VkPhysicalDevice physical_device,
+                        VmaAllocator vma_allocator_, u32 frame_count_) {
+    device        = device_;
+    vma_allocator = vma_allocator_;
+    frame_count   = std::min(frame_count_, k_max_frames);
+
+    VkPhysicalDeviceVulkan12Properties properties12{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES};
+    VkPhysicalDeviceProperties2 properties{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+    properties.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(physical_device, &properties);
+
+    slots[k_bindless_sampled_image].capacity =
+        std::min({k_max_sampled_images, properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+                  properties12.maxPerStageDescriptorUpdateAfterBindSampledImages});
+    slots[k_bindless_storage_image].capacity =
+        std::min({k_max_storage_images, properties12.maxDescriptorSetUpdateAfterBindStorageImages,
+                  properties12.maxPerStageDescriptorUpdateAfterBindStorageImages});
+    slots[k_bindless_sampler].capacity =
+        std::min({k_max_samplers, properties12.maxDescriptorSetUpdateAfterBindSamplers,
+                  properties12.maxPerStageDescriptorUpdateAfterBindSamplers});
+    slots[k_bindless_buffer].capacity = k_max_buffers;
+
+    // Layout, bindings are indexed by BindlessType
+    DescriptorLayoutBuilder builder;
+    builder.add_binding(k_bindless_sampled_image, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+                        slots[k_bindless_sampled_image].capacity);
+    builder.add_binding(k_bindless_storage_image, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                        slots[k_bindless_storage_image].capacity);
+    builder.add_binding(k_bindless_sampler, VK_DESCRIPTOR_TYPE_SAMPLER,
+                        slots[k_bindless_sampler].capacity);
+    builder.add_binding(k_bindless_buffer, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+
+    // Slots are written while command buffers using other slots of the set are pending
+    const VkDescriptorBindingFlags array_flags =
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorBindingFlags binding_flags[k_bindless_type_count] = {array_flags, array_flags,
+                                                                     array_flags, 0};
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+    flags_info.bindingCount  = k_bindless_type_count;
+    flags_info.pBindingFlags = binding_flags;
+
+    layout = builder.build(device, VK_SHADER_STAGE_ALL, &flags_info,
+                           VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+
+    VkDescriptorPoolSize pool_sizes[] = {
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, slots[k_bindless_sampled_image].capacity},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, slots[k_bindless_storage_image].capacity},
+        {VK_DESCRIPTOR_TYPE_SAMPLER, slots[k_bindless_sampler].capacity},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1}};
+
+    VkDescriptorPoolCreateInfo pool_info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    pool_info.flags                      = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets                    = 1;
+    pool_info.poolSizeCount              = (u32)std::size(pool_sizes);
+    pool_info.pPoolSizes                 = pool_sizes;
+    VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &pool));
+
+    VkDescriptorSetAllocateInfo alloc_info = {.sType =
+                                                  VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    alloc_info.descriptorPool              = pool;
+    alloc_info.descriptorSetCount          = 1;
+    alloc_info.pSetLayouts                 = &layout;
+    VK_CHECK(vkAllocateDescriptorSets(device, &alloc_info, &set));
+
+    VkPushConstantRange push_constants{};
+    push_constants.stageFlags = VK_SHADER_STAGE_ALL;
+    push_constants.offset     = 0;
+    push_constants.size       = k_push_constant_size;
+
+    VkPipelineLayoutCreateInfo layout_info{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layout_info.setLayoutCount         = 1;
+    layout_info.pSetLayouts            = &layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges    = &push_constants;
+    VK_CHECK(vkCreatePipelineLayout(device, &layout_info, nullptr, &pipeline_layout));
+
+    // Device address table, persistently mapped and written as buffers are added
+    VkBufferCreateInfo buffer_info{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.size  = sizeof(VkDeviceAddress) * slots[k_bindless_buffer].capacity;
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.usage = VMA_MEMORY_USAGE_AUTO;
+    allocation_info.flags =
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo mapped{};
+    VK_CHECK(vmaCreateBuffer(vma_allocator, &buffer_info, &allocation_info, &address_buffer,
+                             &address_allocation, &mapped));
+    addresses = static_cast<VkDeviceAddress*>(mapped.pMappedData);
+
+    VkDescriptorBufferInfo table_info{address_buffer, 0, VK_WHOLE_SIZE};
+    VkWriteDescriptorSet   write{.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet          = set;
+    write.dstBinding      = k_bindless_buffer;
+    write.descriptorCount = 1;
+    write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo     = &table_info;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+    spdlog::info("Bindless heap: {} sampled images, {} storage images, {} samplers, {} buffers",
+                 slots[k_bindless_sampled_image].capacity, slots[k_bindless_storage_image].capacity,
+                 slots[k_bindless_sampler].capacity, slots[k_bindless_buffer].capacity);
+}
+
+void BindlessHeap::shutdown() {
+    vmaDestroyBuffer(vma_allocator, address_buffer, address_allocation);
+    vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+    vkDestroyDescriptorSetLayout(device, layout, nullptr);
+    // Frees the set as well
+    vkDestroyDescriptorPool(device, pool, nullptr);
+}
+
+u32 BindlessHeap::allocate_index(BindlessType type) {
+    Slots& type_slots = slots[type];
+    if (!type_slots.free_indices.empty()) {
+        const u32 index = type_slots.free_indices.back();
+        type_slots.free_indices.pop_back();
+        return index;
+    }
+    if (type_slots.next_index < type_slots.capacity) {
+        return type_slots.next_index++;
+    }
+
+    spdlog::error("Bindless heap is out of slots for type {}", (u32)type);
+    return k_invalid_bindless_index;
+}
+
+void BindlessHeap::write_image(BindlessType type, u32 index, VkImageView view,
+                               VkImageLayout image_layout) {
+    VkDescriptorImageInfo image_info{};
+    image_info.imageView   = view;
+    image_info.imageLayout = image_layout;
+
+    VkWriteDescriptorSet write{.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet          = set;
+    write.dstBinding      = type;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType  = type == k_bindless_storage_image ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                                                             : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    write.pImageInfo      = &image_info;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+u32 BindlessHeap::add_sampled_image(VkImageView view, VkImageLayout image_layout) {
+    std::lock_guard lock(mutex);
+    const u32       index = allocate_index(k_bindless_sampled_image);
+    if (index != k_invalid_bindless_index) {
+        write_image(k_bindless_sampled_image, index, view, image_layout);
+    }
+    return index;
+}
+
+u32 BindlessHeap::add_storage_image(VkImageView view) {
+    std::lock_guard lock(mutex);
+    const u32       index = allocate_index(k_bindless_storage_image);
+    if (index != k_invalid_bindless_index) {
+        write_image(k_bindless_storage_image, index, view, VK_IMAGE_LAYOUT_GENERAL);
+    }
+    return index;
+}
+
+u32 BindlessHeap::add_sampler(VkSampler sampler) {
+    std::lock_guard lock(mutex);
+    const u32       index = allocate_index(k_bindless_sampler);
+    if (index == k_invalid_bindless_index) {
+        return index;
+    }
+
+    VkDescriptorImageInfo sampler_info{};
+    sampler_info.sampler = sampler;
+
+    VkWriteDescriptorSet write{.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet          = set;
+    write.dstBinding      = k_bindless_sampler;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType  = VK_DESCRIPTOR_TYPE_SAMPLER;
+    write.pImageInfo      = &sampler_info;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    return index;
+}
+
+u32 BindlessHeap::add_buffer(VkDeviceAddress address) {
+    std::lock_guard lock(mutex);
+    const u32       index = allocate_index(k_bindless_buffer);
+    if (index == k_invalid_bindless_index) {
+        return index;
+    }
+
+    addresses[index] = address;
+    vmaFlushAllocation(vma_allocator, address_allocation, index * sizeof(VkDeviceAddress),
+                       sizeof(VkDeviceAddress));
+    return index;
+}
+
+void BindlessHeap::release(BindlessType type, u32 index, u32 frame_index) {
+    if (index == k_invalid_bindless_index) {
+        return;
+    }
+    std::lock_guard lock(mutex);
+    slots[type].retired[frame_index % frame_count].push_back(index);
+}
+
+void BindlessHeap::begin_frame(u32 frame_index) {
+    std::lock_guard lock(mutex);
+    for (Slots& type_slots : slots) {
+        std::vector<u32>& retired = type_slots.retired[frame_index % frame_count];
+        type_slots.free_indices.insert(type_slots.free_indices.end(), retired.begin(),
+                                       retired.end());
+        retired.clear();
+    }
+}
+
+void BindlessHeap::bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point) const {
+    vkCmdBindDescriptorSets(cmd, bind_point, pipeline_layout, 0, 1, &set, 0, nullptr);
+}
+
+} // namespace fizzengine
@@ -2,18 +2,73 @@
 
 #include <application/window.hpp>
 
+#include <SDL.h>
 #include <SDL_vulkan.h>
 #include <VkBootstrap.h>
 
 #define VMA_IMPLEMENTATION
 #include <vma/vk_mem_alloc.h>
 
+#include <foundation/file.hpp>
+#include <foundation/hash.hpp>
+#include <foundation/profiler.hpp>
 #include <renderer/device.hpp>
 #include <renderer/vk_initializers.hpp>
 #include <renderer/vk_utils.hpp>
 
+#include <algorithm>
+#include <chrono>
+
 namespace fizzengine {
-void GPUDevice::init_vulkan(Window window) {
+
+static const sizet   k_frame_allocator_size   = mega(4);
+
+static const cstring k_pipeline_cache_path    = "pipeline_cache.bin";
+static const u32     k_pipeline_cache_magic   = 0x4350465a; // "ZFPC"
+// Bump when anything that affects generated pipelines changes without the driver knowing
+static const u32     k_pipeline_cache_version = 1;
+
+// Written in front of the driver's blob. The driver validates its own header too, but some
+// drivers crash on foreign data instead of rejecting it, so we never hand them a mismatch.
+struct PipelineCacheFileHeader {
+    u32 magic;
+    u32 version;
+    u32 vendor_id;
+    u32 device_id;
+    u32 driver_version;
+    u8  pipeline_cache_uuid[VK_UUID_SIZE];
+    u64 data_size;
+    u64 data_hash;
+};
+
+cstring get_frame_pacing_name(FramePacing pacing) {
+    static const cstring k_names[k_pacing_count] = {"vsync", "mailbox", "immediate",
+                                                    "low-latency"};
+    return pacing < k_pacing_count ? k_names[pacing] : "unknown";
+}
+
+static VkPresentModeKHR get_present_mode(FramePacing pacing) {
+    switch (pacing) {
+    case k_pacing_mailbox:
+        return VK_PRESENT_MODE_MAILBOX_KHR;
+    case k_pacing_immediate:
+        return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    default:
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+}
+
+void GPUDevice::init_vulkan(Window window, Allocator* allocator, JobSystem* job_system) {
+    m_allocator        = allocator;
+    m_job_system       = job_system;
+    m_sdl_window       = window.get_SDL_Window();
+    m_frames_in_flight = std::clamp(m_frames_in_flight, 1u, k_max_frames_in_flight);
+    if (!m_frame_allocator.init(m_allocator, k_frame_allocator_size, m_frames_in_flight)) {
+        // Every frame starts in it, there is no running without one
+        spdlog::error("Failed to initialize the frame allocator");
+        abort();
+    }
+
     volkInitialize();
     vkb::InstanceBuilder builder;
 
@@ -22,6 +77,7 @@ void GPUDevice::init_vulkan(Window window) {
                         .request_validation_layers(m_use_validation_layers)
                         .use_default_debug_messenger()
                         .require_api_version(1, 3, 0)
+                        .set_headless(m_headless)
                         .build();
 
     vkb::Instance vkb_inst = inst_ret.value();
@@ -31,13 +87,31 @@ void GPUDevice::init_vulkan(Window window) {
     volkLoadInstance(m_instance);
     m_debug_messenger = vkb_inst.debug_messenger;
 
-    create_vulkan_surface(window.get_SDL_Window());
+    if (!m_headless) {
+        create_vulkan_surface(m_sdl_window);
+    }
 
     vkb::Device vkb_device  = select_device(vkb_inst);
 
     m_graphics_queue        = vkb_device.get_queue(vkb::QueueType::graphics).value();
     m_graphics_queue_family = vkb_device.get_queue_index(vkb::QueueType::graphics).value();
 
+    // Prefer a transfer only family, then any family without graphics, then share graphics
+    auto transfer_queue       = vkb_device.get_dedicated_queue(vkb::QueueType::transfer);
+    auto transfer_queue_index = vkb_device.get_dedicated_queue_index(vkb::QueueType::transfer);
+    if (!transfer_queue) {
+        transfer_queue       = vkb_device.get_queue(vkb::QueueType::transfer);
+        transfer_queue_index = vkb_device.get_queue_index(vkb::QueueType::transfer);
+    }
+    if (transfer_queue && transfer_queue_index) {
+        m_transfer_queue        = transfer_queue.value();
+        m_transfer_queue_family = transfer_queue_index.value();
+    } else {
+        spdlog::info("No separate transfer queue, uploads share the graphics queue");
+        m_transfer_queue        = m_graphics_queue;
+        m_transfer_queue_family = m_graphics_queue_family;
+    }
+
     VmaVulkanFunctions vma_vulkan_func{};
     vma_vulkan_func.vkGetInstanceProcAddr               = vkGetInstanceProcAddr;
     vma_vulkan_func.vkGetDeviceProcAddr                 = vkGetDeviceProcAddr;
@@ -70,23 +144,70 @@ void GPUDevice::init_vulkan(Window window) {
 
     m_main_deletion_queue.push_function([&]() { vmaDestroyAllocator(m_vma_allocator); });
 
+    // Before any texture is created, they register themselves with it
+    m_bindless.init(m_device, m_chosen_GPU, m_vma_allocator, m_frames_in_flight);
+    m_main_deletion_queue.push_function([&]() { m_bindless.shutdown(); });
+
+    m_render_graph.init(m_device, m_vma_allocator, m_frames_in_flight);
+    m_main_deletion_queue.push_function([&]() { m_render_graph.shutdown(); });
+
+    m_buffers.init(m_allocator, k_max_buffers);
+    m_upload_manager.init(m_device, m_vma_allocator, m_frames_in_flight);
+    // Locked even on a queue of its own, device wide waits synchronize with every queue
+    m_async_uploader.init(m_device, m_vma_allocator, m_transfer_queue, m_transfer_queue_family,
+                          m_graphics_queue_family, &m_queue_mutex);
+    m_main_deletion_queue.push_function([&]() {
+        m_async_uploader.shutdown();
+        m_upload_manager.shutdown();
+        m_buffers.for_each([&](ResourceHandle, Buffer& buffer) {
+            vmaDestroyBuffer(m_vma_allocator, buffer.m_buffer, buffer.m_vma_allocation);
+        });
+        m_buffers.shutdown();
+    });
+
     auto [width, height] = window.get_dimensions();
-    create_swapchain(width, height);
+    if (m_headless) {
+        create_offscreen_targets(width, height);
+    } else {
+        create_swapchain(width, height);
+    }
     create_draw_target(width, height);
 
     init_commands();
+    m_gpu_profiler.init(m_device, m_chosen_GPU, m_graphics_queue_family, m_frames_in_flight,
+                        m_supports_pipeline_statistics);
 
     init_sync_structures();
     init_descriptors();
+
+    const auto pipeline_start = std::chrono::steady_clock::now();
+    init_pipeline_cache();
+    vkutil::init_shader_compiler();
+    if (m_use_shader_hot_reload) {
+        m_shader_hot_reload.init(m_device, m_pipeline_cache);
+    }
     init_pipelines();
+    m_pipeline_startup_ms = std::chrono::duration<f64, std::milli>(
+                                std::chrono::steady_clock::now() - pipeline_start)
+                                .count();
 
     spdlog::info("Vulkan instance created");
 }
 
 void GPUDevice::shutdown() {
-    vkDeviceWaitIdle(m_device);
-    for (int i = 0; i < k_frames_in_flight; i++) {
+    {
+        std::lock_guard lock(m_queue_mutex);
+        vkDeviceWaitIdle(m_device);
+    }
+    m_gpu_profiler.shutdown();
+    if (m_use_shader_hot_reload) {
+        m_shader_hot_reload.shutdown();
+    }
+    for (u32 i = 0; i < m_frames_in_flight; i++) {
         vkDestroyCommandPool(m_device, m_frames[i].m_command_pool, nullptr);
+        for (WorkerCommandPool& worker_pool : m_frames[i].m_worker_pools) {
+            vkDestroyCommandPool(m_device, worker_pool.m_command_pool, nullptr);
+        }
         vkDestroyFence(m_device, m_command_buffer_executed_fence[i], nullptr);
         vkDestroySemaphore(m_device, m_render_complete_semaphore[i], nullptr);
         vkDestroySemaphore(m_device, m_image_acquired_semaphore[i], nullptr);
@@ -94,14 +215,22 @@ void GPUDevice::shutdown() {
         m_frames[i].m_deletion_queue.flush();
     }
 
+    save_pipeline_cache();
+    vkDestroyPipelineCache(m_device, m_pipeline_cache, nullptr);
+    vkutil::shutdown_shader_compiler();
+
     m_main_deletion_queue.flush();
 
-    destroy_swapchain();
-    vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+    if (!m_headless) {
+        destroy_swapchain();
+        vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+    }
     vkDestroyDevice(m_device, nullptr);
 
     vkb::destroy_debug_utils_messenger(m_instance, m_debug_messenger);
     vkDestroyInstance(m_instance, nullptr);
+
+    m_frame_allocator.shutdown();
 }
 
 void GPUDevice::create_vulkan_surface(SDL_Window* window) {
@@ -119,21 +248,39 @@ vkb::Device GPUDevice::select_device(vkb::Instance vkb_inst) {
     VkPhysicalDeviceVulkan12Features features12{
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
     features12.bufferDeviceAddress             = true;
+    features12.timelineSemaphore               = true;
     features12.descriptorIndexing              = true;
     features12.descriptorBindingPartiallyBound = true;
     features12.runtimeDescriptorArray          = true;
+    // Bindless heap
+    features12.descriptorBindingSampledImageUpdateAfterBind = true;
+    features12.descriptorBindingStorageImageUpdateAfterBind = true;
+    features12.descriptorBindingUpdateUnusedWhilePending    = true;
+    features12.shaderSampledImageArrayNonUniformIndexing    = true;
+    features12.shaderStorageImageArrayNonUniformIndexing    = true;
 
     vkb::PhysicalDeviceSelector selector{vkb_inst};
-    vkb::PhysicalDevice         vkb_physical_device = selector.set_minimum_version(1, 3)
-                                                  .set_required_features_13(features)
-                                                  .set_required_features_12(features12)
-                                                  .set_surface(m_surface)
-                                                  .select()
-                                                  .value();
+    selector.set_minimum_version(1, 3)
+        .set_required_features_13(features)
+        .set_required_features_12(features12);
+    // A headless instance does not ask for presentation support, so CPU implementations qualify
+    if (!m_headless) {
+        selector.set_surface(m_surface);
+    }
+    vkb::PhysicalDevice vkb_physical_device = selector.select().value();
 
     // Already available in 1.3 but imgui needs it because it needs the extension version to make
     // the multiple viewports work
     vkb_physical_device.enable_extension_if_present("VK_KHR_dynamic_rendering");
+
+    // Optional, the GPU profiler collects pipeline statistics when these are there. Inherited
+    // queries let statistics queries stay active across secondaries from record_parallel.
+    VkPhysicalDeviceFeatures profiler_features{};
+    profiler_features.pipelineStatisticsQuery = true;
+    profiler_features.inheritedQueries        = true;
+    m_supports_pipeline_statistics =
+        vkb_physical_device.enable_features_if_present(profiler_features);
+
     vkb::DeviceBuilder device_builder{vkb_physical_device};
 
     vkb::Device        vkb_device = device_builder.build().value();
@@ -193,15 +340,81 @@ void GPUDevice::create_draw_target(u32 width, u32 height) {
     sampler_info.maxAnisotropy = 1.0f;
     VK_CHECK(vkCreateSampler(m_device, &sampler_info, nullptr, &m_draw_image.m_sampler));
 
+    m_draw_image.m_storage_index = m_bindless.add_storage_image(m_draw_image.m_image_view);
+    m_draw_image.m_sampled_index = m_bindless.add_sampled_image(m_draw_image.m_image_view);
+    m_draw_image.m_sampler_index = m_bindless.add_sampler(m_draw_image.m_sampler);
+    track_image_layout(m_draw_image.m_image, 1, 1);
+
     // add to deletion queues
     m_main_deletion_queue.push_function([=, this]() {
+        untrack_image_layout(m_draw_image.m_image);
         vkDestroySampler(m_device, m_draw_image.m_sampler, nullptr);
         vkDestroyImageView(m_device, m_draw_image.m_image_view, nullptr);
         vmaDestroyImage(m_vma_allocator, m_draw_image.m_image, m_draw_image.m_vma_allocation);
     });
 }
 
-void GPUDevice::create_swapchain(u32 width, u32 height) {
+ResourceHandle GPUDevice::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                        bool host_visible) {
+    ResourceHandle handle = m_buffers.obtain();
+    if (!handle.is_valid()) {
+        spdlog::error("Buffer pool is full, {} buffers alive", k_max_buffers);
+        return handle;
+    }
+
+    Buffer& buffer = *m_buffers.get(handle);
+    buffer.m_size  = size;
+    buffer.m_usage =
+        usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+    VkBufferCreateInfo buffer_info{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.size  = size;
+    buffer_info.usage = buffer.m_usage;
+
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+    if (host_visible) {
+        allocation_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                                VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    }
+
+    VmaAllocationInfo info{};
+    VK_CHECK(vmaCreateBuffer(m_vma_allocator, &buffer_info, &allocation_info, &buffer.m_buffer,
+                             &buffer.m_vma_allocation, &info));
+    buffer.m_mapped_data = info.pMappedData;
+
+    VkBufferDeviceAddressInfo address_info{.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
+    address_info.buffer     = buffer.m_buffer;
+    buffer.m_device_address = vkGetBufferDeviceAddress(m_device, &address_info);
+
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+        buffer.m_bindless_index = m_bindless.add_buffer(buffer.m_device_address);
+    }
+    return handle;
+}
+
+void GPUDevice::destroy_buffer(ResourceHandle handle) {
+    Buffer* buffer = m_buffers.get(handle);
+    if (!buffer) {
+        return;
+    }
+
+    const u32 frame_index = get_frame_index();
+    if (buffer->m_bindless_index != k_invalid_bindless_index) {
+        m_bindless.release(k_bindless_buffer, buffer->m_bindless_index, frame_index);
+    }
+
+    // The current frame's queue runs after its fence signals the next time around, by then no
+    // frame that could reference the buffer is in flight anymore
+    VkBuffer      vk_buffer  = buffer->m_buffer;
+    VmaAllocation allocation = buffer->m_vma_allocation;
+    get_current_frame().m_deletion_queue.push_function(
+        [=, this]() { vmaDestroyBuffer(m_vma_allocator, vk_buffer, allocation); });
+
+    m_buffers.release(handle);
+}
+
+void GPUDevice::create_swapchain(u32 width, u32 height, VkSwapchainKHR old_swapchain) {
     vkb::SwapchainBuilder swapchainBuilder{m_chosen_GPU, m_device, m_surface};
 
     m_swapchain_image_format = VK_FORMAT_B8G8R8A8_UNORM;
@@ -211,18 +424,28 @@ void GPUDevice::create_swapchain(u32 width, u32 height) {
             //.use_default_format_selection()
             .set_desired_format(VkSurfaceFormatKHR{.format     = m_swapchain_image_format,
                                                    .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR})
-            // use vsync present mode
-            .set_desired_present_mode(m_vulkan_present_mode)
+            // Falls back to FIFO, the only mode every driver supports
+            .set_desired_present_mode(get_present_mode(m_frame_pacing))
             .set_desired_extent(width, height)
             .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+            .set_old_swapchain(old_swapchain)
             .build()
             .value();
 
-    m_swapchain_extent = vkbSwapchain.extent;
+    if (vkbSwapchain.present_mode != get_present_mode(m_frame_pacing)) {
+        spdlog::warn("{} pacing is not supported, presenting with {}",
+                     get_frame_pacing_name(m_frame_pacing),
+                     string_VkPresentModeKHR(vkbSwapchain.present_mode));
+    }
+    m_vulkan_present_mode = vkbSwapchain.present_mode;
+    m_swapchain_extent    = vkbSwapchain.extent;
     // store swapchain and its related images
     m_swapchain             = vkbSwapchain.swapchain;
     m_swapchain_images      = vkbSwapchain.get_images().value();
     m_swapchain_image_views = vkbSwapchain.get_image_views().value();
+    for (VkImage image : m_swapchain_images) {
+        track_image_layout(image, 1, 1);
+    }
 }
 
 void GPUDevice::destroy_swapchain() {
@@ -230,16 +453,84 @@ void GPUDevice::destroy_swapchain() {
 
     // destroy swapchain resources
     for (int i = 0; i < m_swapchain_image_views.size(); i++) {
+        m_render_graph.forget_image(m_swapchain_images[i]);
+        untrack_image_layout(m_swapchain_images[i]);
 
         vkDestroyImageView(m_device, m_swapchain_image_views[i], nullptr);
     }
 }
 
+bool GPUDevice::recreate_swapchain() {
+    int width  = 0;
+    int height = 0;
+    SDL_Vulkan_GetDrawableSize(m_sdl_window, &width, &height);
+    if (width == 0 || height == 0) {
+        return false; // Minimized, there is nothing to present to
+    }
+
+    // Frames in flight may still present the old images, so the old swapchain and its views are
+    // destroyed when this frame slot comes around again, like any other retired resource
+    VkSwapchainKHR           old_swapchain = m_swapchain;
+    std::vector<VkImageView> old_views     = std::move(m_swapchain_image_views);
+    for (VkImage image : m_swapchain_images) {
+        m_render_graph.forget_image(image);
+        untrack_image_layout(image);
+    }
+
+    create_swapchain(width, height, old_swapchain);
+    m_swapchain_dirty = false;
+
+    get_current_frame().m_deletion_queue.push_function([=, this]() {
+        for (VkImageView view : old_views) {
+            vkDestroyImageView(m_device, view, nullptr);
+        }
+        vkDestroySwapchainKHR(m_device, old_swapchain, nullptr);
+    });
+    return true;
+}
+
+void GPUDevice::create_offscreen_targets(u32 width, u32 height) {
+    m_swapchain_image_format = VK_FORMAT_B8G8R8A8_UNORM;
+    m_swapchain_extent       = {width, height};
+
+    // Same usage a swapchain image gets, plus readback
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                              VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    VkImageCreateInfo image_info =
+        vkinit::image_create_info(m_swapchain_image_format, usage, {width, height, 1});
+
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    std::vector<VmaAllocation> allocations(m_frames_in_flight);
+    m_swapchain_images.resize(m_frames_in_flight);
+    m_swapchain_image_views.resize(m_frames_in_flight);
+    for (u32 i = 0; i < m_frames_in_flight; ++i) {
+        VK_CHECK(vmaCreateImage(m_vma_allocator, &image_info, &allocation_info,
+                                &m_swapchain_images[i], &allocations[i], nullptr));
+
+        VkImageViewCreateInfo view_info = vkinit::imageview_create_info(
+            m_swapchain_image_format, m_swapchain_images[i], VK_IMAGE_ASPECT_COLOR_BIT);
+        VK_CHECK(vkCreateImageView(m_device, &view_info, nullptr, &m_swapchain_image_views[i]));
+        track_image_layout(m_swapchain_images[i], 1, 1);
+    }
+
+    m_main_deletion_queue.push_function([=, this]() {
+        for (sizet i = 0; i < allocations.size(); ++i) {
+            m_render_graph.forget_image(m_swapchain_images[i]);
+            untrack_image_layout(m_swapchain_images[i]);
+            vkDestroyImageView(m_device, m_swapchain_image_views[i], nullptr);
+            vmaDestroyImage(m_vma_allocator, m_swapchain_images[i], allocations[i]);
+        }
+    });
+}
+
 void GPUDevice::init_commands() {
-    VkCommandPoolCreateInfo command_pool_info = vkinit::command_pool_create_info(
-        m_graphics_queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    // Pools are reset as a whole every frame, so no per buffer reset flag
+    VkCommandPoolCreateInfo command_pool_info =
+        vkinit::command_pool_create_info(m_graphics_queue_family);
 
-    for (int i = 0; i < k_frames_in_flight; i++) {
+    for (u32 i = 0; i < m_frames_in_flight; i++) {
 
         VK_CHECK(vkCreateCommandPool(m_device, &command_pool_info, nullptr,
                                      &m_frames[i].m_command_pool));
@@ -249,14 +540,67 @@ void GPUDevice::init_commands() {
 
         VK_CHECK(vkAllocateCommandBuffers(m_device, &cmd_alloc_info,
                                           &m_frames[i].m_main_command_buffer));
+
+        m_frames[i].m_worker_pools.resize(m_job_system->get_worker_count());
+        for (WorkerCommandPool& worker_pool : m_frames[i].m_worker_pools) {
+            VK_CHECK(vkCreateCommandPool(m_device, &command_pool_info, nullptr,
+                                         &worker_pool.m_command_pool));
+        }
+    }
+}
+
+void GPUDevice::reset_command_pools(FrameData& frame) {
+    VK_CHECK(vkResetCommandPool(m_device, frame.m_command_pool, 0));
+
+    for (WorkerCommandPool& worker_pool : frame.m_worker_pools) {
+        if (worker_pool.m_used_command_buffers != 0) {
+            VK_CHECK(vkResetCommandPool(m_device, worker_pool.m_command_pool, 0));
+            worker_pool.m_used_command_buffers = 0;
+        }
+    }
+}
+
+VkCommandBuffer
+GPUDevice::begin_secondary_command_buffer(const VkCommandBufferInheritanceRenderingInfo* rendering) {
+    const u32 worker_index = JobSystem::get_current_worker_index();
+    if (worker_index == JobSystem::k_invalid_worker) {
+        spdlog::error("Secondary command buffers can only be recorded on job system workers");
+        abort();
+    }
+
+    WorkerCommandPool& worker_pool = get_current_frame().m_worker_pools[worker_index];
+    if (worker_pool.m_used_command_buffers == worker_pool.m_command_buffers.size()) {
+        VkCommandBufferAllocateInfo cmd_alloc_info = vkinit::command_buffer_allocate_info(
+            worker_pool.m_command_pool, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+        VkCommandBuffer cmd;
+        VK_CHECK(vkAllocateCommandBuffers(m_device, &cmd_alloc_info, &cmd));
+        worker_pool.m_command_buffers.push_back(cmd);
+    }
+    VkCommandBuffer cmd = worker_pool.m_command_buffers[worker_pool.m_used_command_buffers++];
+
+    VkCommandBufferInheritanceInfo inheritance_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    inheritance_info.pNext              = rendering;
+    // Must cover any statistics query the profiler has open on the primary
+    inheritance_info.pipelineStatistics = m_gpu_profiler.get_statistic_flags();
+
+    VkCommandBufferBeginInfo cmd_begin_info =
+        vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    if (rendering) {
+        cmd_begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
     }
+    cmd_begin_info.pInheritanceInfo = &inheritance_info;
+
+    VK_CHECK(vkBeginCommandBuffer(cmd, &cmd_begin_info));
+    return cmd;
 }
 
 void GPUDevice::init_sync_structures() {
     VkFenceCreateInfo     fenceCreateInfo = vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
     VkSemaphoreCreateInfo semaphoreCreateInfo = vkinit::semaphore_create_info();
 
-    for (int i = 0; i < k_frames_in_flight; i++) {
+    for (u32 i = 0; i < m_frames_in_flight; i++) {
         VK_CHECK(vkCreateFence(m_device, &fenceCreateInfo, nullptr,
                                &m_command_buffer_executed_fence[i]));
         VK_CHECK(vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr,
@@ -269,39 +613,100 @@ void GPUDevice::init_sync_structures() {
 void GPUDevice::init_descriptors() {
     std::vector<DescriptorAllocator::PoolSizeRatio> sizes = {
         {.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .ratio = 1},
+        {.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .ratio = 1},
+        {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .ratio = 1},
+        {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .ratio = 1},
+        {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .ratio = 1},
     };
-    m_global_descriptor_allocator.init_pool(m_device, 10, sizes);
+    m_global_descriptor_allocator.init(m_device, 16, sizes);
 
-    {
-        DescriptorLayoutBuilder builder;
-        builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-        m_draw_image_descriptor_layout = builder.build(m_device, VK_SHADER_STAGE_COMPUTE_BIT);
+    for (u32 i = 0; i < m_frames_in_flight; i++) {
+        m_frames[i].m_descriptor_allocator.init(m_device, 64, sizes);
     }
 
-    m_draw_image_descriptors =
-        m_global_descriptor_allocator.allocate(m_device, m_draw_image_descriptor_layout);
-
-    VkDescriptorImageInfo imgInfo{};
-    imgInfo.imageLayout                 = VK_IMAGE_LAYOUT_GENERAL;
-    imgInfo.imageView                   = m_draw_image.m_image_view;
+    m_main_deletion_queue.push_function([&]() {
+        m_global_descriptor_allocator.destroy_pools();
+        for (u32 i = 0; i < m_frames_in_flight; i++) {
+            m_frames[i].m_descriptor_allocator.destroy_pools();
+        }
+    });
+}
 
-    VkWriteDescriptorSet drawImageWrite = {};
-    drawImageWrite.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    drawImageWrite.pNext                = nullptr;
+void GPUDevice::init_pipeline_cache() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_chosen_GPU, &properties);
+
+    std::vector<u8> file_data;
+    const void*     initial_data = nullptr;
+    sizet           initial_size = 0;
+
+    if (read_file(k_pipeline_cache_path, file_data) &&
+        file_data.size() >= sizeof(PipelineCacheFileHeader)) {
+        PipelineCacheFileHeader header;
+        memcpy(&header, file_data.data(), sizeof(header));
+
+        const u8* data      = file_data.data() + sizeof(header);
+        const u64 data_size = file_data.size() - sizeof(header);
+
+        // The driver's own header leads its blob, check it agrees with ours
+        VkPipelineCacheHeaderVersionOne driver_header{};
+        if (data_size >= sizeof(driver_header)) {
+            memcpy(&driver_header, data, sizeof(driver_header));
+        }
+
+        const bool valid =
+            header.magic == k_pipeline_cache_magic && header.version == k_pipeline_cache_version &&
+            header.vendor_id == properties.vendorID && header.device_id == properties.deviceID &&
+            header.driver_version == properties.driverVersion &&
+            memcmp(header.pipeline_cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+            header.data_size == data_size && header.data_hash == hash_bytes(data, data_size) &&
+            driver_header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            driver_header.vendorID == properties.vendorID &&
+            driver_header.deviceID == properties.deviceID &&
+            memcmp(driver_header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+        if (valid) {
+            initial_data = data;
+            initial_size = data_size;
+            spdlog::info("Loaded pipeline cache ({} bytes)", data_size);
+        } else {
+            spdlog::info("Pipeline cache is stale or from another device, starting empty");
+        }
+    }
 
-    drawImageWrite.dstBinding           = 0;
-    drawImageWrite.dstSet               = m_draw_image_descriptors;
-    drawImageWrite.descriptorCount      = 1;
-    drawImageWrite.descriptorType       = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    drawImageWrite.pImageInfo           = &imgInfo;
+    VkPipelineCacheCreateInfo cache_info{.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    cache_info.initialDataSize = initial_size;
+    cache_info.pInitialData    = initial_data;
 
-    vkUpdateDescriptorSets(m_device, 1, &drawImageWrite, 0, nullptr);
+    VK_CHECK(vkCreatePipelineCache(m_device, &cache_info, nullptr, &m_pipeline_cache));
+}
 
-    // make sure both the descriptor allocator and the new layout get cleaned up properly
-    m_main_deletion_queue.push_function([&]() {
-        m_global_descriptor_allocator.destroy_pool(m_device);
-        vkDestroyDescriptorSetLayout(m_device, m_draw_image_descriptor_layout, nullptr);
-    });
+void GPUDevice::save_pipeline_cache() {
+    sizet data_size = 0;
+    VK_CHECK(vkGetPipelineCacheData(m_device, m_pipeline_cache, &data_size, nullptr));
+
+    std::vector<u8> file_data(sizeof(PipelineCacheFileHeader) + data_size);
+    VK_CHECK(vkGetPipelineCacheData(m_device, m_pipeline_cache, &data_size,
+                                    file_data.data() + sizeof(PipelineCacheFileHeader)));
+    file_data.resize(sizeof(PipelineCacheFileHeader) + data_size);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_chosen_GPU, &properties);
+
+    PipelineCacheFileHeader header{};
+    header.magic          = k_pipeline_cache_magic;
+    header.version        = k_pipeline_cache_version;
+    header.vendor_id      = properties.vendorID;
+    header.device_id      = properties.deviceID;
+    header.driver_version = properties.driverVersion;
+    memcpy(header.pipeline_cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.data_size = data_size;
+    header.data_hash = hash_bytes(file_data.data() + sizeof(header), data_size);
+    memcpy(file_data.data(), &header, sizeof(header));
+
+    if (write_file_atomic(k_pipeline_cache_path, file_data.data(), file_data.size())) {
+        spdlog::info("Saved pipeline cache ({} bytes)", data_size);
+    }
 }
 
 void GPUDevice::init_pipelines() {
@@ -309,13 +714,7 @@ void GPUDevice::init_pipelines() {
 }
 
 void GPUDevice::init_grad_pipeline() {
-    VkPipelineLayoutCreateInfo computeLayout{};
-    computeLayout.sType          = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    computeLayout.pNext          = nullptr;
-    computeLayout.pSetLayouts    = &m_draw_image_descriptor_layout;
-    computeLayout.setLayoutCount = 1;
-
-    VK_CHECK(vkCreatePipelineLayout(m_device, &computeLayout, nullptr, &m_grad_pipeline_layout));
+    // Bindless, the draw image is picked by index from push constants
     VkShaderModule computeDrawShader = vkutil::CompileSlangShader(
         m_device, "../../shaders/gradient.comp.slang", "main", VK_SHADER_STAGE_COMPUTE_BIT);
 
@@ -329,46 +728,108 @@ void GPUDevice::init_grad_pipeline() {
     VkComputePipelineCreateInfo computePipelineCreateInfo{};
     computePipelineCreateInfo.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
     computePipelineCreateInfo.pNext  = nullptr;
-    computePipelineCreateInfo.layout = m_grad_pipeline_layout;
+    computePipelineCreateInfo.layout = m_bindless.get_pipeline_layout();
     computePipelineCreateInfo.stage  = stageinfo;
 
-    VK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo,
+    VK_CHECK(vkCreateComputePipelines(m_device, m_pipeline_cache, 1, &computePipelineCreateInfo,
                                       nullptr, &m_grad_pipeline));
 
     vkDestroyShaderModule(m_device, computeDrawShader, nullptr);
 
-    m_main_deletion_queue.push_function([&]() {
-        vkDestroyPipelineLayout(m_device, m_grad_pipeline_layout, nullptr);
-        vkDestroyPipeline(m_device, m_grad_pipeline, nullptr);
-    });
+    if (m_use_shader_hot_reload) {
+        m_shader_hot_reload.watch_compute_pipeline("../../shaders/gradient.comp.slang", "main",
+                                                   m_bindless.get_pipeline_layout(),
+                                                   &m_grad_pipeline);
+    }
+
+    // Reads m_grad_pipeline on flush, so it releases whichever pipeline hot reload swapped in last
+    m_main_deletion_queue.push_function(
+        [&]() { vkDestroyPipeline(m_device, m_grad_pipeline, nullptr); });
 }
 
 VkCommandBuffer GPUDevice::new_frame() {
-    VkFence* render_complete_fence =
-        &m_command_buffer_executed_fence[m_frame_number % k_frames_in_flight];
+    FIZZ_PROFILE_FUNCTION();
+    VkFence* render_complete_fence = &m_command_buffer_executed_fence[get_frame_index()];
     if (vkGetFenceStatus(m_device, *render_complete_fence) != VK_SUCCESS) {
+        // Time the CPU spends blocked on the GPU
+        FIZZ_PROFILE_SCOPE("WaitForFence");
         VK_CHECK(vkWaitForFences(m_device, 1, render_complete_fence, VK_TRUE, UINT64_MAX));
     }
     get_current_frame().m_deletion_queue.flush();
+    m_frame_allocator.begin_frame(get_frame_index());
+    m_bindless.begin_frame(get_frame_index());
+    get_current_frame().m_descriptor_allocator.clear_pools();
+    m_upload_manager.begin_frame(get_frame_index());
+    m_render_graph.begin(get_frame_index());
+
+    // A skipped frame submits nothing, so this slot's fence stays signaled and the next frame
+    // flushes its deletion queue right away. What was retired in the meantime, a replaced
+    // swapchain or buffers destroyed between frames, may still be in use by the other slots, so
+    // those are waited for. The window is minimized, there is no frame rate to lose.
+    auto skip_frame = [this]() -> VkCommandBuffer {
+        m_swapchain_dirty = true;
+        VK_CHECK(vkWaitForFences(m_device, m_frames_in_flight, m_command_buffer_executed_fence,
+                                 VK_TRUE, UINT64_MAX));
+        return VK_NULL_HANDLE;
+    };
 
-    VK_CHECK(vkResetFences(m_device, 1, render_complete_fence));
+    if (m_swapchain_dirty && !m_headless) {
+        FIZZ_PROFILE_SCOPE("RecreateSwapchain");
+        if (!recreate_swapchain()) {
+            return skip_frame(); // Minimized, the window waits for it to come back
+        }
+    }
+
+    if (m_headless) {
+        // The target of this slot was last used by the frame whose fence just signaled
+        m_vulkan_image_index = get_frame_index();
+    } else {
+        FIZZ_PROFILE_SCOPE("AcquireImage");
+        auto acquire_image = [this]() {
+            return vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX,
+                                         m_image_acquired_semaphore[get_frame_index()],
+                                         VK_NULL_HANDLE, &m_vulkan_image_index);
+        };
+        // An out of date swapchain can't be presented to anymore, the failed acquire left the
+        // semaphore unsignaled so it is retried once on a new one
+        VkResult result = acquire_image();
+        if (result == VK_ERROR_OUT_OF_DATE_KHR && recreate_swapchain()) {
+            result = acquire_image();
+        }
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            // Minimized or resized again since the events were handled, skip the frame and let
+            // the next one handle the events first
+            return skip_frame();
+        }
+        if (result == VK_SUBOPTIMAL_KHR) {
+            // The image is acquired and still has to be presented, recreate next frame
+            m_swapchain_dirty = true;
+        } else {
+            VK_CHECK(result);
+        }
+    }
 
-    VkResult result =
-        vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX,
-                              m_image_acquired_semaphore[m_frame_number % k_frames_in_flight],
-                              VK_NULL_HANDLE, &m_vulkan_image_index);
+    // Only reset once the frame is sure to be submitted, a skipped frame leaves it signaled
+    VK_CHECK(vkResetFences(m_device, 1, render_complete_fence));
 
-    // if (result == VK_ERROR_OUT_OF_DATE_KHR)
-    // {
-    //     resize_swapchain();
-    // }
+    if (m_use_shader_hot_reload) {
+        // Swapped only for frames that are submitted. Older frames may still be executing the
+        // replaced pipelines, this frame's queue is only flushed once its fence signals again,
+        // and by then every earlier submission finished.
+        std::vector<VkPipeline> retired;
+        m_shader_hot_reload.apply_reloaded(retired);
+        for (VkPipeline pipeline : retired) {
+            get_current_frame().m_deletion_queue.push_function(
+                [this, pipeline]() { vkDestroyPipeline(m_device, pipeline, nullptr); });
+        }
+    }
 
-    // Command pool reset
+    // The frame retired, recycle all of its command buffers at once
+    reset_command_pools(get_current_frame());
 
     m_draw_extent.width  = m_draw_image.width;
     m_draw_extent.height = m_draw_image.height;
     VkCommandBuffer cmd  = get_current_frame().m_main_command_buffer;
-    VK_CHECK(vkResetCommandBuffer(cmd, 0));
 
     // begin the command buffer recording. We will use this command buffer exactly once, so we want
     // to let vulkan know that
@@ -377,11 +838,24 @@ VkCommandBuffer GPUDevice::new_frame() {
 
     // start the command buffer recording
     VK_CHECK(vkBeginCommandBuffer(cmd, &cmd_begin_info));
+    // Reads back the timings this frame slot recorded last time around, its fence just signaled
+    m_gpu_profiler.begin_frame(cmd, get_frame_index());
+    // Uploads queued since the last frame land before any pass of this one
+    m_upload_manager.flush(cmd, get_frame_index());
+    // Streamed uploads that finished in the meantime, waiting on them costs nothing
+    m_upload_wait_value = m_async_uploader.acquire(cmd);
     return cmd;
 }
 
+void GPUDevice::wait_for_upload(u64 ticket) {
+    const u64 wait_value =
+        m_async_uploader.acquire(get_current_frame().m_main_command_buffer, ticket);
+    m_upload_wait_value = std::max(m_upload_wait_value, wait_value);
+}
+
 void GPUDevice::present() {
-    u32                       frame_index = m_frame_number % k_frames_in_flight;
+    FIZZ_PROFILE_FUNCTION();
+    u32                       frame_index = get_frame_index();
     VkCommandBuffer           cmd         = get_current_frame().m_main_command_buffer;
     VkCommandBufferSubmitInfo cmdinfo     = vkinit::command_buffer_submit_info(cmd);
     VkSemaphoreSubmitInfo     waitInfo =
@@ -390,10 +864,33 @@ void GPUDevice::present() {
     VkSemaphoreSubmitInfo signalInfo = vkinit::semaphore_submit_info(
         VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, m_render_complete_semaphore[frame_index]);
 
-    VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, &signalInfo, &waitInfo);
+    // Headless frames have nothing to wait for or hand over, only the fence marks them done
+    VkSubmitInfo2 submit = m_headless ? vkinit::submit_info(&cmdinfo, nullptr, nullptr)
+                                      : vkinit::submit_info(&cmdinfo, &signalInfo, &waitInfo);
+
+    // Uploads this frame acquired have to land before it runs
+    VkSemaphoreSubmitInfo wait_infos[2] = {waitInfo};
+    if (m_upload_wait_value != 0) {
+        const u32 upload_wait = submit.waitSemaphoreInfoCount;
+        wait_infos[upload_wait] = vkinit::semaphore_submit_info(
+            VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_async_uploader.get_semaphore());
+        wait_infos[upload_wait].value = m_upload_wait_value;
+        submit.waitSemaphoreInfoCount = upload_wait + 1;
+        submit.pWaitSemaphoreInfos    = wait_infos;
+    }
+
+    {
+        FIZZ_PROFILE_SCOPE("QueueSubmit");
+        std::lock_guard lock(m_queue_mutex);
+        VK_CHECK(vkQueueSubmit2(m_graphics_queue, 1, &submit,
+                                m_command_buffer_executed_fence[frame_index]));
+    }
 
-    VK_CHECK(
-        vkQueueSubmit2(m_graphics_queue, 1, &submit, m_command_buffer_executed_fence[frame_index]));
+    if (m_headless) {
+        m_frame_number++;
+        m_upload_wait_value = 0;
+        return;
+    }
 
     VkPresentInfoKHR presentInfo   = {};
     presentInfo.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -406,9 +903,55 @@ void GPUDevice::present() {
 
     presentInfo.pImageIndices      = &m_vulkan_image_index;
 
-    VK_CHECK(vkQueuePresentKHR(m_graphics_queue, &presentInfo));
+    {
+        FIZZ_PROFILE_SCOPE("QueuePresent");
+        std::lock_guard lock(m_queue_mutex);
+        VkResult result = vkQueuePresentKHR(m_graphics_queue, &presentInfo);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+            m_swapchain_dirty = true;
+        } else {
+            VK_CHECK(result);
+        }
+    }
 
     // increase the number of frames drawn
     m_frame_number++;
+    m_upload_wait_value = 0;
+}
+
+void GPUDevice::pace_frame() {
+    if (m_frame_pacing != k_pacing_low_latency || m_frame_number == 0) {
+        return;
+    }
+    // Input sampled after this shows up in the very next frame the display picks up
+    FIZZ_PROFILE_SCOPE("PaceFrame");
+    wait_for_frame(m_frame_number - 1);
+}
+
+void GPUDevice::set_frame_pacing(FramePacing pacing) {
+    if (pacing == m_frame_pacing) {
+        return;
+    }
+    m_frame_pacing = pacing;
+    invalidate_swapchain();
+}
+
+bool GPUDevice::is_frame_complete(u32 frame_number) {
+    if (frame_number + m_frames_in_flight <= m_frame_number) {
+        return true;
+    }
+    if (frame_number >= m_frame_number) {
+        return false; // Not submitted yet
+    }
+    VkFence fence = m_command_buffer_executed_fence[frame_number % m_frames_in_flight];
+    return vkGetFenceStatus(m_device, fence) == VK_SUCCESS;
+}
+
+void GPUDevice::wait_for_frame(u32 frame_number) {
+    if (frame_number + m_frames_in_flight <= m_frame_number || frame_number >= m_frame_number) {
+        return;
+    }
+    VkFence fence = m_command_buffer_executed_fence[frame_number % m_frames_in_flight];
+    VK_CHECK(vkWaitForFences(m_device, 1, &fence, VK_TRUE, UINT64_MAX));
 }
 } // namespace fizzengine
@@ -0,0 +1,18 @@
+#include <renderer/embedded_shaders.hpp>
+
+#include <cstring>
+#include <filesystem>
+
+namespace fizzengine {
+
+const EmbeddedShader* find_embedded_shader(cstring path, cstring entry_point) {
+    const std::string name = std::filesystem::path(path).filename().string();
+    for (const EmbeddedShader& shader : get_embedded_shaders()) {
+        if (name == shader.name && strcmp(entry_point, shader.entry_point) == 0) {
+            return &shader;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace fizzengine
@@ -0,0 +1,37 @@
+#include <renderer/gpu_model.hpp>
+
+#include <renderer/device.hpp>
+
+namespace fizzengine {
+
+bool upload_model(GPUDevice& gpu, const ModelData& model, GPUModel& out_model) {
+    FIZZ_PROFILE_FUNCTION();
+    out_model = GPUModel{};
+    if (model.vertex_count == 0 || model.index_count == 0) {
+        return true;
+    }
+
+    const VkDeviceSize vertex_size = (VkDeviceSize)model.vertex_count * sizeof(Vertex);
+    const VkDeviceSize index_size  = (VkDeviceSize)model.index_count * sizeof(u32);
+    out_model.vertex_buffer = gpu.create_buffer(vertex_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    out_model.index_buffer  = gpu.create_buffer(index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    if (!out_model.vertex_buffer.is_valid() || !out_model.index_buffer.is_valid()) {
+        destroy_model(gpu, out_model);
+        return false;
+    }
+
+    gpu.m_upload_manager.upload_buffer(gpu.get_buffer(out_model.vertex_buffer)->m_buffer, 0,
+                                       model.vertices, vertex_size);
+    gpu.m_upload_manager.upload_buffer(gpu.get_buffer(out_model.index_buffer)->m_buffer, 0,
+                                       model.indices, index_size);
+    return true;
+}
+
+void destroy_model(GPUDevice& gpu, GPUModel& model) {
+    // Stale and invalid handles are ignored
+    gpu.destroy_buffer(model.vertex_buffer);
+    gpu.destroy_buffer(model.index_buffer);
+    model = GPUModel{};
+}
+
+} // namespace fizzengine
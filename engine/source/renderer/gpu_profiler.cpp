@@ -0,0 +1,276 @@
+#include <renderer/gpu_profiler.hpp>
+
+#include <foundation/file.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <string>
+
+namespace fizzengine {
+
+static cstring k_statistic_names[k_statistic_count] = {
+    "input_vertices", "vertex_invocations", "fragment_invocations", "compute_invocations"};
+
+void GPUProfiler::init(VkDevice device_, VkPhysicalDevice physical_device, u32 queue_family,
+                       u32 frame_count_, bool pipeline_statistics) {
+    device      = device_;
+    frame_count = std::min(frame_count_, k_max_frames);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    u32 family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+    const u32 valid_bits =
+        queue_family < family_count ? families[queue_family].timestampValidBits : 0;
+    if (valid_bits == 0) {
+        spdlog::warn("Queue family {} does not support timestamps, GPU profiler disabled",
+                     queue_family);
+        return;
+    }
+    timestamp_mask   = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+    timestamp_period = properties.limits.timestampPeriod;
+
+    if (pipeline_statistics) {
+        statistic_flags = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+                          VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                          VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+                          VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+    }
+
+    for (u32 i = 0; i < frame_count; ++i) {
+        VkQueryPoolCreateInfo pool_info{.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        pool_info.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+        pool_info.queryCount = k_max_scopes * 2;
+        VK_CHECK(vkCreateQueryPool(device, &pool_info, nullptr, &frames[i].timestamp_pool));
+
+        if (statistic_flags) {
+            pool_info.queryType          = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            pool_info.queryCount         = k_max_scopes;
+            pool_info.pipelineStatistics = statistic_flags;
+            VK_CHECK(vkCreateQueryPool(device, &pool_info, nullptr, &frames[i].statistics_pool));
+        }
+    }
+    enabled = true;
+}
+
+void GPUProfiler::shutdown() {
+    for (u32 i = 0; i < frame_count; ++i) {
+        if (frames[i].timestamp_pool) {
+            vkDestroyQueryPool(device, frames[i].timestamp_pool, nullptr);
+        }
+        if (frames[i].statistics_pool) {
+            vkDestroyQueryPool(device, frames[i].statistics_pool, nullptr);
+        }
+        frames[i] = FrameQueries{};
+    }
+    enabled = false;
+}
+
+void GPUProfiler::begin_frame(VkCommandBuffer cmd, u32 frame_index) {
+    if (!enabled) {
+        return;
+    }
+    if (stack_depth != 0) {
+        spdlog::warn("GPU profiler: {} scopes were not closed last frame", stack_depth);
+        stack_depth = 0;
+    }
+
+    // The fence of this slot signaled, everything it wrote is available
+    current = &frames[frame_index % frame_count];
+    if (current->scope_count > 0) {
+        resolve(*current);
+    }
+
+    current->scope_count      = 0;
+    current->timestamp_count  = 0;
+    current->statistics_count = 0;
+    current->frame            = ++frame_number;
+
+    vkCmdResetQueryPool(cmd, current->timestamp_pool, 0, k_max_scopes * 2);
+    if (current->statistics_pool) {
+        vkCmdResetQueryPool(cmd, current->statistics_pool, 0, k_max_scopes);
+    }
+}
+
+void GPUProfiler::push_scope(VkCommandBuffer cmd, cstring name) {
+    if (!enabled || !current) {
+        return;
+    }
+    if (current->scope_count == k_max_scopes || stack_depth == k_max_scopes) {
+        // Out of queries, keep the stack balanced and drop the scope
+        if (stack_depth < k_max_scopes) {
+            stack[stack_depth++] = k_invalid_query;
+        }
+        return;
+    }
+
+    const u32 scope_index = current->scope_count++;
+    Scope&    scope       = current->scopes[scope_index];
+    scope.name            = name;
+    scope.depth           = stack_depth;
+    scope.begin_query     = current->timestamp_count;
+    current->timestamp_count += 2;
+
+    // Only one statistics query can be active at a time, so nested scopes go without
+    scope.statistics_query = k_invalid_query;
+    if (current->statistics_pool && stack_depth == 0) {
+        scope.statistics_query = current->statistics_count++;
+        vkCmdBeginQuery(cmd, current->statistics_pool, scope.statistics_query, 0);
+    }
+
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, current->timestamp_pool,
+                         scope.begin_query);
+    stack[stack_depth++] = scope_index;
+}
+
+void GPUProfiler::pop_scope(VkCommandBuffer cmd) {
+    if (!enabled || !current || stack_depth == 0) {
+        return;
+    }
+
+    const u32 scope_index = stack[--stack_depth];
+    if (scope_index == k_invalid_query) {
+        return;
+    }
+
+    const Scope& scope = current->scopes[scope_index];
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, current->timestamp_pool,
+                         scope.begin_query + 1);
+    if (scope.statistics_query != k_invalid_query) {
+        vkCmdEndQuery(cmd, current->statistics_pool, scope.statistics_query);
+    }
+}
+
+void GPUProfiler::resolve(FrameQueries& queries) {
+    // Value and availability per query
+    u64 timestamps[k_max_scopes * 2][2];
+    vkGetQueryPoolResults(device, queries.timestamp_pool, 0, queries.timestamp_count,
+                          sizeof(timestamps), timestamps, sizeof(timestamps[0]),
+                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    u64 statistics[k_max_scopes][k_statistic_count + 1] = {};
+    if (queries.statistics_count > 0) {
+        vkGetQueryPoolResults(device, queries.statistics_pool, 0, queries.statistics_count,
+                              sizeof(statistics), statistics, sizeof(statistics[0]),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    }
+
+    timing_count = 0;
+    for (u32 i = 0; i < queries.scope_count; ++i) {
+        const Scope& scope = queries.scopes[i];
+        const u64*   begin = timestamps[scope.begin_query];
+        const u64*   end   = timestamps[scope.begin_query + 1];
+        if (!begin[1] || !end[1]) {
+            continue;
+        }
+
+        const u64 ticks =
+            ((end[0] & timestamp_mask) - (begin[0] & timestamp_mask)) & timestamp_mask;
+
+        GPUScopeTiming& timing = timings[timing_count++];
+        timing                 = GPUScopeTiming{};
+        timing.name            = scope.name;
+        timing.depth           = scope.depth;
+        timing.elapsed_ms      = (f64)ticks * timestamp_period / 1000000.0;
+
+        if (scope.statistics_query != k_invalid_query &&
+            statistics[scope.statistics_query][k_statistic_count]) {
+            memcpy(timing.statistics, statistics[scope.statistics_query],
+                   sizeof(timing.statistics));
+        }
+
+        ScopeHistory& history         = get_history(scope.name, scope.depth);
+        history.samples[history.head] = (f32)timing.elapsed_ms;
+        history.head                  = (history.head + 1) % k_history_frames;
+        history.sample_count          = std::min(history.sample_count + 1, k_history_frames);
+
+        f64 sum                       = 0.0;
+        timing.min_ms                 = history.samples[0];
+        timing.max_ms                 = history.samples[0];
+        for (u32 s = 0; s < history.sample_count; ++s) {
+            sum += history.samples[s];
+            timing.min_ms = std::min(timing.min_ms, (f64)history.samples[s]);
+            timing.max_ms = std::max(timing.max_ms, (f64)history.samples[s]);
+        }
+        timing.average_ms = sum / history.sample_count;
+    }
+    resolved_frame = queries.frame;
+}
+
+GPUProfiler::ScopeHistory& GPUProfiler::get_history(cstring name, u32 depth) {
+    for (u32 i = 0; i < history_count; ++i) {
+        ScopeHistory& history = histories[i];
+        if (history.depth == depth && (history.name == name || strcmp(history.name, name) == 0)) {
+            return history;
+        }
+    }
+
+    // Table is full, recycle the first entry
+    const u32     index   = history_count < k_max_scopes ? history_count++ : 0;
+    ScopeHistory& history = histories[index];
+    history               = ScopeHistory{};
+    history.name          = name;
+    history.depth         = depth;
+    return history;
+}
+
+bool GPUProfiler::export_csv(cstring path) const {
+    std::string text = "scope,depth,last_ms,average_ms,min_ms,max_ms";
+    for (cstring statistic : k_statistic_names) {
+        text += ',';
+        text += statistic;
+    }
+    text += '\n';
+
+    for (const GPUScopeTiming& timing : get_timings()) {
+        fmt::format_to(std::back_inserter(text), "{},{},{:.4f},{:.4f},{:.4f},{:.4f}", timing.name,
+                       timing.depth, timing.elapsed_ms, timing.average_ms, timing.min_ms,
+                       timing.max_ms);
+        for (u64 statistic : timing.statistics) {
+            fmt::format_to(std::back_inserter(text), ",{}", statistic);
+        }
+        text += '\n';
+    }
+    return write_file_atomic(path, text.data(), text.size());
+}
+
+bool GPUProfiler::export_json(cstring path) const {
+    std::string text;
+    fmt::format_to(std::back_inserter(text), "{{\n  \"frame\": {},\n  \"scopes\": [",
+                   resolved_frame);
+
+    bool first = true;
+    for (const GPUScopeTiming& timing : get_timings()) {
+        // Scope names are identifiers from code, quotes and backslashes are the only escapes needed
+        std::string name;
+        for (const char* c = timing.name; *c; ++c) {
+            if (*c == '"' || *c == '\\') {
+                name += '\\';
+            }
+            name += *c;
+        }
+
+        fmt::format_to(std::back_inserter(text),
+                       "{}\n    {{\"name\": \"{}\", \"depth\": {}, \"last_ms\": {:.4f}, "
+                       "\"average_ms\": {:.4f}, \"min_ms\": {:.4f}, \"max_ms\": {:.4f}",
+                       first ? "" : ",", name, timing.depth, timing.elapsed_ms, timing.average_ms,
+                       timing.min_ms, timing.max_ms);
+        if (statistic_flags) {
+            for (u32 s = 0; s < k_statistic_count; ++s) {
+                fmt::format_to(std::back_inserter(text), ", \"{}\": {}", k_statistic_names[s],
+                               timing.statistics[s]);
+            }
+        }
+        text += '}';
+        first = false;
+    }
+    text += "\n  ]\n}\n";
+    return write_file_atomic(path, text.data(), text.size());
+}
+
+} // namespace fizzengine
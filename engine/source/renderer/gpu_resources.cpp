@@ -1,10 +1,12 @@
 #include <renderer/gpu_resources.hpp>
 
+#include <algorithm>
+
 namespace fizzengine {
-void DescriptorLayoutBuilder::add_binding(uint32_t binding, VkDescriptorType type) {
+void DescriptorLayoutBuilder::add_binding(uint32_t binding, VkDescriptorType type, uint32_t count) {
     VkDescriptorSetLayoutBinding newbind{};
     newbind.binding         = binding;
-    newbind.descriptorCount = 1;
+    newbind.descriptorCount = count;
     newbind.descriptorType  = type;
 
     bindings.push_back(newbind);
@@ -35,43 +37,139 @@ VkDescriptorSetLayout DescriptorLayoutBuilder::build(VkDevice           device,
     return set;
 }
 
-void DescriptorAllocator::init_pool(VkDevice device, uint32_t max_sets,
-                                    std::span<PoolSizeRatio> pool_ratios) {
+void DescriptorAllocator::init(VkDevice device_, u32 initial_sets,
+                               std::span<PoolSizeRatio> pool_ratios) {
+    device        = device_;
+    sets_per_pool = initial_sets;
+    ratios.assign(pool_ratios.begin(), pool_ratios.end());
+}
+
+void DescriptorAllocator::clear_pools() {
+    for (VkDescriptorPool pool : ready_pools) {
+        vkResetDescriptorPool(device, pool, 0);
+    }
+    for (VkDescriptorPool pool : full_pools) {
+        vkResetDescriptorPool(device, pool, 0);
+        ready_pools.push_back(pool);
+    }
+    full_pools.clear();
+}
+
+void DescriptorAllocator::destroy_pools() {
+    for (VkDescriptorPool pool : ready_pools) {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    for (VkDescriptorPool pool : full_pools) {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    ready_pools.clear();
+    full_pools.clear();
+}
+
+VkDescriptorPool DescriptorAllocator::get_pool() {
+    if (!ready_pools.empty()) {
+        VkDescriptorPool pool = ready_pools.back();
+        ready_pools.pop_back();
+        return pool;
+    }
+
+    VkDescriptorPool pool = create_pool(sets_per_pool);
+    sets_per_pool         = std::min(sets_per_pool * k_growth_factor, k_max_sets_per_pool);
+    return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::create_pool(u32 set_count) {
     std::vector<VkDescriptorPoolSize> poolSizes;
-    for (PoolSizeRatio ratio : pool_ratios) {
+    for (PoolSizeRatio ratio : ratios) {
         poolSizes.push_back(VkDescriptorPoolSize{
-            .type = ratio.type, .descriptorCount = uint32_t(ratio.ratio * max_sets)});
+            .type            = ratio.type,
+            .descriptorCount = std::max(uint32_t(ratio.ratio * set_count), 1u)});
     }
 
     VkDescriptorPoolCreateInfo pool_info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
     pool_info.flags                      = 0;
-    pool_info.maxSets                    = max_sets;
+    pool_info.maxSets                    = set_count;
     pool_info.poolSizeCount              = (uint32_t)poolSizes.size();
     pool_info.pPoolSizes                 = poolSizes.data();
 
-    vkCreateDescriptorPool(device, &pool_info, nullptr, &pool);
+    VkDescriptorPool pool;
+    VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &pool));
+    return pool;
 }
 
-void DescriptorAllocator::clear_descriptors(VkDevice device) {
-    vkResetDescriptorPool(device, pool, 0);
-}
-
-void DescriptorAllocator::destroy_pool(VkDevice device) {
-    vkDestroyDescriptorPool(device, pool, nullptr);
-}
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout, void* pNext) {
+    VkDescriptorPool            pool      = get_pool();
 
-VkDescriptorSet DescriptorAllocator::allocate(VkDevice device, VkDescriptorSetLayout layout) {
     VkDescriptorSetAllocateInfo allocInfo = {.sType =
                                                  VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-    allocInfo.pNext                       = nullptr;
+    allocInfo.pNext                       = pNext;
     allocInfo.descriptorPool              = pool;
     allocInfo.descriptorSetCount          = 1;
     allocInfo.pSetLayouts                 = &layout;
 
     VkDescriptorSet ds;
-    VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &ds));
+    VkResult        result = vkAllocateDescriptorSets(device, &allocInfo, &ds);
+
+    // The pool is exhausted, park it and retry once on a fresh, larger pool
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        full_pools.push_back(pool);
 
+        pool                     = get_pool();
+        allocInfo.descriptorPool = pool;
+        VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &ds));
+    } else {
+        VK_CHECK(result);
+    }
+
+    ready_pools.push_back(pool);
     return ds;
 }
 
-} // namespace fizzengine
\ No newline at end of file
+void DescriptorWriter::write_image(VkDescriptorSet set, u32 binding, VkImageView image,
+                                   VkSampler sampler, VkImageLayout layout, VkDescriptorType type,
+                                   u32 array_element) {
+    VkDescriptorImageInfo& info =
+        image_infos.emplace_back(VkDescriptorImageInfo{sampler, image, layout});
+
+    VkWriteDescriptorSet write = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet               = set;
+    write.dstBinding           = binding;
+    write.dstArrayElement      = array_element;
+    write.descriptorCount      = 1;
+    write.descriptorType       = type;
+    write.pImageInfo           = &info;
+
+    writes.push_back(write);
+}
+
+void DescriptorWriter::write_buffer(VkDescriptorSet set, u32 binding, VkBuffer buffer,
+                                    VkDeviceSize size, VkDeviceSize offset, VkDescriptorType type,
+                                    u32 array_element) {
+    VkDescriptorBufferInfo& info =
+        buffer_infos.emplace_back(VkDescriptorBufferInfo{buffer, offset, size});
+
+    VkWriteDescriptorSet write = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet               = set;
+    write.dstBinding           = binding;
+    write.dstArrayElement      = array_element;
+    write.descriptorCount      = 1;
+    write.descriptorType       = type;
+    write.pBufferInfo          = &info;
+
+    writes.push_back(write);
+}
+
+void DescriptorWriter::clear() {
+    image_infos.clear();
+    buffer_infos.clear();
+    writes.clear();
+}
+
+void DescriptorWriter::flush(VkDevice device) {
+    if (!writes.empty()) {
+        vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+    }
+    clear();
+}
+
+} // namespace fizzengine
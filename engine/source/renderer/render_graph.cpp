@@ -0,0 +1,471 @@
+#include <renderer/gpu_profiler.hpp>
+#include <renderer/render_graph.hpp>
+#include <renderer/vk_initializers.hpp>
+
+#include <algorithm>
+
+namespace fizzengine {
+
+// clang-format off
+static const RenderGraphUsageInfo k_usage_infos[k_usage_count] = {
+    // undefined
+    {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, false, true},
+    // compute_sampled
+    {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, false},
+    // compute_storage_read
+    {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+     VK_IMAGE_LAYOUT_GENERAL, false, false},
+    // compute_storage_write
+    {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+     VK_IMAGE_LAYOUT_GENERAL, true, true},
+    // compute_storage_read_write
+    {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+     VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+     VK_IMAGE_LAYOUT_GENERAL, true, false},
+    // fragment_sampled
+    {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, false},
+    // color_attachment
+    {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+     VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+     VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, false},
+    // depth_attachment
+    {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+     VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+     VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, true, false},
+    // transfer_src
+    {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false, false},
+    // transfer_dst
+    {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true, false},
+    // present, the stage chains the transition to the render complete semaphore signal
+    {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE,
+     VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false, false},
+};
+// clang-format on
+
+static const VkAccessFlags2 k_write_accesses =
+    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+const RenderGraphUsageInfo& get_usage_info(RenderGraphUsage usage) {
+    return k_usage_infos[usage];
+}
+
+static VkImageUsageFlags get_image_usage_flags(RenderGraphUsage usage) {
+    switch (usage) {
+    case k_usage_compute_sampled:
+    case k_usage_fragment_sampled:
+        return VK_IMAGE_USAGE_SAMPLED_BIT;
+    case k_usage_compute_storage_read:
+    case k_usage_compute_storage_write:
+    case k_usage_compute_storage_read_write:
+        return VK_IMAGE_USAGE_STORAGE_BIT;
+    case k_usage_color_attachment:
+        return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    case k_usage_depth_attachment:
+        return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    case k_usage_transfer_src:
+        return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    case k_usage_transfer_dst:
+        return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    default:
+        return 0;
+    }
+}
+
+void RenderGraph::init(VkDevice device_, VmaAllocator vma_allocator_, u32 frame_count_) {
+    device        = device_;
+    vma_allocator = vma_allocator_;
+    frame_count   = std::min(frame_count_, k_max_frames);
+}
+
+void RenderGraph::shutdown() {
+    for (u32 i = 0; i < frame_count; ++i) {
+        destroy_transients(heaps[i]);
+    }
+    passes.clear();
+    resources.clear();
+    imported_states.clear();
+}
+
+void RenderGraph::begin(u32 frame_index_) {
+    frame_index = frame_index_ % frame_count;
+    passes.clear();
+    resources.clear();
+    final_barriers.clear();
+    culled_pass_count = 0;
+    barrier_count     = 0;
+}
+
+RenderGraphResource RenderGraph::import_image(cstring name, VkImage image, VkImageView view,
+                                              VkImageAspectFlags aspect,
+                                              RenderGraphUsage   initial_usage) {
+    Resource resource{};
+    resource.name     = name;
+    resource.image    = image;
+    resource.view     = view;
+    resource.aspect   = aspect;
+    resource.imported = true;
+
+    if (initial_usage != k_usage_count) {
+        const RenderGraphUsageInfo& info = get_usage_info(initial_usage);
+        resource.state                   = {info.stage, info.access, info.layout, info.write};
+    } else if (auto it = imported_states.find(image); it != imported_states.end()) {
+        resource.state = it->second;
+    }
+
+    resources.push_back(resource);
+    return (RenderGraphResource)(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::create_image(cstring name, const RenderGraphImageDesc& desc) {
+    Resource resource{};
+    resource.name     = name;
+    resource.aspect   = desc.aspect;
+    resource.imported = false;
+    resource.desc     = desc;
+
+    resources.push_back(resource);
+    return (RenderGraphResource)(resources.size() - 1);
+}
+
+void RenderGraph::set_final_usage(RenderGraphResource resource, RenderGraphUsage usage) {
+    resources[resource].final_usage = usage;
+}
+
+u32 RenderGraph::add_pass(cstring name, ExecuteFunction&& execute, bool side_effect) {
+    Pass pass{};
+    pass.name        = name;
+    pass.execute     = std::move(execute);
+    pass.side_effect = side_effect;
+    passes.push_back(std::move(pass));
+    return (u32)(passes.size() - 1);
+}
+
+void RenderGraph::read(u32 pass, RenderGraphResource resource, RenderGraphUsage usage) {
+    passes[pass].accesses.push_back({resource, usage, false});
+}
+
+void RenderGraph::write(u32 pass, RenderGraphResource resource, RenderGraphUsage usage) {
+    passes[pass].accesses.push_back({resource, usage, true});
+}
+
+void RenderGraph::forget_image(VkImage image) {
+    imported_states.erase(image);
+}
+
+VkImage RenderGraph::get_image(RenderGraphResource resource) const {
+    return resources[resource].image;
+}
+
+VkImageView RenderGraph::get_image_view(RenderGraphResource resource) const {
+    return resources[resource].view;
+}
+
+void RenderGraph::cull_passes() {
+    // Walk backwards. A pass survives when it has side effects, writes an imported image, or
+    // writes something a surviving pass reads later on. A write that discards the contents
+    // satisfies every later reader, so earlier writers of that image are not needed for them.
+    std::vector<bool> needed(resources.size(), false);
+    for (u32 i = (u32)passes.size(); i-- > 0;) {
+        Pass& pass = passes[i];
+        bool  keep = pass.side_effect;
+        for (const Access& access : pass.accesses) {
+            if (access.write && (resources[access.resource].imported || needed[access.resource])) {
+                keep = true;
+            }
+        }
+
+        pass.culled = !keep;
+        if (!keep) {
+            ++culled_pass_count;
+            continue;
+        }
+
+        for (const Access& access : pass.accesses) {
+            if (access.write && get_usage_info(access.usage).discard) {
+                needed[access.resource] = false;
+            }
+        }
+        for (const Access& access : pass.accesses) {
+            if (!access.write || !get_usage_info(access.usage).discard) {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::destroy_transients(TransientHeap& heap) {
+    for (VkImageView view : heap.views) {
+        vkDestroyImageView(device, view, nullptr);
+    }
+    for (VkImage image : heap.images) {
+        untrack_image_layout(image);
+        vkDestroyImage(device, image, nullptr);
+    }
+    if (heap.allocation != VK_NULL_HANDLE) {
+        vmaFreeMemory(vma_allocator, heap.allocation);
+    }
+    heap = TransientHeap{};
+}
+
+void RenderGraph::allocate_transients() {
+    // Lifetimes and usage flags over the passes that survived culling
+    for (u32 i = 0; i < (u32)passes.size(); ++i) {
+        if (passes[i].culled) {
+            continue;
+        }
+        for (const Access& access : passes[i].accesses) {
+            Resource& resource = resources[access.resource];
+            if (resource.imported) {
+                continue;
+            }
+            const RenderGraphUsageInfo& info = get_usage_info(access.usage);
+            resource.first_pass              = std::min(resource.first_pass, i);
+            resource.last_pass               = std::max(resource.last_pass, i);
+            resource.usage_flags |= get_image_usage_flags(access.usage);
+            resource.used.stage |= info.stage;
+            resource.used.access |= info.access & k_write_accesses;
+        }
+    }
+
+    std::vector<u32>                transients;
+    std::vector<TransientHeap::Key> keys;
+    for (u32 i = 0; i < (u32)resources.size(); ++i) {
+        const Resource& resource = resources[i];
+        if (!resource.imported && resource.usage_flags != 0) {
+            transients.push_back(i);
+            keys.push_back({resource.desc, resource.usage_flags, resource.first_pass,
+                            resource.last_pass});
+        }
+    }
+
+    // Same transients with the same lifetimes as the last time this frame slot ran, the images
+    // and their placement are still valid
+    TransientHeap& heap = heaps[frame_index];
+    if (heap.keys != keys) {
+        destroy_transients(heap);
+        heap.keys = keys;
+
+        std::vector<VkMemoryRequirements> requirements(transients.size());
+        for (u32 t = 0; t < (u32)transients.size(); ++t) {
+            const Resource&   resource = resources[transients[t]];
+            VkImageCreateInfo image_info =
+                vkinit::image_create_info(resource.desc.format, resource.usage_flags,
+                                          {resource.desc.width, resource.desc.height, 1});
+            VkImage image;
+            VK_CHECK(vkCreateImage(device, &image_info, nullptr, &image));
+            track_image_layout(image, 1, 1);
+            vkGetImageMemoryRequirements(device, image, &requirements[t]);
+            heap.images.push_back(image);
+        }
+
+        // Largest first, each image goes to the lowest offset that does not overlap an image
+        // whose lifetime overlaps its own
+        std::vector<u32> order(transients.size());
+        for (u32 t = 0; t < (u32)order.size(); ++t) {
+            order[t] = t;
+        }
+        std::sort(order.begin(), order.end(),
+                  [&](u32 a, u32 b) { return requirements[a].size > requirements[b].size; });
+
+        std::vector<VkDeviceSize> offsets(transients.size(), 0);
+        auto                      overlaps_memory = [&](u32 a, VkDeviceSize offset, u32 b) {
+            return offset < offsets[b] + requirements[b].size &&
+                   offsets[b] < offset + requirements[a].size;
+        };
+
+        std::vector<u32>          placed;
+        VkMemoryRequirements      total{0, 1, ~0u};
+        for (u32 t : order) {
+            const Resource&      resource = resources[transients[t]];
+            const VkDeviceSize   size     = requirements[t].size;
+            const VkDeviceSize   align    = requirements[t].alignment;
+
+            auto overlaps_lifetime = [&](u32 other) {
+                const Resource& o = resources[transients[other]];
+                return o.first_pass <= resource.last_pass && resource.first_pass <= o.last_pass;
+            };
+
+            std::vector<VkDeviceSize> candidates = {0};
+            for (u32 other : placed) {
+                if (overlaps_lifetime(other)) {
+                    candidates.push_back(offsets[other] + requirements[other].size);
+                }
+            }
+            std::sort(candidates.begin(), candidates.end());
+
+            for (VkDeviceSize candidate : candidates) {
+                const VkDeviceSize offset = (candidate + align - 1) / align * align;
+                bool               fits   = true;
+                for (u32 other : placed) {
+                    if (overlaps_lifetime(other) && overlaps_memory(t, offset, other)) {
+                        fits = false;
+                        break;
+                    }
+                }
+                if (fits) {
+                    offsets[t] = offset;
+                    break;
+                }
+            }
+
+            placed.push_back(t);
+            total.size           = std::max(total.size, offsets[t] + size);
+            total.alignment      = std::max(total.alignment, align);
+            total.memoryTypeBits &= requirements[t].memoryTypeBits;
+        }
+
+        heap.offsets = offsets;
+        heap.sizes.resize(transients.size());
+        for (u32 t = 0; t < (u32)transients.size(); ++t) {
+            heap.sizes[t] = requirements[t].size;
+        }
+
+        if (!transients.empty()) {
+            VmaAllocationCreateInfo allocation_info{};
+            allocation_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            VK_CHECK(vmaAllocateMemory(vma_allocator, &total, &allocation_info, &heap.allocation,
+                                       nullptr));
+        }
+        for (u32 t = 0; t < (u32)transients.size(); ++t) {
+            const Resource& resource = resources[transients[t]];
+            VK_CHECK(vmaBindImageMemory2(vma_allocator, heap.allocation, offsets[t],
+                                         heap.images[t], nullptr));
+
+            VkImageViewCreateInfo view_info = vkinit::imageview_create_info(
+                resource.desc.format, heap.images[t], resource.desc.aspect);
+            VkImageView view;
+            VK_CHECK(vkCreateImageView(device, &view_info, nullptr, &view));
+            heap.views.push_back(view);
+        }
+    }
+
+    // An image taking over memory from earlier images has to wait for their last use. Stages and
+    // accesses are not part of the key, so this is redone every compile, it is only a few pairs.
+    for (u32 t = 0; t < (u32)transients.size(); ++t) {
+        Resource& resource         = resources[transients[t]];
+        resource.image             = heap.images[t];
+        resource.view              = heap.views[t];
+        resource.alias_predecessor = State{};
+        for (u32 other = 0; other < (u32)transients.size(); ++other) {
+            const Resource& o = resources[transients[other]];
+            if (other != t && heap.offsets[t] < heap.offsets[other] + heap.sizes[other] &&
+                heap.offsets[other] < heap.offsets[t] + heap.sizes[t] &&
+                o.last_pass < resource.first_pass) {
+                resource.alias_predecessor.stage |= o.used.stage;
+                resource.alias_predecessor.access |= o.used.access;
+                resource.alias_predecessor.write = true;
+            }
+        }
+        // Contents never survive the frame
+        resource.state        = resource.alias_predecessor;
+        resource.state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+}
+
+void RenderGraph::add_barrier(BarrierBuilder& barriers, Resource& resource, const State& next,
+                              bool discard) {
+    State& previous = resource.state;
+
+    // Reads in the same layout need no barrier, they only widen what the next writer waits on
+    if (previous.layout == next.layout && !previous.write && !next.write) {
+        previous.stage |= next.stage;
+        previous.access |= next.access;
+        return;
+    }
+
+    // With nothing to wait on, chain to the first stage that uses the image. That keeps the
+    // transition behind a semaphore wait on that stage, as with a freshly acquired swapchain image.
+    VkPipelineStageFlags2 src_stage =
+        previous.stage != VK_PIPELINE_STAGE_2_NONE ? previous.stage : next.stage;
+    // Write after read only needs the execution dependency
+    VkAccessFlags2 src_access =
+        previous.write ? previous.access & k_write_accesses : VK_ACCESS_2_NONE;
+    barriers.image(resource.image, discard ? VK_IMAGE_LAYOUT_UNDEFINED : previous.layout,
+                   next.layout, src_stage, src_access, next.stage, next.access,
+                   subresource_range(resource.aspect));
+    ++barrier_count;
+
+    previous = next;
+}
+
+void RenderGraph::compile() {
+    cull_passes();
+    allocate_transients();
+
+    for (Pass& pass : passes) {
+        if (pass.culled) {
+            continue;
+        }
+
+        // A pass may touch an image more than once, e.g. read and write it. Those accesses share
+        // one state, so they have to agree on the layout.
+        for (sizet a = 0; a < pass.accesses.size(); ++a) {
+            const Access& access   = pass.accesses[a];
+            bool          repeated = false;
+            for (sizet b = 0; b < a; ++b) {
+                repeated |= pass.accesses[b].resource == access.resource;
+            }
+            if (repeated) {
+                continue;
+            }
+
+            State next{};
+            bool  discard = true;
+            for (sizet b = a; b < pass.accesses.size(); ++b) {
+                if (pass.accesses[b].resource != access.resource) {
+                    continue;
+                }
+                const RenderGraphUsageInfo& info = get_usage_info(pass.accesses[b].usage);
+                if (b != a && info.layout != next.layout) {
+                    spdlog::error("Render graph pass {} uses {} in two layouts", pass.name,
+                                  resources[access.resource].name);
+                }
+                next.stage |= info.stage;
+                next.access |= info.access;
+                next.layout = info.layout;
+                next.write |= info.write;
+                discard &= info.discard;
+            }
+
+            add_barrier(pass.barriers, resources[access.resource], next, discard);
+        }
+    }
+
+    for (Resource& resource : resources) {
+        if (!resource.imported) {
+            continue;
+        }
+        if (resource.final_usage != k_usage_count) {
+            const RenderGraphUsageInfo& info = get_usage_info(resource.final_usage);
+            add_barrier(final_barriers, resource,
+                        {info.stage, info.access, info.layout, info.write}, false);
+        }
+        imported_states[resource.image] = resource.state;
+    }
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd, GPUProfiler* profiler) {
+    for (Pass& pass : passes) {
+        if (pass.culled) {
+            continue;
+        }
+
+        pass.barriers.record(cmd);
+
+        if (profiler) {
+            GPUProfileScope scope(*profiler, cmd, pass.name);
+            pass.execute(cmd);
+        } else {
+            pass.execute(cmd);
+        }
+    }
+
+    final_barriers.record(cmd);
+}
+
+} // namespace fizzengine
@@ -0,0 +1,242 @@
+#include <renderer/shader_hot_reload.hpp>
+#include <renderer/vk_utils.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+#if defined(FIZZ_PLATFORM_LINUX)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fizzengine {
+
+// Editors tend to save in several writes, wait this long for the burst to settle
+static const std::chrono::milliseconds k_settle_time{50};
+static const std::chrono::milliseconds k_poll_interval{250};
+
+static i64 get_file_timestamp(const std::string& path) {
+    std::error_code error;
+    auto            time = std::filesystem::last_write_time(path, error);
+    return error ? 0 : (i64)time.time_since_epoch().count();
+}
+
+void ShaderHotReload::init(VkDevice device_, VkPipelineCache pipeline_cache_) {
+    device         = device_;
+    pipeline_cache = pipeline_cache_;
+
+#if defined(FIZZ_PLATFORM_LINUX)
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        spdlog::warn("inotify unavailable, shader hot reload falls back to polling");
+    }
+#endif
+
+    running.store(true, std::memory_order_release);
+    thread = std::thread([this]() { watch_loop(); });
+}
+
+void ShaderHotReload::shutdown() {
+    running.store(false, std::memory_order_release);
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+#if defined(FIZZ_PLATFORM_LINUX)
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+#endif
+
+    // Rebuilt pipelines that never got swapped in
+    std::lock_guard lock(mutex);
+    for (ReloadedPipeline& entry : reloaded) {
+        vkDestroyPipeline(device, entry.pipeline, nullptr);
+    }
+    reloaded.clear();
+    pipelines.clear();
+}
+
+void ShaderHotReload::watch_compute_pipeline(const char* path, const char* entry_point,
+                                             VkPipelineLayout layout, VkPipeline* pipeline) {
+    WatchedPipeline watched{.path        = path,
+                            .entry_point = entry_point,
+                            .stage       = VK_SHADER_STAGE_COMPUTE_BIT,
+                            .layout      = layout,
+                            .pipeline    = pipeline};
+    vkutil::collect_shader_dependencies(path, watched.dependencies);
+
+    std::lock_guard lock(mutex);
+    for (const std::string& dependency : watched.dependencies) {
+        watch_file(dependency);
+    }
+    pipelines.push_back(std::move(watched));
+}
+
+void ShaderHotReload::watch_file(const std::string& path) {
+    file_timestamps.try_emplace(path, get_file_timestamp(path));
+
+#if defined(FIZZ_PLATFORM_LINUX)
+    if (inotify_fd < 0) {
+        return;
+    }
+
+    // Watch directories rather than files, editors often replace a file instead of writing it
+    std::string directory = std::filesystem::path(path).parent_path().generic_string();
+    if (directory.empty()) {
+        directory = ".";
+    }
+    for (const auto& [descriptor, watched] : watch_directories) {
+        if (watched == directory) {
+            return;
+        }
+    }
+
+    const int descriptor =
+        inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (descriptor >= 0) {
+        watch_directories[descriptor] = directory;
+    }
+#endif
+}
+
+void ShaderHotReload::apply_reloaded(std::vector<VkPipeline>& out_retired) {
+    std::lock_guard lock(mutex);
+    for (ReloadedPipeline& entry : reloaded) {
+        out_retired.push_back(*entry.target);
+        *entry.target = entry.pipeline;
+    }
+    reloaded.clear();
+}
+
+void ShaderHotReload::watch_loop() {
+    std::vector<std::string> changed_paths;
+
+    while (running.load(std::memory_order_acquire)) {
+        changed_paths.clear();
+
+#if defined(FIZZ_PLATFORM_LINUX)
+        if (inotify_fd >= 0) {
+            pollfd poll_fd{.fd = inotify_fd, .events = POLLIN};
+            if (poll(&poll_fd, 1, (int)k_poll_interval.count()) <= 0) {
+                continue;
+            }
+            std::this_thread::sleep_for(k_settle_time);
+
+            alignas(inotify_event) char buffer[4096];
+            ssize_t                     length;
+            while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+                for (char* cursor = buffer; cursor < buffer + length;) {
+                    const inotify_event* event = reinterpret_cast<inotify_event*>(cursor);
+                    cursor += sizeof(inotify_event) + event->len;
+                    if (event->len == 0) {
+                        continue;
+                    }
+
+                    std::lock_guard lock(mutex);
+                    auto            directory = watch_directories.find(event->wd);
+                    if (directory != watch_directories.end()) {
+                        changed_paths.push_back(
+                            (std::filesystem::path(directory->second) / event->name)
+                                .lexically_normal()
+                                .generic_string());
+                    }
+                }
+            }
+        } else
+#endif
+        {
+            std::this_thread::sleep_for(k_poll_interval);
+
+            std::lock_guard lock(mutex);
+            for (auto& [path, timestamp] : file_timestamps) {
+                const i64 current = get_file_timestamp(path);
+                if (current != timestamp) {
+                    timestamp = current;
+                    changed_paths.push_back(path);
+                }
+            }
+        }
+
+        if (!changed_paths.empty()) {
+            reload(changed_paths);
+        }
+    }
+}
+
+void ShaderHotReload::reload(const std::vector<std::string>& changed_paths) {
+    // Copy out the affected pipelines so compiles run without holding the lock
+    std::vector<WatchedPipeline> affected;
+    {
+        std::lock_guard lock(mutex);
+        for (const WatchedPipeline& watched : pipelines) {
+            const bool depends = std::any_of(
+                changed_paths.begin(), changed_paths.end(), [&](const std::string& changed) {
+                    return std::find(watched.dependencies.begin(), watched.dependencies.end(),
+                                     changed) != watched.dependencies.end();
+                });
+            if (depends) {
+                affected.push_back(watched);
+            }
+        }
+    }
+
+    for (WatchedPipeline& watched : affected) {
+        spdlog::info("Reloading {} ({})", watched.path, watched.entry_point);
+
+        VkPipeline pipeline = build_compute_pipeline(watched);
+        // Includes may have been added or removed by the edit
+        vkutil::collect_shader_dependencies(watched.path.c_str(), watched.dependencies);
+
+        std::lock_guard lock(mutex);
+        for (const std::string& dependency : watched.dependencies) {
+            watch_file(dependency);
+        }
+        for (WatchedPipeline& registered : pipelines) {
+            if (registered.pipeline == watched.pipeline) {
+                registered.dependencies = watched.dependencies;
+            }
+        }
+        if (pipeline != VK_NULL_HANDLE) {
+            reloaded.push_back({.target = watched.pipeline, .pipeline = pipeline});
+        }
+    }
+}
+
+VkPipeline ShaderHotReload::build_compute_pipeline(WatchedPipeline& watched) {
+    std::vector<uint32_t> spirv;
+    if (!vkutil::compile_slang_to_spirv(watched.path.c_str(), watched.entry_point.c_str(),
+                                        watched.stage, spirv)) {
+        // Keep running the old pipeline, the error was already logged
+        return VK_NULL_HANDLE;
+    }
+
+    VkShaderModule                  module = vkutil::create_shader_module(device, spirv);
+
+    VkPipelineShaderStageCreateInfo stage_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    stage_info.stage  = watched.stage;
+    stage_info.module = module;
+    stage_info.pName  = watched.entry_point.c_str();
+
+    VkComputePipelineCreateInfo pipeline_info{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    pipeline_info.layout = watched.layout;
+    pipeline_info.stage  = stage_info;
+
+    VkPipeline pipeline  = VK_NULL_HANDLE;
+    VkResult   result =
+        vkCreateComputePipelines(device, pipeline_cache, 1, &pipeline_info, nullptr, &pipeline);
+    vkDestroyShaderModule(device, module, nullptr);
+
+    if (result != VK_SUCCESS) {
+        spdlog::error("Failed to rebuild {}: {}", watched.path, string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+    return pipeline;
+}
+
+} // namespace fizzengine
@@ -0,0 +1,256 @@
+#include <renderer/upload_manager.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace fizzengine {
+
+void UploadManager::init(VkDevice device_, VmaAllocator vma_allocator_, u32 frame_count_,
+                         VkDeviceSize ring_size_) {
+    device        = device_;
+    vma_allocator = vma_allocator_;
+    frame_count   = std::min(frame_count_, k_max_frames);
+    ring_size     = ring_size_;
+
+    VkBufferCreateInfo buffer_info{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.size  = ring_size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+    allocation_info.flags =
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo mapped{};
+    VK_CHECK(vmaCreateBuffer(vma_allocator, &buffer_info, &allocation_info, &ring_buffer,
+                             &ring_allocation, &mapped));
+    ring_data = static_cast<u8*>(mapped.pMappedData);
+}
+
+void UploadManager::shutdown() {
+    for (u32 i = 0; i < frame_count; ++i) {
+        begin_frame(i);
+    }
+    for (StagingBuffer& staging : pending_staging) {
+        vmaDestroyBuffer(vma_allocator, staging.buffer, staging.allocation);
+    }
+    pending_staging.clear();
+    buffer_copies.clear();
+    image_copies.clear();
+
+    vmaDestroyBuffer(vma_allocator, ring_buffer, ring_allocation);
+}
+
+void UploadManager::begin_frame(u32 frame_index) {
+    std::lock_guard lock(mutex);
+    // Everything that frame copied from has been consumed. Fences signal in submission order, so
+    // the tail only moves forward.
+    ring_tail = std::max(ring_tail, frame_heads[frame_index]);
+
+    for (StagingBuffer& staging : retired_staging[frame_index]) {
+        vmaDestroyBuffer(vma_allocator, staging.buffer, staging.allocation);
+    }
+    retired_staging[frame_index].clear();
+}
+
+bool UploadManager::allocate_ring(VkDeviceSize size, VkDeviceSize& out_offset) {
+    u64 start = (ring_head + k_staging_alignment - 1) & ~(k_staging_alignment - 1);
+    // Never split an allocation across the end of the ring, skip to the start instead
+    if (start % ring_size + size > ring_size) {
+        start = (start / ring_size + 1) * ring_size;
+    }
+    if (start + size - ring_tail > ring_size) {
+        return false;
+    }
+
+    ring_head  = start + size;
+    out_offset = start % ring_size;
+    return true;
+}
+
+void UploadManager::stage(const void* data, VkDeviceSize size, VkBuffer& out_buffer,
+                          VkDeviceSize& out_offset) {
+    if (size <= ring_size / 2 && allocate_ring(size, out_offset)) {
+        memcpy(ring_data + out_offset, data, size);
+        vmaFlushAllocation(vma_allocator, ring_allocation, out_offset, size);
+        out_buffer = ring_buffer;
+        return;
+    }
+
+    // Too large for the ring or the ring is still busy, stage through a buffer of its own
+    VkBufferCreateInfo buffer_info{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.size  = size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+    allocation_info.flags =
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    StagingBuffer     staging;
+    VmaAllocationInfo mapped{};
+    VK_CHECK(vmaCreateBuffer(vma_allocator, &buffer_info, &allocation_info, &staging.buffer,
+                             &staging.allocation, &mapped));
+    memcpy(mapped.pMappedData, data, size);
+    vmaFlushAllocation(vma_allocator, staging.allocation, 0, size);
+
+    pending_staging.push_back(staging);
+    out_buffer = staging.buffer;
+    out_offset = 0;
+}
+
+void UploadManager::upload_buffer(VkBuffer destination, VkDeviceSize destination_offset,
+                                  const void* data, VkDeviceSize size) {
+    if (size == 0) {
+        return;
+    }
+
+    std::lock_guard lock(mutex);
+    BufferCopy      copy{.destination = destination, .destination_offset = destination_offset,
+                         .size = size};
+    stage(data, size, copy.source, copy.source_offset);
+    buffer_copies.push_back(copy);
+}
+
+void UploadManager::upload_image(VkImage destination, VkExtent3D extent, const void* data,
+                                 VkDeviceSize size, VkImageLayout final_layout) {
+    std::lock_guard lock(mutex);
+    ImageCopy copy{.destination = destination, .extent = extent, .final_layout = final_layout};
+    stage(data, size, copy.source, copy.source_offset);
+    image_copies.push_back(copy);
+}
+
+bool UploadManager::claim_range(const BufferCopy& copy) {
+    // Claimed ranges of a buffer are disjoint, only the neighbours can overlap
+    const auto key  = std::make_pair(copy.destination, copy.destination_offset);
+    const auto next = written_ranges.lower_bound(key);
+    if (next != written_ranges.end() && next->first.first == copy.destination &&
+        next->first.second < copy.destination_offset + copy.size) {
+        return false;
+    }
+    if (next != written_ranges.begin()) {
+        const auto previous = std::prev(next);
+        if (previous->first.first == copy.destination &&
+            previous->second > copy.destination_offset) {
+            return false;
+        }
+    }
+    written_ranges.emplace_hint(next, key, copy.destination_offset + copy.size);
+    return true;
+}
+
+void UploadManager::record_buffer_copies(VkCommandBuffer cmd, sizet begin, sizet end) {
+    // Nothing in the run overlaps, so it is grouped into one command per source and destination
+    std::stable_sort(buffer_copies.begin() + begin, buffer_copies.begin() + end,
+                     [](const BufferCopy& a, const BufferCopy& b) {
+                         return a.destination != b.destination ? a.destination < b.destination
+                                                               : a.source < b.source;
+                     });
+
+    while (begin < end) {
+        sizet group_end = begin;
+        copy_regions.clear();
+        while (group_end < end &&
+               buffer_copies[group_end].destination == buffer_copies[begin].destination &&
+               buffer_copies[group_end].source == buffer_copies[begin].source) {
+            VkBufferCopy2 region{.sType = VK_STRUCTURE_TYPE_BUFFER_COPY_2};
+            region.srcOffset = buffer_copies[group_end].source_offset;
+            region.dstOffset = buffer_copies[group_end].destination_offset;
+            region.size      = buffer_copies[group_end].size;
+            copy_regions.push_back(region);
+            ++group_end;
+        }
+
+        VkCopyBufferInfo2 copy_info{.sType = VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2};
+        copy_info.srcBuffer   = buffer_copies[begin].source;
+        copy_info.dstBuffer   = buffer_copies[begin].destination;
+        copy_info.regionCount = (u32)copy_regions.size();
+        copy_info.pRegions    = copy_regions.data();
+        vkCmdCopyBuffer2(cmd, &copy_info);
+
+        begin = group_end;
+    }
+}
+
+void UploadManager::flush(VkCommandBuffer cmd, u32 frame_index) {
+    std::lock_guard lock(mutex);
+    frame_heads[frame_index] = ring_head;
+
+    retired_staging[frame_index].insert(retired_staging[frame_index].end(),
+                                        pending_staging.begin(), pending_staging.end());
+    pending_staging.clear();
+
+    if (buffer_copies.empty() && image_copies.empty()) {
+        return;
+    }
+
+    // Images to transfer destination, contents are discarded
+    for (const ImageCopy& copy : image_copies) {
+        barriers.image(copy.destination, VK_IMAGE_LAYOUT_UNDEFINED,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_NONE,
+                       VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    }
+    // Buffers may still be read or written by earlier submissions
+    if (!buffer_copies.empty()) {
+        barriers.memory(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+                        VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    }
+    barriers.flush(cmd);
+
+    // Copies apply in the order they were queued. A run of copies that write disjoint ranges can
+    // be recorded in any order, a copy overlapping an earlier one of the run starts the next run
+    // behind a barrier, so the later upload wins.
+    sizet run_begin = 0;
+    written_ranges.clear();
+    for (sizet i = 0; i < buffer_copies.size(); ++i) {
+        if (claim_range(buffer_copies[i])) {
+            continue;
+        }
+        record_buffer_copies(cmd, run_begin, i);
+        barriers.memory(VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+        barriers.flush(cmd);
+
+        run_begin = i;
+        written_ranges.clear();
+        claim_range(buffer_copies[i]);
+    }
+    record_buffer_copies(cmd, run_begin, buffer_copies.size());
+
+    for (const ImageCopy& copy : image_copies) {
+        VkBufferImageCopy2 region{.sType = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2};
+        region.bufferOffset                    = copy.source_offset;
+        region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel       = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount     = 1;
+        region.imageExtent                     = copy.extent;
+
+        VkCopyBufferToImageInfo2 copy_info{.sType = VK_STRUCTURE_TYPE_COPY_BUFFER_TO_IMAGE_INFO_2};
+        copy_info.srcBuffer      = copy.source;
+        copy_info.dstImage       = copy.destination;
+        copy_info.dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        copy_info.regionCount    = 1;
+        copy_info.pRegions       = &region;
+        vkCmdCopyBufferToImage2(cmd, &copy_info);
+    }
+
+    // Make the copies visible to everything recorded after, and move images to their final layout
+    for (const ImageCopy& copy : image_copies) {
+        barriers.image(copy.destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.final_layout,
+                       VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT);
+    }
+    if (!buffer_copies.empty()) {
+        barriers.memory(VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT);
+    }
+    barriers.flush(cmd);
+
+    buffer_copies.clear();
+    image_copies.clear();
+}
+
+} // namespace fizzengine
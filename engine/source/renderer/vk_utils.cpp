@@ -1,37 +1,19 @@
 #include <renderer/vk_initializers.hpp>
 #include <renderer/vk_utils.hpp>
 
+#include <foundation/file.hpp>
+#include <foundation/hash.hpp>
+#include <foundation/job_system.hpp>
+#if defined(FIZZ_EMBED_SHADERS)
+#include <renderer/embedded_shaders.hpp>
+#endif
 
-namespace vkutil {
-void transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout current_layout,
-                      VkImageLayout new_layout) {
-    VkImageMemoryBarrier2 image_barrier{.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
-    image_barrier.pNext            = nullptr;
-
-    image_barrier.srcStageMask     = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-    image_barrier.srcAccessMask    = VK_ACCESS_2_MEMORY_WRITE_BIT;
-    image_barrier.dstStageMask     = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-    image_barrier.dstAccessMask    = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
-
-    image_barrier.oldLayout        = current_layout;
-    image_barrier.newLayout        = new_layout;
-
-    VkImageAspectFlags aspect_mask = (new_layout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL)
-                                         ? VK_IMAGE_ASPECT_DEPTH_BIT
-                                         : VK_IMAGE_ASPECT_COLOR_BIT;
-    image_barrier.subresourceRange = vkinit::image_subresource_range(aspect_mask);
-    image_barrier.image            = image;
-
-    VkDependencyInfo dep_info{};
-    dep_info.sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-    dep_info.pNext                   = nullptr;
-
-    dep_info.imageMemoryBarrierCount = 1;
-    dep_info.pImageMemoryBarriers    = &image_barrier;
-
-    vkCmdPipelineBarrier2(cmd, &dep_info);
-}
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
 
+namespace vkutil {
 void copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage destination,
                          VkExtent2D srcSize, VkExtent2D dstSize) {
     VkImageBlit2 blit_region{.sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2, .pNext = nullptr};
@@ -66,6 +48,37 @@ void copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage destinatio
     vkCmdBlitImage2(cmd, &blit_info);
 }
 
+// Shader compilation ////////////////////////////////////////////////////
+
+#if !defined(FIZZ_EMBED_SHADERS)
+// Bump when the cache key or the way shaders are compiled changes
+static const uint32_t         k_shader_cache_version = 1;
+static const char*            k_spirv_profile        = "spirv_1_5";
+
+static std::mutex             s_slang_mutex;
+static slang::IGlobalSession* s_slang_session = nullptr;
+static std::filesystem::path  s_shader_cache_directory;
+
+void init_shader_compiler(const char* cache_directory) {
+    s_shader_cache_directory = cache_directory;
+
+    std::error_code error;
+    std::filesystem::create_directories(s_shader_cache_directory, error);
+    if (error) {
+        spdlog::warn("Shader cache disabled, cannot create {}: {}", cache_directory,
+                     error.message());
+        s_shader_cache_directory.clear();
+    }
+}
+
+void shutdown_shader_compiler() {
+    std::lock_guard lock(s_slang_mutex);
+    if (s_slang_session) {
+        s_slang_session->release();
+        s_slang_session = nullptr;
+    }
+}
+
 slang::IGlobalSession* CreateSlangSession() {
     slang::IGlobalSession* session = nullptr;
     slang::createGlobalSession(&session);
@@ -78,41 +91,151 @@ slang::ICompileRequest* CreateCompileRequest(slang::IGlobalSession* session) {
     return request;
 }
 
-VkShaderModule CompileSlangShader(VkDevice device, const char* shaderPath, const char* entryPoint,
-                                  VkShaderStageFlagBits stage) {
-    // Create Slang session
-    slang::IGlobalSession*  slangSession   = CreateSlangSession();
-    slang::ICompileRequest* compileRequest = CreateCompileRequest(slangSession);
-
-    // Setup compilation parameters
-    int                     targetIndex = compileRequest->addCodeGenTarget(SLANG_SPIRV);
-    compileRequest->setTargetProfile(targetIndex, slangSession->findProfile("spirv_1_5"));
-
-    // Add translation unit (your shader file)
-    int translationUnitIndex =
-        compileRequest->addTranslationUnit(SLANG_SOURCE_LANGUAGE_SLANG, nullptr);
-    compileRequest->addTranslationUnitSourceFile(translationUnitIndex, shaderPath);
-
-    // Map Vulkan stage to Slang stage
-    SlangStage slangStage = SLANG_STAGE_NONE;
+static SlangStage to_slang_stage(VkShaderStageFlagBits stage) {
     switch (stage) {
     case VK_SHADER_STAGE_VERTEX_BIT:
-        slangStage = SLANG_STAGE_VERTEX;
-        break;
+        return SLANG_STAGE_VERTEX;
     case VK_SHADER_STAGE_FRAGMENT_BIT:
-        slangStage = SLANG_STAGE_FRAGMENT;
-        break;
+        return SLANG_STAGE_FRAGMENT;
     case VK_SHADER_STAGE_COMPUTE_BIT:
-        slangStage = SLANG_STAGE_COMPUTE;
-        break;
+        return SLANG_STAGE_COMPUTE;
     // Add other stages as needed
     default:
         throw std::runtime_error("Unsupported shader stage");
     }
+}
+
+#endif
+
+// Only looks at the directive forms we use: #include "file" and import module.name;
+static void scan_shader_dependencies(const std::filesystem::path& path,
+                                     std::vector<std::string>&    out_paths) {
+    std::ifstream file(path);
+    if (!file) {
+        return;
+    }
+
+    const std::filesystem::path directory = path.parent_path();
+    std::string                 line;
+    while (std::getline(file, line)) {
+        const size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos) {
+            continue;
+        }
+
+        std::filesystem::path dependency;
+        if (line.compare(start, 8, "#include") == 0) {
+            const size_t open  = line.find('"', start);
+            const size_t close = line.find('"', open + 1);
+            if (open == std::string::npos || close == std::string::npos) {
+                continue;
+            }
+            dependency = directory / line.substr(open + 1, close - open - 1);
+        } else if (line.compare(start, 7, "import ") == 0) {
+            const size_t end = line.find(';', start);
+            if (end == std::string::npos) {
+                continue;
+            }
+            std::string module = line.substr(start + 7, end - start - 7);
+            module.erase(0, module.find_first_not_of(" \t"));
+            module.erase(module.find_last_not_of(" \t") + 1);
+            if (module.size() > 1 && module.front() == '"') {
+                dependency = directory / module.substr(1, module.size() - 2);
+            } else {
+                std::replace(module.begin(), module.end(), '.', '/');
+                std::replace(module.begin(), module.end(), '_', '-');
+                dependency = directory / (module + ".slang");
+                if (!std::filesystem::exists(dependency)) {
+                    // Slang maps underscores to dashes, but either spelling may be on disk
+                    std::replace(module.begin(), module.end(), '-', '_');
+                    dependency = directory / (module + ".slang");
+                }
+            }
+        } else {
+            continue;
+        }
+
+        const std::string normalized = dependency.lexically_normal().generic_string();
+        if (std::find(out_paths.begin(), out_paths.end(), normalized) == out_paths.end()) {
+            out_paths.push_back(normalized);
+            scan_shader_dependencies(normalized, out_paths);
+        }
+    }
+}
+
+void collect_shader_dependencies(const char* shaderPath, std::vector<std::string>& out_paths) {
+    out_paths.clear();
+    out_paths.push_back(std::filesystem::path(shaderPath).lexically_normal().generic_string());
+    scan_shader_dependencies(shaderPath, out_paths);
+}
+
+#if defined(FIZZ_EMBED_SHADERS)
+
+void init_shader_compiler(const char*) {
+    spdlog::info("Using {} embedded shaders", fizzengine::get_embedded_shaders().size());
+}
+
+void shutdown_shader_compiler() {
+}
+
+bool compile_slang_to_spirv(const char* shaderPath, const char* entryPoint, VkShaderStageFlagBits,
+                            std::vector<uint32_t>& out_spirv) {
+    const fizzengine::EmbeddedShader* shader =
+        fizzengine::find_embedded_shader(shaderPath, entryPoint);
+    if (!shader) {
+        spdlog::error("Shader {} ({}) was not embedded at build time", shaderPath, entryPoint);
+        return false;
+    }
+    out_spirv.assign(shader->spirv, shader->spirv + shader->word_count);
+    return true;
+}
+
+#else
+
+static uint64_t shader_cache_key(const char* shaderPath, const char* entryPoint,
+                                 VkShaderStageFlagBits stage) {
+    std::vector<std::string> dependencies;
+    collect_shader_dependencies(shaderPath, dependencies);
+
+    uint64_t             key = fizzengine::hash_bytes(&k_shader_cache_version,
+                                                      sizeof(k_shader_cache_version));
+    std::vector<uint8_t> contents;
+    for (const std::string& dependency : dependencies) {
+        // Missing includes still change the key through their path
+        key = fizzengine::hash_string(dependency.c_str(), key);
+        if (fizzengine::read_file(dependency.c_str(), contents)) {
+            key = fizzengine::hash_bytes(contents.data(), contents.size(), key);
+        }
+    }
+    key = fizzengine::hash_string(entryPoint, key);
+    key = fizzengine::hash_bytes(&stage, sizeof(stage), key);
+    key = fizzengine::hash_string(k_spirv_profile, key);
+    key = fizzengine::hash_string(spGetBuildTagString(), key);
+    return key;
+}
+
+static bool compile_with_slang(const char* shaderPath, const char* entryPoint,
+                               VkShaderStageFlagBits stage, std::vector<uint32_t>& out_spirv) {
+    std::lock_guard lock(s_slang_mutex);
+
+    // Creating the global session is the expensive part, only pay for it on a cache miss
+    if (!s_slang_session) {
+        s_slang_session = CreateSlangSession();
+    }
+    slang::ICompileRequest* compileRequest = CreateCompileRequest(s_slang_session);
+
+    // Setup compilation parameters
+    int targetIndex = compileRequest->addCodeGenTarget(SLANG_SPIRV);
+    compileRequest->setTargetProfile(targetIndex, s_slang_session->findProfile(k_spirv_profile));
+
+    // Add translation unit (your shader file)
+    int translationUnitIndex =
+        compileRequest->addTranslationUnit(SLANG_SOURCE_LANGUAGE_SLANG, nullptr);
+    compileRequest->addTranslationUnitSourceFile(translationUnitIndex, shaderPath);
 
     // Add entry point
     int entryPointIndex =
-        compileRequest->addEntryPoint(translationUnitIndex, entryPoint, slangStage);
+        compileRequest->addEntryPoint(translationUnitIndex, entryPoint, to_slang_stage(stage));
 
     // Compile
     const SlangResult compileResult = compileRequest->compile();
@@ -120,28 +243,97 @@ VkShaderModule CompileSlangShader(VkDevice device, const char* shaderPath, const
     // Check for errors
     if (SLANG_FAILED(compileResult)) {
         const char* diagnostics = compileRequest->getDiagnosticOutput();
-        printf("Shader compilation failed:\n%s\n", diagnostics);
-        return VK_NULL_HANDLE;
+        spdlog::error("Shader compilation of {} failed:\n{}", shaderPath, diagnostics);
+        compileRequest->release();
+        return false;
     }
 
     // Get compiled SPIR-V code
-    compileRequest->getEntryPointCode(entryPointIndex, 0);
+    ISlangBlob* spirvBlob = nullptr;
+    if (SLANG_FAILED(compileRequest->getEntryPointCodeBlob(entryPointIndex, targetIndex,
+                                                           &spirvBlob))) {
+        compileRequest->release();
+        return false;
+    }
+
+    const size_t wordCount = spirvBlob->getBufferSize() / sizeof(uint32_t);
+    out_spirv.resize(wordCount);
+    memcpy(out_spirv.data(), spirvBlob->getBufferPointer(), wordCount * sizeof(uint32_t));
 
-    size_t                   spirvSize = 0;
-    const void*              spirvData = compileRequest->getCompileRequestCode(&spirvSize);
+    // Cleanup Slang resources
+    spirvBlob->release();
+    compileRequest->release();
+    return true;
+}
 
+bool compile_slang_to_spirv(const char* shaderPath, const char* entryPoint,
+                            VkShaderStageFlagBits stage, std::vector<uint32_t>& out_spirv) {
+    std::filesystem::path cache_path;
+    if (!s_shader_cache_directory.empty()) {
+        char key_name[32];
+        snprintf(key_name, sizeof(key_name), "%016llx.spv",
+                 (unsigned long long)shader_cache_key(shaderPath, entryPoint, stage));
+        cache_path = s_shader_cache_directory / key_name;
+
+        std::vector<uint8_t> cached;
+        if (fizzengine::read_file(cache_path.string().c_str(), cached) && !cached.empty() &&
+            cached.size() % sizeof(uint32_t) == 0) {
+            out_spirv.resize(cached.size() / sizeof(uint32_t));
+            memcpy(out_spirv.data(), cached.data(), cached.size());
+            return true;
+        }
+    }
+
+    if (!compile_with_slang(shaderPath, entryPoint, stage, out_spirv)) {
+        return false;
+    }
+
+    if (!cache_path.empty()) {
+        fizzengine::write_file_atomic(cache_path.string().c_str(), out_spirv.data(),
+                                      out_spirv.size() * sizeof(uint32_t));
+    }
+    return true;
+}
+
+#endif
+
+void compile_slang_shaders(std::span<ShaderCompileRequest> requests,
+                           fizzengine::JobSystem*          job_system) {
+    job_system->parallel_for((uint32_t)requests.size(), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            ShaderCompileRequest& request = requests[i];
+            request.success = compile_slang_to_spirv(request.path, request.entry_point,
+                                                     request.stage, request.spirv);
+        }
+    });
+}
+
+VkShaderModule create_shader_module(VkDevice device, std::span<const uint32_t> spirv) {
     // Create Vulkan shader module
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = spirvSize;
-    createInfo.pCode    = static_cast<const uint32_t*>(spirvData);
+    createInfo.codeSize = spirv.size_bytes();
+    createInfo.pCode    = spirv.data();
 
     VkShaderModule shaderModule;
     VK_CHECK(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule));
-
-    // Cleanup Slang resources
-    compileRequest->release();
-
     return shaderModule;
 }
+
+VkShaderModule CompileSlangShader(VkDevice device, const char* shaderPath, const char* entryPoint,
+                                  VkShaderStageFlagBits stage) {
+#if defined(FIZZ_EMBED_SHADERS)
+    // Straight from the blob linked into the binary
+    const fizzengine::EmbeddedShader* shader =
+        fizzengine::find_embedded_shader(shaderPath, entryPoint);
+    if (shader) {
+        return create_shader_module(device, {shader->spirv, shader->word_count});
+    }
+#endif
+    std::vector<uint32_t> spirv;
+    if (!compile_slang_to_spirv(shaderPath, entryPoint, stage, spirv)) {
+        return VK_NULL_HANDLE;
+    }
+    return create_shader_module(device, spirv);
+}
 } // namespace vkutil
\ No newline at end of file